@@ -0,0 +1,373 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <random>
+
+#include "benchmark.h"
+#include "turing.h"
+#include "pda.h"
+#include "Pancake_sorting.h"
+#include "Pancake_engine.h"
+#include "Pancake_solver.h"
+#include "Pancake_enumerator.h"
+#include "Power_digits.h"
+
+#ifndef LFA_DATA_DIR
+#define LFA_DATA_DIR "."
+#endif
+
+// Usage: ./lfa_bench [--filter REGEX] [--min-time SECONDS] [--repetitions N] [--list]
+//                    [--out results.json] [--baseline results.json [--tolerance 0.10]] [--data DIR]
+// Runs the generated workloads below on the definition files of the repository (found in DIR,
+// the source tree by default). --out saves the results as a JSON baseline; --baseline compares
+// against one and exits with 1 if a benchmark got slower per step by more than the tolerance.
+
+// `count` random bits followed by the "$ @" separator and room for the copy, for the copy machines
+static std::string copyInput(size_t count) {
+    std::mt19937 random(42);
+    std::string line;
+    for (size_t i = 0; i < count; ++i) {
+        line += random() & 1 ? "1 " : "0 ";
+    }
+    line += "$ @";
+    for (size_t i = 0; i < count; ++i) {
+        line += " _";
+    }
+    return line;
+}
+
+// Unary addition 1^count + 1^count, for turing_input.txt
+static std::string additionInput(size_t count) {
+    std::string ones;
+    for (size_t i = 0; i < count; ++i) {
+        ones += "1 ";
+    }
+    return ones + "+ " + ones + "*";
+}
+
+enum class TuringEngine {
+    Plain,
+    Macro,
+    MultiTape,
+    Profiled
+};
+
+static void addTuring(BenchmarkSuite& suite, const std::string& name, const std::string& definition,
+                      TuringEngine engine, std::string (*input)(size_t), std::vector<size_t> sizes) {
+    static const char* engineNames[] = {"plain", "macro", "multitape", "profiled"};
+    for (size_t size : sizes) {
+        suite.add(name + "/" + engineNames[static_cast<int>(engine)] + "/" + std::to_string(size), [=]() {
+            auto tm = std::make_shared<TuringMachine>();
+            auto encoded = std::make_shared<std::vector<uint8_t>>();
+            if (!tm->loadFromFile(definition) || !tm->isValidAutomaton() || !tm->compile() ||
+                !tm->encodeInput(input(size), *encoded)) {
+                std::cerr << "Cannot prepare " << definition << std::endl;
+                std::exit(1);
+            }
+            auto tape = std::make_shared<Tape>();
+            auto runLengthTape = std::make_shared<RunLengthTape>();
+            auto tapes = std::make_shared<std::vector<Tape>>();
+            auto profile = std::make_shared<RunProfile>(tm->newProfile());
+            return BenchmarkSuite::Body([=]() -> uint64_t {
+                switch (engine) {
+                case TuringEngine::Macro:
+                    return tm->executeAccelerated(*encoded, *runLengthTape, false).steps;
+                case TuringEngine::MultiTape:
+                    return tm->executeMultiTape(*encoded, *tapes, false).steps;
+                case TuringEngine::Profiled:
+                    return tm->execute(*encoded, *tape, *profile, false).steps;
+                default:
+                    return tm->execute(*encoded, *tape, false).steps;
+                }
+            });
+        });
+    }
+}
+
+enum class PdaEngine {
+    Interpreter,
+    Table,
+    Bfs
+};
+
+// 0^depth 1^depth on pda.txt: every 0 is pushed, so the stack grows to `depth` symbols. The
+// "deterministic" runs keep the general interpreter; "table" is the action table of the same automaton.
+static void addPda(BenchmarkSuite& suite, const std::string& definition, PdaEngine engine, std::vector<size_t> depths) {
+    static const char* engineNames[] = {"deterministic/", "table/", "bfs/"};
+    const bool nondeterministic = engine == PdaEngine::Bfs;
+    for (size_t depth : depths) {
+        const std::string name = std::string("BM_PdaDeepStack/") + engineNames[static_cast<int>(engine)];
+        suite.add(name + std::to_string(depth), [=]() {
+            auto pda = std::make_shared<PushdownAutomaton>();
+            if (!pda->loadAutomaton(definition) || !pda->isValidAutomaton() || !pda->allValidRules() ||
+                (engine == PdaEngine::Table && !pda->isDeterministic())) {
+                std::cerr << "Cannot prepare " << definition << std::endl;
+                std::exit(1);
+            }
+            pda->setNondeterministic(nondeterministic);
+            pda->setTableExecution(engine == PdaEngine::Table);
+            std::vector<std::string> symbols(depth, "0");
+            symbols.resize(2 * depth, "1");
+            auto encoded = std::make_shared<std::vector<int32_t>>();
+            pda->encodeInput(symbols, *encoded);
+            auto stack = std::make_shared<std::vector<int32_t>>();
+            auto scratch = std::make_shared<PushdownAutomaton::SearchScratch>();
+            return BenchmarkSuite::Body([=]() -> uint64_t {
+                return nondeterministic ? pda->executeNondeterministic(*encoded, *scratch).steps
+                                        : pda->execute(*encoded, *stack).steps;
+            });
+        });
+    }
+}
+
+// A file made by mkstemp, so concurrent runs never share it, and removed with its last owner
+struct TemporaryFile {
+    std::string path;
+    
+    explicit TemporaryFile(const std::string& contents) {
+        path = (std::filesystem::temp_directory_path() / "lfa_bench_stream_XXXXXX").string();
+        const int fd = mkstemp(&path[0]);
+        std::FILE* file = fd >= 0 ? fdopen(fd, "w") : nullptr;
+        if (!file || std::fwrite(contents.data(), 1, contents.size(), file) != contents.size() || std::fclose(file) != 0) {
+            std::cerr << "Cannot write " << path << std::endl;
+            std::exit(1);
+        }
+    }
+    
+    ~TemporaryFile() {
+        std::remove(path.c_str());
+    }
+};
+
+// The same 0^depth 1^depth, streamed from a temporary file with one symbol per line, so ns/step
+// compares with BM_PdaDeepStack/deterministic. The file goes when the benchmark is done with it.
+static void addPdaStream(BenchmarkSuite& suite, const std::string& definition, std::vector<size_t> depths) {
+    for (size_t depth : depths) {
+        suite.add("BM_PdaStream/" + std::to_string(depth), [=]() {
+            auto pda = std::make_shared<PushdownAutomaton>();
+            if (!pda->loadAutomaton(definition) || !pda->isValidAutomaton() || !pda->allValidRules()) {
+                std::cerr << "Cannot prepare " << definition << std::endl;
+                std::exit(1);
+            }
+            std::string contents;
+            for (size_t i = 0; i < 2 * depth; ++i) {
+                contents += i < depth ? "0\n" : "1\n";
+            }
+            auto input = std::make_shared<TemporaryFile>(contents);
+            auto tokens = std::make_shared<TokenStream>();
+            auto stack = std::make_shared<std::vector<int32_t>>();
+            return BenchmarkSuite::Body([=]() -> uint64_t {
+                if (!tokens->open(input->path)) {
+                    std::cerr << "Cannot open " << input->path << std::endl;
+                    std::exit(1);
+                }
+                return pda->executeStream(*tokens, *stack).steps;
+            });
+        });
+    }
+}
+
+enum class Order {
+    Random,
+    Sorted,
+    Reversed
+};
+
+static std::vector<int> pancakeInput(Order order, size_t size) {
+    std::vector<int> values(size);
+    for (size_t i = 0; i < size; ++i) {
+        values[i] = static_cast<int>(order == Order::Reversed ? size - i : i);
+    }
+    if (order == Order::Random) {
+        std::shuffle(values.begin(), values.end(), std::mt19937(42));
+    }
+    return values;
+}
+
+static void addPancake(BenchmarkSuite& suite, Order order, std::vector<size_t> sizes) {
+    static const char* orderNames[] = {"random", "sorted", "reversed"};
+    for (size_t size : sizes) {
+        suite.add(std::string("BM_PancakeSort/") + orderNames[static_cast<int>(order)] + "/" + std::to_string(size),
+                  [=]() {
+            auto original = std::make_shared<std::vector<int>>(pancakeInput(order, size));
+            auto array = std::make_shared<std::vector<int>>();
+            return BenchmarkSuite::Body([=]() -> uint64_t {
+                *array = *original;
+                PancakeStats stats;
+                pancakeSort(*array, &stats);
+                return stats.touched;
+            });
+        });
+    }
+}
+
+// The tuned engine on the same arrays; steps are those of the reference version, so ns/step
+// compares directly with BM_PancakeSort. Setup checks that both sort with the same flips.
+static void addPancakeEngine(BenchmarkSuite& suite, PancakeSorter::Kernel kernel, Order order, std::vector<size_t> sizes) {
+    static const char* orderNames[] = {"random", "sorted", "reversed"};
+    if (!PancakeSorter::isSupported(kernel)) {
+        return;
+    }
+    for (size_t size : sizes) {
+        suite.add(std::string("BM_PancakeEngine/") + PancakeSorter::kernelName(kernel) + "/" +
+                  orderNames[static_cast<int>(order)] + "/" + std::to_string(size), [=]() {
+            auto original = std::make_shared<std::vector<int>>(pancakeInput(order, size));
+            auto sorter = std::make_shared<PancakeSorter>(kernel);
+            auto array = std::make_shared<std::vector<int>>(*original);
+            auto flips = std::make_shared<PancakeSorter::FlipSequence>();
+            std::vector<int> reference = *original;
+            PancakeStats stats;
+            pancakeSort(reference, &stats);
+            sorter->sort(*array, *flips);
+            if (*array != reference || flips->size() != stats.flips) {
+                std::cerr << "The pancake engine disagrees with pancakeSort() on " << size << " elements" << std::endl;
+                std::exit(1);
+            }
+            const uint64_t steps = stats.touched;
+            return BenchmarkSuite::Body([=]() -> uint64_t {
+                *array = *original;
+                sorter->sort(*array, *flips);
+                return steps;
+            });
+        });
+    }
+}
+
+// Shortest flip sequences on random arrays, one solver (and thread pool) per benchmark; steps are
+// the permutations expanded. Setup checks the sequence and counts the flips saved over pancakeSort().
+static void addPancakeOptimal(BenchmarkSuite& suite, std::vector<size_t> sizes) {
+    for (size_t size : sizes) {
+        suite.add("BM_PancakeOptimal/random/" + std::to_string(size), [=](BenchmarkSuite::Counters& counters) {
+            auto original = std::make_shared<std::vector<int>>(pancakeInput(Order::Random, size));
+            auto solver = std::make_shared<PancakeSolver>();
+            std::vector<int> greedy = *original;
+            PancakeStats stats;
+            pancakeSort(greedy, &stats);
+            PancakeSolver::Solution solution = solver->solve(*original);
+            std::vector<int> replayed = *original;
+            PancakeSorter::applyFlips(replayed, solution.flips);
+            if (!solution.solved || replayed != greedy) {
+                std::cerr << "The pancake solver does not sort " << size << " elements" << std::endl;
+                std::exit(1);
+            }
+            counters = {{"greedy_flips", static_cast<double>(stats.flips)},
+                        {"optimal_flips", static_cast<double>(solution.flips.size())},
+                        {"flips_saved", static_cast<double>(stats.flips - solution.flips.size())},
+                        {"lower_bound", static_cast<double>(solution.lowerBound)}};
+            return BenchmarkSuite::Body([=]() -> uint64_t {
+                return solver->solve(*original).nodes;
+            });
+        });
+    }
+}
+
+// Breadth-first search over all n! permutations; steps are the children ranked, n - 1 per permutation
+static void addPancakeEnumerate(BenchmarkSuite& suite, std::vector<uint32_t> sizes) {
+    for (uint32_t size : sizes) {
+        suite.add("BM_PancakeEnumerate/" + std::to_string(size), [=](BenchmarkSuite::Counters& counters) {
+            auto enumerator = std::make_shared<PancakeEnumerator>();
+            PancakeEnumerator::Result result = enumerator->enumerate(size);
+            if (!result.ok) {
+                std::exit(1);
+            }
+            counters = {{"pancake_number", static_cast<double>(result.distribution.size() - 1)}};
+            const uint64_t steps = result.states * (size - 1);
+            return BenchmarkSuite::Body([=]() -> uint64_t {
+                enumerator->enumerate(size);
+                return steps;
+            });
+        });
+    }
+}
+
+// 1000 consecutive exponents from 2^from, seed included; steps are exponents, so steps/s is the
+// throughput the command-line tool reports
+static void addPowerDigits(BenchmarkSuite& suite, PowerDigitScanner::Kernel kernel, PowerDigitScanner::Query query,
+                           std::vector<uint64_t> starts) {
+    if (!PowerDigitScanner::isSupported(kernel)) {
+        return;
+    }
+    for (uint64_t from : starts) {
+        suite.add(std::string("BM_PowerDigits/") + (query == PowerDigitScanner::Query::OnlyEvenDigits ? "even/" : "zero/") +
+                  PowerDigitScanner::kernelName(kernel) + "/" + std::to_string(from), [=]() {
+            auto scanner = std::make_shared<PowerDigitScanner>(1, kernel);
+            return BenchmarkSuite::Body([=]() -> uint64_t {
+                return scanner->scan(query, from, from + 999).scanned;
+            });
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkSuite::Options options;
+    std::string outPath;
+    std::string baselinePath;
+    std::string dataDir = LFA_DATA_DIR;
+    double tolerance = 0.10;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.minTime = std::stod(argv[++i]);
+        } else if (arg == "--repetitions" && i + 1 < argc) {
+            options.repetitions = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg == "--list") {
+            options.list = true;
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::stod(argv[++i]);
+        } else if (arg == "--data" && i + 1 < argc) {
+            dataDir = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    BenchmarkSuite suite;
+    const std::string copy = dataDir + "/turing.txt";
+    const std::string copy2Tapes = dataDir + "/turing_2tapes.txt";
+    const std::string addition = dataDir + "/turing_input.txt";
+    addTuring(suite, "BM_TuringCopy", copy, TuringEngine::Plain, copyInput, {64, 256, 1024, 4096});
+    addTuring(suite, "BM_TuringCopy", copy, TuringEngine::Macro, copyInput, {64, 256, 1024, 4096});
+    addTuring(suite, "BM_TuringCopy", copy2Tapes, TuringEngine::MultiTape, copyInput, {64, 256, 1024, 4096});
+    addTuring(suite, "BM_TuringCopy", copy, TuringEngine::Profiled, copyInput, {1024});
+    addTuring(suite, "BM_TuringAdd", addition, TuringEngine::Plain, additionInput, {1 << 10, 1 << 14, 1 << 18, 1 << 22});
+    addTuring(suite, "BM_TuringAdd", addition, TuringEngine::Macro, additionInput, {1 << 10, 1 << 14, 1 << 18, 1 << 22});
+    addPda(suite, dataDir + "/pda.txt", PdaEngine::Interpreter, {1 << 10, 1 << 14, 1 << 18, 1 << 20});
+    addPda(suite, dataDir + "/pda.txt", PdaEngine::Table, {1 << 10, 1 << 14, 1 << 18, 1 << 20});
+    addPda(suite, dataDir + "/pda.txt", PdaEngine::Bfs, {1 << 10, 1 << 14, 1 << 16});
+    addPdaStream(suite, dataDir + "/pda.txt", {1 << 10, 1 << 14, 1 << 18, 1 << 20});
+    for (Order order : {Order::Random, Order::Sorted, Order::Reversed}) {
+        addPancake(suite, order, {256, 1024, 4096, 16384});
+        addPancakeEngine(suite, PancakeSorter::Kernel::Scalar, order, {256, 1024, 4096, 16384});
+        addPancakeEngine(suite, PancakeSorter::Kernel::Avx2, order, {256, 1024, 4096, 16384});
+    }
+    addPancakeOptimal(suite, {16, 32, 48, 64});
+    addPancakeEnumerate(suite, {8, 9, 10});
+    for (PowerDigitScanner::Kernel kernel : {PowerDigitScanner::Kernel::Scalar, PowerDigitScanner::Kernel::Avx2}) {
+        addPowerDigits(suite, kernel, PowerDigitScanner::Query::OnlyEvenDigits, {10000, 100000});
+        addPowerDigits(suite, kernel, PowerDigitScanner::Query::ContainsZero, {10000, 100000});
+    }
+
+    std::vector<BenchmarkSuite::Result> results = suite.run(options);
+    if (options.list) {
+        return 0;
+    }
+    if (!outPath.empty() && !BenchmarkSuite::writeJson(outPath, results)) {
+        return 1;
+    }
+    if (!baselinePath.empty()) {
+        std::map<std::string, BenchmarkSuite::Result> baseline;
+        if (!BenchmarkSuite::readJson(baselinePath, baseline)) {
+            return 1;
+        }
+        return BenchmarkSuite::compare(baseline, results, tolerance) > 0 ? 1 : 0;
+    }
+    return 0;
+}
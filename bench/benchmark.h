@@ -0,0 +1,327 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/**
+  Minimal benchmark harness in the style of Google Benchmark, with no dependency to install.
+
+  A benchmark is registered under a name such as "BM_TuringCopy/plain/1024" with a setup
+  function that builds its workload (untimed) and returns the body of one iteration. The body
+  returns the number of steps it executed: transitions for the automata, elements scanned or
+  moved for pancake sort. The runner grows the iteration count until one measurement lasts at
+  least the minimum time, repeats the measurement and keeps the median, then reports time per
+  iteration, steps/s, ns/step and the peak resident set size reached while the workload was alive.
+  A setup may also fill named counters (quality figures of the result, such as flips saved),
+  which are printed under the benchmark and written as extra fields of its JSON object.
+
+  Results are written as JSON in Google Benchmark's layout, one benchmark object per line, and
+  a previous file can be read back as a baseline: a benchmark whose ns/step (or time per
+  iteration when it executes no steps) grew by more than the tolerance is a regression.
+ */
+class BenchmarkSuite {
+public:
+    using Body = std::function<uint64_t()>;
+    using Setup = std::function<Body()>;
+    using Counters = std::vector<std::pair<std::string, double>>;
+    using CountedSetup = std::function<Body(Counters&)>;
+
+    struct Result {
+        std::string name;
+        uint64_t iterations = 0;
+        double nsPerIteration = 0;
+        double stepsPerIteration = 0;
+        double stepsPerSecond = 0;
+        double nsPerStep = 0;   // 0 when the benchmark executes no steps
+        size_t peakRssBytes = 0;
+        Counters counters;
+
+        // What regressions are judged on
+        double metric() const {
+            return stepsPerIteration > 0 ? nsPerStep : nsPerIteration;
+        }
+    };
+
+    struct Options {
+        std::string filter = ".*";
+        double minTime = 0.5;       // seconds per measurement
+        unsigned repetitions = 3;
+        bool list = false;
+    };
+
+    void add(const std::string& name, Setup setup) {
+        add(name, CountedSetup([setup](Counters&) { return setup(); }));
+    }
+
+    void add(const std::string& name, CountedSetup setup) {
+        cases.push_back(Case{name, std::move(setup)});
+    }
+
+    std::vector<Result> run(const Options& options) const {
+        std::vector<Result> results;
+        std::regex filter(options.filter);
+        for (const Case& benchmark : cases) {
+            if (!std::regex_search(benchmark.name, filter)) {
+                continue;
+            }
+            if (options.list) {
+                std::cout << benchmark.name << '\n';
+                continue;
+            }
+            if (results.empty()) {
+                printHeader();
+            }
+            results.push_back(measure(benchmark, options));
+            printResult(results.back());
+        }
+        return results;
+    }
+
+    static bool writeJson(const std::string& path, const std::vector<Result>& results) {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cerr << "Error opening file: " << path << std::endl;
+            return false;
+        }
+        char date[64];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+        out << "{\n  \"context\": {\"date\": \"" << date << "\", \"num_cpus\": " << std::thread::hardware_concurrency()
+            << ", \"library_build_type\": \"" << buildType() << "\"},\n  \"benchmarks\": [\n";
+        out << std::setprecision(10);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& result = results[i];
+            out << "    {\"name\": \"" << escape(result.name) << "\", \"iterations\": " << result.iterations
+                << ", \"real_time\": " << result.nsPerIteration << ", \"time_unit\": \"ns\""
+                << ", \"steps\": " << result.stepsPerIteration << ", \"steps_per_second\": " << result.stepsPerSecond
+                << ", \"ns_per_step\": " << result.nsPerStep << ", \"peak_rss_bytes\": " << result.peakRssBytes;
+            for (const auto& counter : result.counters) {
+                out << ", \"" << escape(counter.first) << "\": " << counter.second;
+            }
+            out << "}" << (i + 1 < results.size() ? "," : "") << '\n';
+        }
+        out << "  ]\n}\n";
+        return true;
+    }
+
+    // Reads a file written by writeJson(); false if it cannot be opened
+    static bool readJson(const std::string& path, std::map<std::string, Result>& results) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            std::cerr << "Error opening file: " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            Result result;
+            if (!stringField(line, "name", result.name)) {
+                continue;
+            }
+            result.iterations = static_cast<uint64_t>(numberField(line, "iterations"));
+            result.nsPerIteration = numberField(line, "real_time");
+            result.stepsPerIteration = numberField(line, "steps");
+            result.stepsPerSecond = numberField(line, "steps_per_second");
+            result.nsPerStep = numberField(line, "ns_per_step");
+            result.peakRssBytes = static_cast<size_t>(numberField(line, "peak_rss_bytes"));
+            results[result.name] = result;
+        }
+        return true;
+    }
+
+    // Prints every benchmark found in both sets; returns how many regressed beyond `tolerance`
+    static size_t compare(const std::map<std::string, Result>& baseline, const std::vector<Result>& results,
+                          double tolerance) {
+        size_t regressions = 0;
+        std::cout << '\n' << std::left << std::setw(40) << "Comparison" << std::right << std::setw(14) << "baseline"
+                  << std::setw(14) << "current" << std::setw(10) << "delta" << '\n';
+        for (const Result& result : results) {
+            auto found = baseline.find(result.name);
+            if (found == baseline.end() || found->second.metric() <= 0) {
+                continue;
+            }
+            const double before = found->second.metric();
+            const double delta = (result.metric() - before) / before;
+            const bool regressed = delta > tolerance;
+            regressions += regressed;
+            std::cout << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(14) << before << std::setw(14) << result.metric() << std::setw(9)
+                      << std::showpos << delta * 100 << std::noshowpos << '%' << (regressed ? "  REGRESSION" : "")
+                      << '\n';
+            std::cout.unsetf(std::ios::fixed);
+        }
+        std::cout << "(ns/step, or ns per iteration for benchmarks without steps; tolerance "
+                  << tolerance * 100 << "%)" << std::endl;
+        return regressions;
+    }
+
+private:
+    struct Case {
+        std::string name;
+        CountedSetup setup;
+    };
+
+    std::vector<Case> cases;
+
+    static const char* buildType() {
+#ifdef NDEBUG
+        return "release";
+#else
+        return "debug";
+#endif
+    }
+
+    // Restarts the kernel's high-water mark of the resident set (Linux 4.0 and later); false if
+    // it cannot, in which case the peak reported is the one of the whole process
+    static bool resetPeakRss() {
+#ifdef __GLIBC__
+        // Hand the memory freed by the previous benchmark back, so it does not count here
+        malloc_trim(0);
+#endif
+        std::FILE* file = std::fopen("/proc/self/clear_refs", "w");
+        if (!file) {
+            return false;
+        }
+        const bool written = std::fputs("5", file) >= 0;
+        return std::fclose(file) == 0 && written;
+    }
+
+    static size_t peakRssBytes() {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 6, "VmHWM:") == 0) {
+                return std::stoull(line.substr(6)) * 1024;
+            }
+        }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+    }
+
+    static Result measure(const Case& benchmark, const Options& options) {
+        resetPeakRss();
+        Result result;
+        Body body = benchmark.setup(result.counters);
+
+        // Time `iterations` runs of the body, returning the steps of the last one
+        uint64_t steps = 0;
+        auto time = [&](uint64_t iterations) {
+            auto started = std::chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                steps = body();
+            }
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        };
+
+        // Grow the iteration count until a measurement is long enough, as Google Benchmark does
+        uint64_t iterations = 1;
+        double seconds = time(iterations);
+        while (seconds < options.minTime && iterations < 1000000000) {
+            double factor = seconds > 0 ? options.minTime * 1.4 / seconds : 10;
+            iterations = std::max(iterations + 1, static_cast<uint64_t>(iterations * std::min(factor, 10.0)));
+            seconds = time(iterations);
+        }
+
+        std::vector<double> samples{seconds};
+        for (unsigned i = 1; i < options.repetitions; ++i) {
+            samples.push_back(time(iterations));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        result.name = benchmark.name;
+        result.iterations = iterations;
+        result.nsPerIteration = samples[samples.size() / 2] * 1e9 / static_cast<double>(iterations);
+        result.stepsPerIteration = static_cast<double>(steps);
+        if (steps > 0) {
+            result.nsPerStep = result.nsPerIteration / result.stepsPerIteration;
+            result.stepsPerSecond = 1e9 / result.nsPerStep;
+        }
+        result.peakRssBytes = peakRssBytes();
+        return result;
+    }
+
+    static void printHeader() {
+        std::cout << std::left << std::setw(40) << "Benchmark" << std::right << std::setw(16) << "Time" << std::setw(12)
+                  << "Iterations" << std::setw(14) << "Steps/s" << std::setw(12) << "ns/step" << std::setw(12)
+                  << "Peak RSS" << '\n'
+                  << std::string(106, '-') << std::endl;
+    }
+
+    static void printResult(const Result& result) {
+        std::ostringstream time;
+        time << std::fixed << std::setprecision(0) << result.nsPerIteration << " ns";
+        std::cout << std::left << std::setw(40) << result.name << std::right << std::setw(16) << time.str()
+                  << std::setw(12) << result.iterations;
+        if (result.stepsPerIteration > 0) {
+            std::cout << std::setw(14) << std::setprecision(4) << result.stepsPerSecond << std::setw(12)
+                      << std::setprecision(4) << result.nsPerStep;
+        } else {
+            std::cout << std::setw(14) << "-" << std::setw(12) << "-";
+        }
+        std::cout << std::setw(9) << result.peakRssBytes / (1024 * 1024) << " MiB" << std::endl;
+        if (!result.counters.empty()) {
+            std::cout << "  ";
+            for (const auto& counter : result.counters) {
+                std::cout << ' ' << counter.first << '=' << counter.second;
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    static bool stringField(const std::string& line, const std::string& key, std::string& value) {
+        const std::string marker = "\"" + key + "\": \"";
+        size_t start = line.find(marker);
+        if (start == std::string::npos) {
+            return false;
+        }
+        value.clear();
+        for (size_t i = start + marker.size(); i < line.size() && line[i] != '"'; ++i) {
+            if (line[i] == '\\' && i + 1 < line.size()) {
+                ++i;
+            }
+            value += line[i];
+        }
+        return true;
+    }
+
+    static double numberField(const std::string& line, const std::string& key) {
+        const std::string marker = "\"" + key + "\": ";
+        size_t start = line.find(marker);
+        return start == std::string::npos ? 0 : std::strtod(line.c_str() + start + marker.size(), nullptr);
+    }
+};
+
+#endif
@@ -0,0 +1,721 @@
+#ifndef CONTEXT_FREE_GRAMMAR_H
+#define CONTEXT_FREE_GRAMMAR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "work_stealing_pool.h"
+
+/**
+  Context-free grammar over terminals 0 .. terminalCount - 1.
+
+  A body symbol s >= 0 is the nonterminal s and s < 0 is the terminal ~s (see terminal()), so a
+  production is a head and a plain integer vector; the empty body is an epsilon production.
+  Nonterminals carry names for printing only.
+ */
+class ContextFreeGrammar {
+public:
+    struct Production {
+        int32_t head;
+        std::vector<int32_t> body;
+
+        bool operator<(const Production& other) const {
+            return head != other.head ? head < other.head : body < other.body;
+        }
+
+        bool operator==(const Production& other) const {
+            return head == other.head && body == other.body;
+        }
+    };
+
+    explicit ContextFreeGrammar(size_t terminalCount = 0) : terminalCount_(terminalCount) {}
+
+    static int32_t terminal(int32_t symbol) {
+        return ~symbol;
+    }
+
+    static bool isTerminal(int32_t symbol) {
+        return symbol < 0;
+    }
+
+    int32_t addNonterminal(std::string name) {
+        names_.push_back(std::move(name));
+        return static_cast<int32_t>(names_.size() - 1);
+    }
+
+    void addProduction(int32_t head, std::vector<int32_t> body) {
+        productions_.push_back(Production{head, std::move(body)});
+    }
+
+    void setStart(int32_t start) {
+        start_ = start;
+    }
+
+    int32_t start() const {
+        return start_;
+    }
+
+    size_t terminalCount() const {
+        return terminalCount_;
+    }
+
+    size_t nonterminalCount() const {
+        return names_.size();
+    }
+
+    const std::string& name(int32_t nonterminal) const {
+        return names_[nonterminal];
+    }
+
+    const std::vector<Production>& productions() const {
+        return productions_;
+    }
+
+    // Nonterminals that derive the empty word
+    std::vector<char> nullable() const {
+        // A production becomes nullable once all of its body is; terminals never are
+        std::vector<char> result(names_.size(), 0);
+        std::vector<uint32_t> missing(productions_.size(), 0);
+        std::vector<std::vector<uint32_t>> uses(names_.size());
+        std::vector<int32_t> work;
+        for (size_t i = 0; i < productions_.size(); ++i) {
+            const Production& production = productions_[i];
+            bool hasTerminal = false;
+            for (int32_t symbol : production.body) {
+                hasTerminal |= isTerminal(symbol);
+            }
+            if (hasTerminal) {
+                missing[i] = UINT32_MAX;
+                continue;
+            }
+            for (int32_t symbol : production.body) {
+                uses[symbol].push_back(static_cast<uint32_t>(i));
+            }
+            missing[i] = static_cast<uint32_t>(production.body.size());
+            if (missing[i] == 0 && !result[production.head]) {
+                result[production.head] = 1;
+                work.push_back(production.head);
+            }
+        }
+        propagate(result, missing, uses, work);
+        return result;
+    }
+
+    // Removes the nonterminals that derive no terminal word or cannot be reached from the start,
+    // renumbers the rest densely and drops duplicate productions. The start symbol is always kept.
+    void trim() {
+        // Generating: some production has only terminals and generating nonterminals in its body
+        std::vector<char> generating(names_.size(), 0);
+        std::vector<uint32_t> missing(productions_.size(), 0);
+        std::vector<std::vector<uint32_t>> uses(names_.size());
+        std::vector<int32_t> work;
+        for (size_t i = 0; i < productions_.size(); ++i) {
+            const Production& production = productions_[i];
+            for (int32_t symbol : production.body) {
+                if (!isTerminal(symbol)) {
+                    uses[symbol].push_back(static_cast<uint32_t>(i));
+                    ++missing[i];
+                }
+            }
+            if (missing[i] == 0 && !generating[production.head]) {
+                generating[production.head] = 1;
+                work.push_back(production.head);
+            }
+        }
+        propagate(generating, missing, uses, work);
+
+        auto usable = [&](const Production& production) {
+            if (!generating[production.head]) {
+                return false;
+            }
+            for (int32_t symbol : production.body) {
+                if (!isTerminal(symbol) && !generating[symbol]) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        std::vector<std::vector<uint32_t>> byHead(names_.size());
+        for (size_t i = 0; i < productions_.size(); ++i) {
+            if (usable(productions_[i])) {
+                byHead[productions_[i].head].push_back(static_cast<uint32_t>(i));
+            }
+        }
+        std::vector<int32_t> renumbered(names_.size(), -1);
+        std::vector<std::string> names;
+        std::vector<int32_t> order;
+        if (start_ >= 0) {
+            renumbered[start_] = 0;
+            names.push_back(names_[start_]);
+            order.push_back(start_);
+        }
+        for (size_t k = 0; k < order.size(); ++k) {
+            for (uint32_t i : byHead[order[k]]) {
+                for (int32_t symbol : productions_[i].body) {
+                    if (!isTerminal(symbol) && renumbered[symbol] < 0) {
+                        renumbered[symbol] = static_cast<int32_t>(names.size());
+                        names.push_back(names_[symbol]);
+                        order.push_back(symbol);
+                    }
+                }
+            }
+        }
+
+        std::vector<Production> productions;
+        for (int32_t head : order) {
+            for (uint32_t i : byHead[head]) {
+                Production production{renumbered[head], productions_[i].body};
+                for (int32_t& symbol : production.body) {
+                    if (!isTerminal(symbol)) {
+                        symbol = renumbered[symbol];
+                    }
+                }
+                productions.push_back(std::move(production));
+            }
+        }
+        std::sort(productions.begin(), productions.end());
+        productions.erase(std::unique(productions.begin(), productions.end()), productions.end());
+
+        names_.swap(names);
+        productions_.swap(productions);
+        start_ = start_ >= 0 ? 0 : -1;
+    }
+
+    // Prints one production per line, "A -> x y z"; terminals are printed with terminalNames[t]
+    // and the empty body as "e"
+    template <typename Names>
+    void print(std::ostream& out, const Names& terminalNames) const {
+        for (const Production& production : productions_) {
+            out << names_[production.head] << " ->";
+            for (int32_t symbol : production.body) {
+                out << ' ';
+                if (isTerminal(symbol)) {
+                    out << terminalNames[terminal(symbol)];
+                } else {
+                    out << names_[symbol];
+                }
+            }
+            if (production.body.empty()) {
+                out << " e";
+            }
+            out << '\n';
+        }
+    }
+
+private:
+    size_t terminalCount_;
+    std::vector<std::string> names_;
+    std::vector<Production> productions_;
+    int32_t start_ = -1;
+
+    // Worklist closure shared by nullable() and trim(): marks the head of every production whose
+    // count of unmarked body nonterminals drops to zero
+    void propagate(std::vector<char>& marked, std::vector<uint32_t>& missing,
+                   const std::vector<std::vector<uint32_t>>& uses, std::vector<int32_t>& work) const {
+        while (!work.empty()) {
+            int32_t symbol = work.back();
+            work.pop_back();
+            for (uint32_t i : uses[symbol]) {
+                if (missing[i] != UINT32_MAX && --missing[i] == 0 && !marked[productions_[i].head]) {
+                    marked[productions_[i].head] = 1;
+                    work.push_back(productions_[i].head);
+                }
+            }
+        }
+    }
+};
+
+/**
+  A grammar in Chomsky Normal Form: every production is A -> B C or A -> a, and whether the
+  empty word is in the language is kept as a flag.
+
+  The conversion runs the usual steps in the order that keeps the grammar polynomial: terminals
+  inside long bodies get a nonterminal of their own, bodies are binarized, epsilon productions
+  are removed (a binary body with a nullable symbol gets its shorter variants), unit productions
+  are replaced by the productions they lead to, and useless symbols are trimmed at the end.
+ */
+class ChomskyGrammar {
+public:
+    struct BinaryRule {
+        int32_t head;
+        int32_t left;
+        int32_t right;
+    };
+
+    explicit ChomskyGrammar(const ContextFreeGrammar& source) {
+        using Production = ContextFreeGrammar::Production;
+        ContextFreeGrammar grammar = source;
+        grammar.trim();
+        std::vector<char> nullable = grammar.nullable();
+        acceptsEmpty_ = grammar.start() >= 0 && nullable[grammar.start()];
+
+        ContextFreeGrammar normal(grammar.terminalCount());
+        for (size_t i = 0; i < grammar.nonterminalCount(); ++i) {
+            normal.addNonterminal(grammar.name(static_cast<int32_t>(i)));
+        }
+        normal.setStart(grammar.start());
+
+        // Terminals in bodies of two or more symbols, then binarization
+        std::vector<int32_t> wrapper(grammar.terminalCount(), -1);
+        std::vector<Production> binary;
+        for (const Production& production : grammar.productions()) {
+            std::vector<int32_t> body = production.body;
+            if (body.size() >= 2) {
+                for (int32_t& symbol : body) {
+                    if (ContextFreeGrammar::isTerminal(symbol)) {
+                        int32_t& wrapped = wrapper[ContextFreeGrammar::terminal(symbol)];
+                        if (wrapped < 0) {
+                            wrapped = normal.addNonterminal("T" + std::to_string(ContextFreeGrammar::terminal(symbol)));
+                            nullable.push_back(0);
+                            binary.push_back(Production{wrapped, {symbol}});
+                        }
+                        symbol = wrapped;
+                    }
+                }
+            }
+            int32_t head = production.head;
+            size_t first = 0;
+            while (body.size() - first > 2) {
+                int32_t rest = normal.addNonterminal(normal.name(production.head) + "." + std::to_string(first + 1));
+                bool restNullable = true;
+                for (size_t k = first + 1; k < body.size(); ++k) {
+                    restNullable = restNullable && nullable[body[k]];
+                }
+                nullable.push_back(restNullable ? 1 : 0);
+                binary.push_back(Production{head, {body[first], rest}});
+                head = rest;
+                ++first;
+            }
+            binary.push_back(Production{head, std::vector<int32_t>(body.begin() + first, body.end())});
+        }
+
+        // Epsilon removal: bodies are at most two symbols long now
+        std::vector<Production> productions;
+        for (const Production& production : binary) {
+            const std::vector<int32_t>& body = production.body;
+            if (body.size() == 2) {
+                productions.push_back(production);
+                if (nullable[body[0]]) {
+                    productions.push_back(Production{production.head, {body[1]}});
+                }
+                if (nullable[body[1]]) {
+                    productions.push_back(Production{production.head, {body[0]}});
+                }
+            } else if (body.size() == 1) {
+                productions.push_back(production);
+            }
+        }
+
+        // Unit removal: A gets the non-unit productions of every B with A =>* B through unit productions
+        const size_t count = normal.nonterminalCount();
+        std::vector<std::vector<int32_t>> units(count);
+        std::vector<std::vector<uint32_t>> nonUnit(count);
+        for (size_t i = 0; i < productions.size(); ++i) {
+            const Production& production = productions[i];
+            if (production.body.size() == 1 && !ContextFreeGrammar::isTerminal(production.body[0])) {
+                if (production.body[0] != production.head) {
+                    units[production.head].push_back(production.body[0]);
+                }
+            } else {
+                nonUnit[production.head].push_back(static_cast<uint32_t>(i));
+            }
+        }
+        std::vector<uint32_t> seen(count, UINT32_MAX);
+        std::vector<int32_t> closure;
+        for (size_t head = 0; head < count; ++head) {
+            closure.assign(1, static_cast<int32_t>(head));
+            seen[head] = static_cast<uint32_t>(head);
+            for (size_t k = 0; k < closure.size(); ++k) {
+                for (uint32_t i : nonUnit[closure[k]]) {
+                    normal.addProduction(static_cast<int32_t>(head), productions[i].body);
+                }
+                for (int32_t next : units[closure[k]]) {
+                    if (seen[next] != head) {
+                        seen[next] = static_cast<uint32_t>(head);
+                        closure.push_back(next);
+                    }
+                }
+            }
+        }
+        normal.trim();
+
+        nonterminalCount_ = normal.nonterminalCount();
+        start_ = normal.start();
+        names_.reserve(nonterminalCount_);
+        for (size_t i = 0; i < nonterminalCount_; ++i) {
+            names_.push_back(normal.name(static_cast<int32_t>(i)));
+        }
+        words_ = (nonterminalCount_ + 63) / 64;
+        terminalSets_.assign(normal.terminalCount() * words_, 0);
+        for (const Production& production : normal.productions()) {
+            if (production.body.size() == 2) {
+                binaryRules_.push_back(BinaryRule{production.head, production.body[0], production.body[1]});
+            } else {
+                size_t symbol = static_cast<size_t>(ContextFreeGrammar::terminal(production.body[0]));
+                terminalSets_[symbol * words_ + production.head / 64] |= uint64_t(1) << (production.head % 64);
+            }
+        }
+    }
+
+    size_t nonterminalCount() const {
+        return nonterminalCount_;
+    }
+
+    // Words of a bitset over the nonterminals
+    size_t words() const {
+        return words_;
+    }
+
+    int32_t start() const {
+        return start_;
+    }
+
+    bool acceptsEmpty() const {
+        return acceptsEmpty_;
+    }
+
+    const std::string& name(int32_t nonterminal) const {
+        return names_[nonterminal];
+    }
+
+    // Binary rules sorted by head
+    const std::vector<BinaryRule>& binaryRules() const {
+        return binaryRules_;
+    }
+
+    // Bitset of the nonterminals A with a production A -> terminal
+    const uint64_t* terminalSet(int32_t terminal) const {
+        return terminalSets_.data() + static_cast<size_t>(terminal) * words_;
+    }
+
+private:
+    size_t nonterminalCount_ = 0;
+    size_t words_ = 0;
+    int32_t start_ = -1;
+    bool acceptsEmpty_ = false;
+    std::vector<std::string> names_;
+    std::vector<BinaryRule> binaryRules_;
+    std::vector<uint64_t> terminalSets_;
+};
+
+/**
+  Bitset-parallel CYK recognizer, O(|rules| * n^3 / 64) time in the worst case.
+
+  For every nonterminal B that is the left child of a rule, starts[B][i] is the bitset of the
+  positions k such that B derives word[i, k); for every right child C, ends[C][j] is the bitset of
+  the positions k such that C derives word[k, j). A rule A -> B C holds on the span [i, j) iff
+  starts[B][i] & ends[C][j] is nonzero, so the split point loop is a word-wide AND over the
+  positions between i and j. Spans are filled diagonal by diagonal (by length); the spans of one
+  diagonal are independent and are spread over the pool. The span [i, j) only writes row i of
+  starts and row j of ends, which no other span of its diagonal touches, and the rows only hold
+  bits of shorter spans when they are read, so the split loop needs no masking. The loop is further
+  narrowed to the words between the lowest and highest bits the two rows share.
+
+  Rows are stored as triangles (starts[B][i] only from word i / 64, ends[C][j] only up to word
+  j / 64), so memory is about n^2 / 8 bytes per child nonterminal.
+ */
+class CykRecognizer {
+public:
+    struct Result {
+        bool accepted = false;
+        size_t derived = 0;       // (span, nonterminal) pairs found
+    };
+
+    explicit CykRecognizer(const ChomskyGrammar& grammar) : grammar_(grammar) {
+        const size_t count = grammar.nonterminalCount();
+        leftSlot_.assign(count, -1);
+        rightSlot_.assign(count, -1);
+        for (const ChomskyGrammar::BinaryRule& rule : grammar.binaryRules()) {
+            if (leftSlot_[rule.left] < 0) {
+                leftSlot_[rule.left] = static_cast<int32_t>(leftCount_++);
+            }
+            if (rightSlot_[rule.right] < 0) {
+                rightSlot_[rule.right] = static_cast<int32_t>(rightCount_++);
+            }
+        }
+        // Once the head of a rule is known on a span, the rest of its rules are skipped
+        const std::vector<ChomskyGrammar::BinaryRule>& rules = grammar.binaryRules();
+        nextHead_.assign(rules.size(), rules.size());
+        for (size_t i = rules.size(); i-- > 1;) {
+            nextHead_[i - 1] = rules[i - 1].head == rules[i].head ? nextHead_[i] : i;
+        }
+    }
+
+    // Runs serially when pool is null
+    Result recognize(const std::vector<int32_t>& word, WorkStealingPool* pool = nullptr) const {
+        Result result;
+        const size_t n = word.size();
+        if (n == 0) {
+            result.accepted = grammar_.acceptsEmpty();
+            return result;
+        }
+        if (grammar_.start() < 0) {
+            return result;
+        }
+
+        // Positions 0 .. n; a starts row i holds words [i / 64, rowWords), an ends row j words [0, j / 64]
+        const size_t rowWords = n / 64 + 1;
+        std::vector<size_t> startsOffset(n + 1);
+        std::vector<size_t> endsOffset(n + 2);
+        startsOffset[0] = 0;
+        endsOffset[0] = 0;
+        for (size_t i = 0; i < n; ++i) {
+            startsOffset[i + 1] = startsOffset[i] + rowWords - i / 64;
+        }
+        for (size_t j = 0; j <= n; ++j) {
+            endsOffset[j + 1] = endsOffset[j] + j / 64 + 1;
+        }
+        const size_t startsSize = startsOffset[n];
+        const size_t endsSize = endsOffset[n + 1];
+        std::vector<uint64_t> starts(startsSize * leftCount_, 0);
+        std::vector<uint64_t> ends(endsSize * rightCount_, 0);
+        // Lowest and highest bit of every row, kNone while it is empty, to narrow the split loop
+        std::vector<uint32_t> startsLow(n * leftCount_, kNone);
+        std::vector<uint32_t> startsHigh(n * leftCount_, 0);
+        std::vector<uint32_t> endsLow((n + 1) * rightCount_, kNone);
+        std::vector<uint32_t> endsHigh((n + 1) * rightCount_, 0);
+
+        const size_t words = grammar_.words();
+        std::vector<uint64_t> cells(n * words);
+        std::vector<size_t> derived(pool ? pool->size() : 1, 0);
+        const std::vector<ChomskyGrammar::BinaryRule>& rules = grammar_.binaryRules();
+
+        // Records the nonterminals of span [i, j), held in cells[i], in the rows of its children. Spans
+        // are published by increasing length, so j only grows along a starts row and i only drops
+        // along an ends row.
+        auto publish = [&](unsigned worker, size_t i, size_t j) {
+            const uint64_t* cell = cells.data() + i * words;
+            for (size_t w = 0; w < words; ++w) {
+                for (uint64_t bits = cell[w]; bits != 0; bits &= bits - 1) {
+                    const size_t nonterminal = w * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+                    if (leftSlot_[nonterminal] >= 0) {
+                        const size_t slot = static_cast<size_t>(leftSlot_[nonterminal]);
+                        starts[slot * startsSize + startsOffset[i] + j / 64 - i / 64] |= uint64_t(1) << (j % 64);
+                        if (startsLow[slot * n + i] == kNone) {
+                            startsLow[slot * n + i] = static_cast<uint32_t>(j);
+                        }
+                        startsHigh[slot * n + i] = static_cast<uint32_t>(j);
+                    }
+                    if (rightSlot_[nonterminal] >= 0) {
+                        const size_t slot = static_cast<size_t>(rightSlot_[nonterminal]);
+                        ends[slot * endsSize + endsOffset[j] + i / 64] |= uint64_t(1) << (i % 64);
+                        if (endsLow[slot * (n + 1) + j] == kNone) {
+                            endsHigh[slot * (n + 1) + j] = static_cast<uint32_t>(i);
+                        }
+                        endsLow[slot * (n + 1) + j] = static_cast<uint32_t>(i);
+                    }
+                    ++derived[worker];
+                }
+            }
+        };
+
+        auto span = [&](unsigned worker, size_t i, size_t length) {
+            const size_t j = i + length;
+            uint64_t* cell = cells.data() + i * words;
+            if (length == 1) {
+                const uint64_t* set = grammar_.terminalSet(word[i]);
+                std::copy(set, set + words, cell);
+            } else {
+                std::fill(cell, cell + words, 0);
+                for (size_t r = 0; r < rules.size();) {
+                    const ChomskyGrammar::BinaryRule& rule = rules[r];
+                    const size_t left = static_cast<size_t>(leftSlot_[rule.left]);
+                    const size_t right = static_cast<size_t>(rightSlot_[rule.right]);
+                    const uint32_t low = std::max(startsLow[left * n + i], endsLow[right * (n + 1) + j]);
+                    const uint32_t high = std::min(startsHigh[left * n + i], endsHigh[right * (n + 1) + j]);
+                    uint64_t any = 0;
+                    if (low <= high) {
+                        const uint64_t* leftRow = starts.data() + left * startsSize + startsOffset[i] - i / 64;
+                        const uint64_t* rightRow = ends.data() + right * endsSize + endsOffset[j];
+                        for (size_t w = low / 64; w <= high / 64 && any == 0; ++w) {
+                            any = leftRow[w] & rightRow[w];
+                        }
+                    }
+                    if (any != 0) {
+                        cell[rule.head / 64] |= uint64_t(1) << (rule.head % 64);
+                        r = nextHead_[r];
+                    } else {
+                        ++r;
+                    }
+                }
+            }
+            publish(worker, i, j);
+        };
+
+        for (size_t length = 1; length <= n; ++length) {
+            const size_t spans = n - length + 1;
+            if (pool && spans > 1) {
+                pool->parallelFor(spans, [&](unsigned worker, size_t i) { span(worker, i, length); });
+            } else {
+                for (size_t i = 0; i < spans; ++i) {
+                    span(0, i, length);
+                }
+            }
+        }
+
+        result.accepted = (cells[grammar_.start() / 64] >> (grammar_.start() % 64)) & 1;
+        for (size_t count : derived) {
+            result.derived += count;
+        }
+        return result;
+    }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    const ChomskyGrammar& grammar_;
+    std::vector<int32_t> leftSlot_;    // nonterminal -> index of its starts rows, -1 if never a left child
+    std::vector<int32_t> rightSlot_;   // nonterminal -> index of its ends rows, -1 if never a right child
+    size_t leftCount_ = 0;
+    size_t rightCount_ = 0;
+    std::vector<size_t> nextHead_;     // index of the first rule with a later head
+};
+
+/**
+  Earley recognizer on an arbitrary grammar, epsilon productions included.
+
+  An item is a dotted production (an index into all dot positions of all productions) and an
+  origin. Epsilon productions are handled as proposed by Aycock and Horspool: predicting a
+  nullable nonterminal also moves the dot over it, so completion never has to look back into the
+  set being built. Finished sets are indexed by the nonterminal after the dot, which makes a
+  completion a scan of exactly the items waiting for its head. Cubic in the worst case, quadratic
+  on unambiguous grammars and linear on most deterministic ones.
+ */
+class EarleyRecognizer {
+public:
+    struct Result {
+        bool accepted = false;
+        size_t items = 0;
+    };
+
+    explicit EarleyRecognizer(const ContextFreeGrammar& grammar)
+        : grammar_(grammar), nullable_(grammar.nullable()), byHead_(grammar.nonterminalCount()) {
+        const std::vector<ContextFreeGrammar::Production>& productions = grammar.productions();
+        for (size_t i = 0; i < productions.size(); ++i) {
+            byHead_[productions[i].head].push_back(static_cast<uint32_t>(i));
+            for (size_t dot = 0; dot <= productions[i].body.size(); ++dot) {
+                production_.push_back(static_cast<uint32_t>(i));
+                dot_.push_back(static_cast<uint32_t>(dot));
+            }
+            firstItem_.push_back(static_cast<uint32_t>(production_.size() - productions[i].body.size() - 1));
+        }
+    }
+
+    Result recognize(const std::vector<int32_t>& word) const {
+        Result result;
+        if (grammar_.start() < 0) {
+            return result;
+        }
+        const size_t n = word.size();
+        const std::vector<ContextFreeGrammar::Production>& productions = grammar_.productions();
+
+        // Items of every set, and per finished set the items grouped by the nonterminal after the dot
+        std::vector<std::vector<Item>> sets(n + 1);
+        std::vector<std::vector<uint32_t>> waitingStart(n + 1);
+        std::vector<std::vector<Item>> waiting(n + 1);
+        std::unordered_set<uint64_t> present[2];   // items of the current and of the next set
+
+        auto add = [&](size_t set, Item item) {
+            if (present[set & 1].insert((static_cast<uint64_t>(item.origin) << 32) | item.dotted).second) {
+                sets[set].push_back(item);
+            }
+        };
+        auto next = [&](const Item& item) {
+            const std::vector<int32_t>& body = productions[production_[item.dotted]].body;
+            return dot_[item.dotted] < body.size() ? body[dot_[item.dotted]] : kEnd;
+        };
+
+        for (uint32_t i : byHead_[grammar_.start()]) {
+            add(0, Item{firstItem_[i], 0});
+        }
+        for (size_t position = 0; position <= n; ++position) {
+            std::vector<Item>& set = sets[position];
+            for (size_t k = 0; k < set.size(); ++k) {
+                const Item item = set[k];
+                const int32_t symbol = next(item);
+                if (symbol == kEnd) {
+                    // Completions with origin == position are covered by the nullable prediction
+                    if (item.origin == position) {
+                        continue;
+                    }
+                    const int32_t head = productions[production_[item.dotted]].head;
+                    const std::vector<uint32_t>& offsets = waitingStart[item.origin];
+                    for (uint32_t w = offsets[head]; w < offsets[head + 1]; ++w) {
+                        const Item& parent = waiting[item.origin][w];
+                        add(position, Item{parent.dotted + 1, parent.origin});
+                    }
+                } else if (ContextFreeGrammar::isTerminal(symbol)) {
+                    if (position < n && word[position] == ContextFreeGrammar::terminal(symbol)) {
+                        add(position + 1, Item{item.dotted + 1, item.origin});
+                    }
+                } else {
+                    for (uint32_t i : byHead_[symbol]) {
+                        add(position, Item{firstItem_[i], static_cast<uint32_t>(position)});
+                    }
+                    if (nullable_[symbol]) {
+                        add(position, Item{item.dotted + 1, item.origin});
+                    }
+                }
+            }
+            result.items += set.size();
+            present[position & 1].clear();
+            indexWaiting(set, next, waitingStart[position], waiting[position]);
+        }
+
+        for (const Item& item : sets[n]) {
+            if (item.origin == 0 && next(item) == kEnd && productions[production_[item.dotted]].head == grammar_.start()) {
+                result.accepted = true;
+                break;
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Item {
+        uint32_t dotted;   // index into production_ / dot_
+        uint32_t origin;
+    };
+
+    static constexpr int32_t kEnd = INT32_MAX;
+
+    const ContextFreeGrammar& grammar_;
+    std::vector<char> nullable_;
+    std::vector<std::vector<uint32_t>> byHead_;
+    std::vector<uint32_t> production_;   // dotted item -> production
+    std::vector<uint32_t> dot_;          // dotted item -> dot position
+    std::vector<uint32_t> firstItem_;    // production -> dotted item with the dot in front
+
+    // Counting sort of the items of a finished set by the nonterminal after their dot
+    template <typename Next>
+    void indexWaiting(const std::vector<Item>& set, const Next& next, std::vector<uint32_t>& start,
+                      std::vector<Item>& items) const {
+        start.assign(grammar_.nonterminalCount() + 1, 0);
+        for (const Item& item : set) {
+            int32_t symbol = next(item);
+            if (symbol != kEnd && !ContextFreeGrammar::isTerminal(symbol)) {
+                ++start[symbol + 1];
+            }
+        }
+        for (size_t i = 1; i < start.size(); ++i) {
+            start[i] += start[i - 1];
+        }
+        items.resize(start.back());
+        std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+        for (const Item& item : set) {
+            int32_t symbol = next(item);
+            if (symbol != kEnd && !ContextFreeGrammar::isTerminal(symbol)) {
+                items[fill[symbol]++] = item;
+            }
+        }
+    }
+};
+
+#endif
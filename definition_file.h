@@ -0,0 +1,429 @@
+#ifndef DEFINITION_FILE_H
+#define DEFINITION_FILE_H
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DEFINITION_FILE_MMAP 1
+#endif
+
+/**
+  Read-only view of a whole file.
+
+  Regular files are memory-mapped, so loading a definition never copies it: the loaders tokenize
+  straight out of the page cache. Anything that cannot be mapped (pipes, empty files, systems
+  without mmap) is read into a buffer instead, behind the same interface.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef DEFINITION_FILE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(mapped);
+                size_ = static_cast<size_t>(info.st_size);
+                mapped_ = true;
+                ::close(fd);
+                return true;
+            }
+        }
+        ::close(fd);
+#endif
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        return true;
+    }
+
+    void close() {
+#ifdef DEFINITION_FILE_MMAP
+        if (mapped_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+        mapped_ = false;
+        data_ = nullptr;
+        size_ = 0;
+        buffer_.clear();
+    }
+
+    std::string_view contents() const {
+        return std::string_view(data_, size_);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::string buffer_;
+};
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline std::string_view trimView(std::string_view text) {
+    size_t first = 0;
+    while (first < text.size() && isBlank(text[first])) {
+        ++first;
+    }
+    size_t last = text.size();
+    while (last > first && isBlank(text[last - 1])) {
+        --last;
+    }
+    return text.substr(first, last - first);
+}
+
+// Splits `line` on whitespace into at most `max` tokens; returns the number of tokens in the line
+inline size_t splitTokens(std::string_view line, std::string_view* tokens, size_t max) {
+    size_t count = 0;
+    size_t at = 0;
+    while (true) {
+        while (at < line.size() && isBlank(line[at])) {
+            ++at;
+        }
+        if (at == line.size()) {
+            return count;
+        }
+        size_t begin = at;
+        while (at < line.size() && !isBlank(line[at])) {
+            ++at;
+        }
+        if (count < max) {
+            tokens[count] = line.substr(begin, at - begin);
+        }
+        ++count;
+    }
+}
+
+/**
+  Walks a definition file line by line. next() yields every line with surrounding whitespace
+  removed, skipping empty lines and # comments; the views point into the scanned text.
+ */
+class DefinitionScanner {
+public:
+    explicit DefinitionScanner(std::string_view text) : text_(text) {}
+
+    bool next(std::string_view& line) {
+        while (at_ < text_.size()) {
+            size_t end = text_.find('\n', at_);
+            if (end == std::string_view::npos) {
+                end = text_.size();
+            }
+            line = trimView(text_.substr(at_, end - at_));
+            at_ = end + 1;
+            if (!line.empty() && line[0] != '#') {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // True for "[name]" lines; `name` is what is between the brackets
+    static bool isSection(std::string_view line, std::string_view& name) {
+        if (line.size() < 2 || line.front() != '[' || line.back() != ']') {
+            return false;
+        }
+        name = line.substr(1, line.size() - 2);
+        return true;
+    }
+
+private:
+    std::string_view text_;
+    size_t at_ = 0;
+};
+
+/**
+  Whitespace-separated tokens of a file or of standard input ("-"), read in chunks as they
+  arrive instead of all at once: on a pipe, next() returns as soon as the read that completes a
+  token does. The chunk buffer is reused; a token cut by the end of a chunk is moved to its front
+  and completed by the next read, and only a token longer than a whole chunk grows the buffer.
+  The views returned by next() stay valid until the following call.
+ */
+class TokenStream {
+public:
+    explicit TokenStream(size_t chunkBytes = 1 << 20) : buffer_(chunkBytes) {}
+
+    ~TokenStream() {
+        close();
+    }
+
+    TokenStream(const TokenStream&) = delete;
+    TokenStream& operator=(const TokenStream&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        pos_ = end_ = 0;
+        eof_ = failed_ = false;
+        bytes_ = 0;
+#ifdef DEFINITION_FILE_MMAP
+        fd_ = path == "-" ? 0 : ::open(path.c_str(), O_RDONLY);
+        return fd_ >= 0;
+#else
+        if (path == "-") {
+            in_ = &std::cin;
+            return true;
+        }
+        file_.open(path, std::ios::binary);
+        in_ = &file_;
+        return file_.is_open();
+#endif
+    }
+
+    void close() {
+#ifdef DEFINITION_FILE_MMAP
+        if (fd_ > 0) {
+            ::close(fd_);
+        }
+        fd_ = -1;
+#else
+        if (file_.is_open()) {
+            file_.close();
+        }
+        in_ = nullptr;
+#endif
+    }
+
+    bool next(std::string_view& token) {
+        while (true) {
+            while (pos_ < end_ && isBlank(buffer_[pos_])) {
+                ++pos_;
+            }
+            const size_t begin = pos_;
+            while (pos_ < end_ && !isBlank(buffer_[pos_])) {
+                ++pos_;
+            }
+            if (pos_ < end_ || (eof_ && pos_ > begin)) {
+                token = std::string_view(buffer_.data() + begin, pos_ - begin);
+                return true;
+            }
+            if (eof_) {
+                return false;
+            }
+
+            // The token may go on in the next chunk: keep its start and read after it
+            const size_t kept = end_ - begin;
+            std::memmove(buffer_.data(), buffer_.data() + begin, kept);
+            if (kept == buffer_.size()) {
+                buffer_.resize(buffer_.size() * 2);
+            }
+            pos_ = 0;
+            end_ = kept;
+            fill();
+        }
+    }
+
+    // True if reading stopped on an error rather than at the end of the input
+    bool failed() const {
+        return failed_;
+    }
+
+    uint64_t bytesRead() const {
+        return bytes_;
+    }
+
+private:
+    std::vector<char> buffer_;
+    size_t pos_ = 0;
+    size_t end_ = 0;
+    bool eof_ = false;
+    bool failed_ = false;
+    uint64_t bytes_ = 0;
+#ifdef DEFINITION_FILE_MMAP
+    int fd_ = -1;
+#else
+    std::ifstream file_;
+    std::istream* in_ = nullptr;
+#endif
+
+    void fill() {
+#ifdef DEFINITION_FILE_MMAP
+        ssize_t count;
+        do {
+            count = ::read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+        } while (count < 0 && errno == EINTR);
+        failed_ = count < 0;
+#else
+        in_->read(buffer_.data() + end_, static_cast<std::streamsize>(buffer_.size() - end_));
+        std::streamsize count = in_->gcount();
+        failed_ = in_->bad();
+#endif
+        if (count <= 0) {
+            eof_ = true;
+            return;
+        }
+        end_ += static_cast<size_t>(count);
+        bytes_ += static_cast<uint64_t>(count);
+    }
+};
+
+/**
+  Interns names into dense ids 0, 1, 2, ... in order of first appearance.
+
+  Lookups take a string_view, so tokens are hashed straight out of the file and only a name seen
+  for the first time is copied. Every slot of the open addressing table packs the 32-bit hash of
+  its name next to the id, so probing and growing the table only touch the slot array and a name
+  is compared only when its hash matches. A small direct-mapped cache of recent lookups sits in
+  front of the table: definitions name the same few states on consecutive lines, and those
+  lookups then never touch the (possibly huge) table at all.
+ */
+class NameTable {
+public:
+    static constexpr int32_t kMissing = -1;
+
+    int32_t intern(std::string_view name) {
+        if ((names_.size() + 1) * 2 > slots_.size()) {
+            rehash(slots_.empty() ? 64 : slots_.size() * 2);
+        }
+        const uint32_t hash = hashOf(name);
+        uint64_t& recent = recent_[hash & (kRecentSize - 1)];
+        if (recent != kEmptySlot && (recent >> 32) == hash && names_[idOf(recent)] == name) {
+            return idOf(recent);
+        }
+        size_t slot = findSlot(name, hash);
+        if (slots_[slot] == kEmptySlot) {
+            slots_[slot] = (static_cast<uint64_t>(hash) << 32) | names_.size();
+            names_.emplace_back(name);
+        }
+        recent = slots_[slot];
+        return idOf(recent);
+    }
+
+    int32_t find(std::string_view name) const {
+        if (slots_.empty()) {
+            return kMissing;
+        }
+        uint64_t entry = slots_[findSlot(name, hashOf(name))];
+        return entry == kEmptySlot ? kMissing : idOf(entry);
+    }
+
+    const std::string& name(int32_t id) const {
+        return names_[id];
+    }
+
+    size_t size() const {
+        return names_.size();
+    }
+
+    void clear() {
+        names_.clear();
+        slots_.clear();
+        recent_.fill(kEmptySlot);
+    }
+
+private:
+    static constexpr uint64_t kEmptySlot = UINT64_MAX;
+    static constexpr size_t kRecentSize = 1024;
+
+    std::vector<std::string> names_;
+    std::vector<uint64_t> slots_;   // hash << 32 | id, kEmptySlot if unused
+    std::array<uint64_t, kRecentSize> recent_ = makeRecent();
+
+    static std::array<uint64_t, kRecentSize> makeRecent() {
+        std::array<uint64_t, kRecentSize> recent;
+        recent.fill(kEmptySlot);
+        return recent;
+    }
+
+    // Names are short tokens: hash them eight bytes at a time, inline, and finish with a
+    // murmur-style mix so that the low bits used to pick a slot depend on every byte
+    static uint32_t hashOf(std::string_view name) {
+        uint64_t hash = 0x9E3779B97F4A7C15ULL ^ name.size();
+        size_t at = 0;
+        for (; at + 8 <= name.size(); at += 8) {
+            uint64_t word;
+            std::memcpy(&word, name.data() + at, 8);
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+            hash ^= hash >> 32;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, name.data() + at, name.size() - at);
+        hash ^= tail;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ULL;
+        hash ^= hash >> 33;
+        return static_cast<uint32_t>(hash);
+    }
+
+    static int32_t idOf(uint64_t entry) {
+        return static_cast<int32_t>(entry & 0xFFFFFFFFu);
+    }
+
+    size_t findSlot(std::string_view name, uint32_t hash) const {
+        const size_t mask = slots_.size() - 1;
+        size_t slot = hash & mask;
+        while (slots_[slot] != kEmptySlot &&
+               ((slots_[slot] >> 32) != hash || names_[idOf(slots_[slot])] != name)) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void rehash(size_t size) {
+        std::vector<uint64_t> old;
+        old.swap(slots_);
+        slots_.assign(size, kEmptySlot);
+        const size_t mask = size - 1;
+        for (uint64_t entry : old) {
+            if (entry == kEmptySlot) {
+                continue;
+            }
+            size_t slot = (entry >> 32) & mask;
+            while (slots_[slot] != kEmptySlot) {
+                slot = (slot + 1) & mask;
+            }
+            slots_[slot] = entry;
+        }
+    }
+};
+
+// Reports how fast a definition file was parsed, on stderr so it never mixes with run output
+inline void reportLoad(const std::string& path, size_t bytes, double seconds) {
+    double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    std::cerr << "Loaded " << path << ": " << megabytes << " MB in " << seconds << " s";
+    if (seconds > 0) {
+        std::cerr << " (" << megabytes / seconds << " MB/s)";
+    }
+    std::cerr << std::endl;
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "dfa_nfa.h"
+
+// Usage: ./dfa_nfa [--batch inputs.txt] [--kernel scalar|interleaved|avx2|avx512|auto] [--threads N]
+//                  [--lazy MB] [--quiet | --stats] [definition file]
+//        ./dfa_nfa --minimal out.txt [definition file]
+//        ./dfa_nfa --bench corpus.txt [--threads N] [--lazy MB] [definition file]
+// A single run reads one input line; a batch run classifies every line of the inputs file, by
+// default with the widest multi-stream kernel the processor supports. Inputs of 4 MB or more are
+// split into chunks run in parallel. --lazy MB builds DFA states on the fly, in at most MB
+// megabytes, instead of the full minimal DFA. --minimal writes the minimal DFA of the automaton
+// in the same format as the definition; --bench times every kernel on the lines of the corpus.
+int main(int argc, char* argv[]) {
+    FiniteAutomaton automaton;
+    std::string filename;
+    std::string batchPath;
+    std::string minimalPath;
+    std::string benchPath;
+    unsigned threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--minimal" && i + 1 < argc) {
+            minimalPath = argv[++i];
+        } else if (arg == "--lazy" && i + 1 < argc) {
+            automaton.setLazyCache(static_cast<size_t>(std::stoul(argv[++i])) << 20);
+        } else if (arg == "--bench" && i + 1 < argc) {
+            benchPath = argv[++i];
+        } else if (arg == "--kernel" && i + 1 < argc) {
+            std::string name = argv[++i];
+            bool known = false;
+            for (auto kernel : {FiniteAutomaton::Kernel::Scalar, FiniteAutomaton::Kernel::Interleaved, FiniteAutomaton::Kernel::Avx2,
+                                FiniteAutomaton::Kernel::Avx512, FiniteAutomaton::Kernel::Auto}) {
+                if (name == FiniteAutomaton::kernelName(kernel)) {
+                    if (!FiniteAutomaton::isSupported(kernel)) {
+                        std::cerr << "Kernel " << name << " is not supported by this processor" << std::endl;
+                        return 1;
+                    }
+                    automaton.setKernel(kernel);
+                    known = true;
+                }
+            }
+            if (!known) {
+                std::cerr << "Unknown kernel: " << name << std::endl;
+                return 1;
+            }
+        } else if (arg == "--quiet") {
+            automaton.setOutputLevel(OutputLevel::Verdict);
+        } else if (arg == "--stats") {
+            automaton.setOutputLevel(OutputLevel::Summary);
+        } else if (arg[0] != '-' && filename.empty()) {
+            filename = arg;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (filename.empty()) {
+        std::cout << "Enter automaton definition filename: ";
+        std::getline(std::cin, filename);
+    }
+
+    if (!automaton.loadAutomaton(filename)) {
+        std::cout << "Failed to load automaton from file: " << filename << std::endl;
+        return 1;
+    }
+    if (!automaton.isValidAutomaton()) {
+        automaton.reportErrors();
+        return 1;
+    }
+    if (!minimalPath.empty()) {
+        if (automaton.isLazy()) {
+            std::cerr << "--minimal needs the full DFA and cannot be combined with --lazy" << std::endl;
+            return 1;
+        }
+        return automaton.writeMinimal(minimalPath) ? 0 : 1;
+    }
+    if (!benchPath.empty()) {
+        return automaton.runBench(benchPath, threads) ? 0 : 1;
+    }
+    if (!batchPath.empty()) {
+        return automaton.runBatch(batchPath, threads) ? 0 : 1;
+    }
+    automaton.setThreads(threads);
+    automaton.startAutomaton();
+    return 0;
+}
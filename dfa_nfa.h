@@ -0,0 +1,1391 @@
+#ifndef DFA_NFA_H
+#define DFA_NFA_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DFA_NFA_X86 1
+#endif
+
+#include "definition_file.h"
+#include "trace_sink.h"
+#include "work_stealing_pool.h"
+
+/**
+  FiniteAutomaton class for DFA and NFA definitions, the C++ counterpart of DFA_NFA.py
+
+  Input file follows the format of DFA_NFA.py: every section sits between [start] and [end] and
+  names its keyword on its first line, anything after [eof] is ignored and # starts a comment.
+  [start]
+  keyword:alphabet          (one single-character symbol per line)
+  keyword:states            (one state per line)
+  keyword:firstState        (exactly one state)
+  keyword:acceptedStates    (any number of states)
+  keyword:delta             ((state,symbol)=state or, for an NFA, (state,symbol)=state_1,...,state_n;
+                             the symbol ε marks an epsilon transition)
+  [end]
+
+  Every automaton, deterministic or not, is compiled the same way: epsilon closures are computed
+  as bitsets over the NFA states, subset construction builds the reachable DFA with a hashed cache
+  of the subsets already seen, and Hopcroft's algorithm minimises it. The result is a dense table
+  of uint32_t with one column per alphabet symbol plus one for every other byte, whose entries are
+  premultiplied by the row length, so classifying a byte is a class lookup and one load. A missing
+  transition leads to a dead state, which rejects like a missing transition in DFA_NFA.py.
+ */
+class FiniteAutomaton {
+public:
+    static constexpr int32_t kEpsilon = -1;
+
+    // How batches of inputs are run: one input after another, or several streams interleaved per
+    // core with scalar loads or with AVX2 / AVX-512 gathers
+    enum class Kernel {
+        Scalar,
+        Interleaved,
+        Avx2,
+        Avx512,
+        Auto
+    };
+
+private:
+    // A line of the delta section with its states interned
+    struct DeltaLine {
+        int32_t from;
+        int32_t symbol;           // byte of the symbol, kEpsilon for ε
+        std::vector<int32_t> to;
+    };
+
+    // Definition as loaded, states interned into `names`
+    NameTable names;
+    std::vector<int32_t> stateLines;
+    std::vector<char> isState;                           // indexed by name id
+    std::vector<uint8_t> alphabet;                       // symbols without duplicates, in file order
+    int32_t firstState = -1;
+    std::vector<int32_t> acceptedLines;
+    std::vector<DeltaLine> deltaLines;
+    std::vector<std::string> errors;
+
+    // Compiled representation, built by compile()
+    uint32_t classCount = 1;                             // alphabet symbols plus the class of other bytes
+    std::array<uint32_t, 256> classOf{};                 // byte -> column, 0 for bytes outside the alphabet
+    std::vector<uint32_t> table;                         // row-major, entries premultiplied by classCount
+    std::vector<uint8_t> accepting;                      // indexed by state
+    uint32_t start = 0;                                  // premultiplied like the table entries
+    uint32_t dead = 0;                                   // premultiplied; the state no input leaves
+
+    // Sizes of the intermediate automata, for --stats
+    size_t nfaStates = 0;
+    size_t nfaTransitions = 0;
+    size_t subsetStates = 0;
+
+    // The NFA as bitsets of its states, built by compile() and kept only for lazy determinisation
+    size_t subsetWords = 0;                              // 64-bit words per subset
+    std::vector<uint64_t> moves;                         // (state * classCount + class) -> subset closed under ε
+    std::vector<uint64_t> acceptedSet;
+    std::vector<uint64_t> startSet;
+
+    OutputLevel outputLevel = OutputLevel::Verdict;
+    Kernel kernel = Kernel::Auto;
+    unsigned threads = 0;
+    size_t lazyCache = 0;                                // bytes for lazy DFA states; 0 builds the full minimal DFA
+
+    // Subsets of NFA states stored back to back, `words` 64-bit words each, with an open addressing
+    // index so that a subset is found again in O(words)
+    class SubsetCache {
+    public:
+        static constexpr uint32_t kMissing = UINT32_MAX;
+
+        explicit SubsetCache(size_t words) : words(words) {}
+
+        // Id of the subset, kMissing if it was never added
+        uint32_t find(const uint64_t* subset) const {
+            return slots.empty() ? kMissing : slots[findSlot(subset)];
+        }
+
+        // Id of the subset, adding it if it is new; `added` tells which
+        uint32_t intern(const uint64_t* subset, bool& added) {
+            if ((count() + 1) * 2 > slots.size()) {
+                rehash(slots.empty() ? 1024 : slots.size() * 2);
+            }
+            size_t slot = findSlot(subset);
+            added = slots[slot] == kUnused;
+            if (added) {
+                slots[slot] = static_cast<uint32_t>(count());
+                subsets.insert(subsets.end(), subset, subset + words);
+            }
+            return slots[slot];
+        }
+
+        const uint64_t* operator[](uint32_t id) const {
+            return subsets.data() + static_cast<size_t>(id) * words;
+        }
+
+        size_t count() const {
+            return words == 0 ? 0 : subsets.size() / words;
+        }
+
+        void clear() {
+            subsets.clear();
+            slots.clear();
+        }
+
+    private:
+        static constexpr uint32_t kUnused = kMissing;
+
+        size_t words;
+        std::vector<uint64_t> subsets;
+        std::vector<uint32_t> slots;
+
+        size_t hashOf(const uint64_t* subset) const {
+            uint64_t hash = 0x9E3779B97F4A7C15ULL;
+            for (size_t w = 0; w < words; ++w) {
+                hash = (hash ^ subset[w]) * 0xFF51AFD7ED558CCDULL;
+                hash ^= hash >> 32;
+            }
+            return static_cast<size_t>(hash);
+        }
+
+        size_t findSlot(const uint64_t* subset) const {
+            const size_t mask = slots.size() - 1;
+            size_t slot = hashOf(subset) & mask;
+            while (slots[slot] != kUnused &&
+                   !std::equal(subset, subset + words, subsets.data() + static_cast<size_t>(slots[slot]) * words)) {
+                slot = (slot + 1) & mask;
+            }
+            return slot;
+        }
+
+        void rehash(size_t size) {
+            slots.assign(size, kUnused);
+            for (size_t id = 0; id < count(); ++id) {
+                slots[findSlot(subsets.data() + id * words)] = static_cast<uint32_t>(id);
+            }
+        }
+    };
+
+    /*
+      DFA determinised lazily over the NFA bitsets, for automata whose full subset construction
+      would blow up. A DFA state is built the first time an input reaches it and kept in a
+      SubsetCache next to its row of transitions, the ones not followed yet marked kUnknown. When
+      the states would outgrow the memory budget the cache is flushed and refilled from the current
+      state on, as RE2 does. If the cache fills again before it has run kMinBytesPerState input
+      bytes per state it holds, it is thrashing: the rest of that input is run by simulating the NFA
+      directly over bitsets. One LazyDfa serves one thread.
+     */
+    class LazyDfa {
+    public:
+        static constexpr size_t kMinBytesPerState = 10;
+
+        // What a run cost, for --stats
+        struct Stats {
+            size_t statesBuilt = 0;
+            size_t flushes = 0;
+            size_t simulatedInputs = 0;
+        };
+
+        LazyDfa(const FiniteAutomaton& automaton, size_t budget)
+            : automaton(automaton), cache(automaton.subsetWords), subset(automaton.subsetWords), spare(automaton.subsetWords) {
+            const size_t stateBytes = automaton.subsetWords * 8 + automaton.classCount * 4 + 1 + 2 * sizeof(uint32_t);
+            capacity = std::max<size_t>(budget / stateBytes, 8);
+            flush();
+        }
+
+        bool accepts(const char* data, size_t size) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+            const uint32_t* classOf = automaton.classOf.data();
+            uint32_t state = start;
+            for (size_t at = 0; at < size; ++at) {
+                const uint32_t c = classOf[bytes[at]];
+                uint32_t to = next[state + c];
+                if (to == kUnknown) {
+                    to = build(state, c, at);
+                    if (to == kUnknown) {
+                        ++stats.simulatedInputs;
+                        scanned += size;
+                        return simulate(bytes + at + 1, size - at - 1);
+                    }
+                }
+                state = to;
+                if (state == 0) {
+                    scanned += size;
+                    return false;
+                }
+            }
+            scanned += size;
+            return accepting[state / automaton.classCount] != 0;
+        }
+
+        // Runs the NFA directly from its start state, without building DFA states
+        bool simulateFromStart(const char* data, size_t size) {
+            std::copy(automaton.startSet.begin(), automaton.startSet.end(), subset.begin());
+            return simulate(reinterpret_cast<const uint8_t*>(data), size);
+        }
+
+        const Stats& statistics() const {
+            return stats;
+        }
+
+    private:
+        static constexpr uint32_t kUnknown = UINT32_MAX;
+
+        const FiniteAutomaton& automaton;
+        size_t capacity;                     // DFA states that fit in the budget
+        SubsetCache cache;
+        std::vector<uint32_t> next;          // premultiplied by classCount, kUnknown if not built yet
+        std::vector<uint8_t> accepting;
+        uint32_t start = 0;
+        size_t scanned = 0;                  // bytes of the inputs finished so far
+        size_t flushedAt = 0;                // value of scanned plus the position in the input at the last flush
+        std::vector<uint64_t> subset;
+        std::vector<uint64_t> spare;
+        Stats stats;
+
+        // Empties the cache, keeping the dead state as state 0 and the start state
+        void flush() {
+            cache.clear();
+            next.clear();
+            accepting.clear();
+            std::fill(subset.begin(), subset.end(), 0);
+            add(subset.data());
+            start = add(automaton.startSet.data());
+        }
+
+        uint32_t add(const uint64_t* members) {
+            bool added;
+            const uint32_t id = cache.intern(members, added);
+            if (!added) {
+                return id * automaton.classCount;
+            }
+            uint8_t isAccepting = 0;
+            for (size_t w = 0; w < automaton.subsetWords; ++w) {
+                isAccepting |= (members[w] & automaton.acceptedSet[w]) != 0;
+            }
+            accepting.push_back(isAccepting);
+            next.push_back(0);
+            next.insert(next.end(), automaton.classCount - 1, id == 0 ? 0 : kUnknown);
+            ++stats.statesBuilt;
+            return id * automaton.classCount;
+        }
+
+        // Sets `into` to the NFA states reached from the states in `from` by the class
+        void move(const uint64_t* from, uint32_t c, std::vector<uint64_t>& into) const {
+            std::fill(into.begin(), into.end(), 0);
+            const size_t words = automaton.subsetWords;
+            for (size_t w = 0; w < words; ++w) {
+                for (uint64_t rest = from[w]; rest != 0; rest &= rest - 1) {
+                    const size_t member = w * 64 + __builtin_ctzll(rest);
+                    const uint64_t* targets = automaton.moves.data() + (member * automaton.classCount + c) * words;
+                    for (size_t v = 0; v < words; ++v) {
+                        into[v] |= targets[v];
+                    }
+                }
+            }
+        }
+
+        // Follows the class from `state` for the first time, `at` bytes into the current input.
+        // Returns the premultiplied next state, or kUnknown if the cache is thrashing; `subset` then
+        // holds the NFA states reached.
+        uint32_t build(uint32_t state, uint32_t c, size_t at) {
+            move(cache[state / automaton.classCount], c, subset);
+            const uint32_t id = cache.find(subset.data());
+            if (id != SubsetCache::kMissing) {
+                return next[state + c] = id * automaton.classCount;
+            }
+            if (cache.count() < capacity) {
+                const uint32_t to = add(subset.data());
+                return next[state + c] = to;
+            }
+            const bool thrashing = scanned + at - flushedAt < kMinBytesPerState * capacity;
+            std::vector<uint64_t> reached(subset);
+            flush();
+            ++stats.flushes;
+            flushedAt = scanned + at;
+            subset.swap(reached);
+            return thrashing ? kUnknown : add(subset.data());
+        }
+
+        // Runs the NFA over the bytes from the states in `subset`
+        bool simulate(const uint8_t* bytes, size_t size) {
+            const uint32_t* classOf = automaton.classOf.data();
+            for (size_t at = 0; at < size; ++at) {
+                move(subset.data(), classOf[bytes[at]], spare);
+                subset.swap(spare);
+                if (std::all_of(subset.begin(), subset.end(), [](uint64_t word) { return word == 0; })) {
+                    return false;
+                }
+            }
+            for (size_t w = 0; w < automaton.subsetWords; ++w) {
+                if (subset[w] & automaton.acceptedSet[w]) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    // Helper function to split a comma separated list, trimming every item
+    static std::vector<std::string_view> splitList(std::string_view list) {
+        std::vector<std::string_view> items;
+        size_t at = 0;
+        while (true) {
+            size_t comma = list.find(',', at);
+            items.push_back(trimView(list.substr(at, comma == std::string_view::npos ? std::string_view::npos : comma - at)));
+            if (comma == std::string_view::npos) {
+                return items;
+            }
+            at = comma + 1;
+        }
+    }
+
+    int32_t stateOf(std::string_view name) const {
+        int32_t id = names.find(name);
+        return id != NameTable::kMissing && static_cast<size_t>(id) < isState.size() && isState[id] ? id : -1;
+    }
+
+    // Parses "(state,symbol)=state_1,...,state_n"; malformed lines are skipped, as DFA_NFA.py does
+    void addDeltaLine(std::string_view line, std::vector<std::pair<std::string_view, std::vector<std::string_view>>>& raw) {
+        size_t equals = line.find('=');
+        if (equals == std::string_view::npos) {
+            return;
+        }
+        std::string_view left = trimView(line.substr(0, equals));
+        if (left.size() < 2 || left.front() != '(' || left.back() != ')') {
+            return;
+        }
+        std::vector<std::string_view> key = splitList(left.substr(1, left.size() - 2));
+        if (key.size() < 2) {
+            return;
+        }
+        std::vector<std::string_view> targets = splitList(line.substr(equals + 1));
+        targets.insert(targets.begin(), key[1]);
+        targets.insert(targets.begin(), key[0]);
+        raw.emplace_back(line, std::move(targets));
+    }
+
+    // Epsilon closure of every NFA state as a bitset, one DFS per state
+    std::vector<uint64_t> epsilonClosures(const std::vector<std::vector<uint32_t>>& epsilon, size_t words) const {
+        std::vector<uint64_t> closures(nfaStates * words, 0);
+        std::vector<uint32_t> stack;
+        for (size_t state = 0; state < nfaStates; ++state) {
+            uint64_t* closure = closures.data() + state * words;
+            closure[state / 64] |= uint64_t(1) << (state % 64);
+            stack.assign(1, static_cast<uint32_t>(state));
+            while (!stack.empty()) {
+                uint32_t current = stack.back();
+                stack.pop_back();
+                for (uint32_t next : epsilon[current]) {
+                    if (!(closure[next / 64] >> (next % 64) & 1)) {
+                        closure[next / 64] |= uint64_t(1) << (next % 64);
+                        stack.push_back(next);
+                    }
+                }
+            }
+        }
+        return closures;
+    }
+
+    /*
+      Hopcroft's minimisation of a complete DFA given as next[state * classes + class], refining the
+      accepting / rejecting partition. Blocks are ranges of `elements`; a splitter (block, class) marks
+      the predecessors of the block under the class by moving them to the front of their own block, and
+      every block left partly marked is cut in two. Of the two halves only the smaller is queued, unless
+      the block was still waiting as a splitter for that class, which keeps the work at O(k n log n).
+      Returns the block of every state; block ids are dense.
+     */
+    std::vector<uint32_t> minimise(const std::vector<uint32_t>& next, const std::vector<uint8_t>& isAccepting,
+                                   size_t states, size_t classes) const {
+        // Predecessors of every state for every class except the class of other bytes, which leads
+        // every state to the dead state and so never splits anything
+        std::vector<uint32_t> predecessorStart((states * classes) + 1, 0);
+        for (size_t state = 0; state < states; ++state) {
+            for (size_t c = 1; c < classes; ++c) {
+                predecessorStart[next[state * classes + c] * classes + c + 1]++;
+            }
+        }
+        for (size_t i = 1; i < predecessorStart.size(); ++i) {
+            predecessorStart[i] += predecessorStart[i - 1];
+        }
+        std::vector<uint32_t> predecessors(predecessorStart.back());
+        std::vector<uint32_t> fill(predecessorStart.begin(), predecessorStart.end() - 1);
+        for (size_t state = 0; state < states; ++state) {
+            for (size_t c = 1; c < classes; ++c) {
+                predecessors[fill[next[state * classes + c] * classes + c]++] = static_cast<uint32_t>(state);
+            }
+        }
+
+        // Partition: block b is elements[first[b], end[b]), its marked states elements[first[b], marked[b])
+        std::vector<uint32_t> elements(states);
+        std::vector<uint32_t> location(states);
+        std::vector<uint32_t> blockOf(states);
+        std::vector<uint32_t> first;
+        std::vector<uint32_t> end;
+        std::vector<uint32_t> marked;
+        size_t at = 0;
+        for (uint8_t kind = 0; kind < 2; ++kind) {
+            size_t begin = at;
+            for (size_t state = 0; state < states; ++state) {
+                if ((isAccepting[state] != 0) == (kind == 1)) {
+                    location[state] = static_cast<uint32_t>(at);
+                    elements[at++] = static_cast<uint32_t>(state);
+                    blockOf[state] = static_cast<uint32_t>(first.size());
+                }
+            }
+            if (at > begin) {
+                first.push_back(static_cast<uint32_t>(begin));
+                end.push_back(static_cast<uint32_t>(at));
+                marked.push_back(static_cast<uint32_t>(begin));
+            }
+        }
+
+        std::vector<std::pair<uint32_t, uint32_t>> work;   // (block, class) splitters
+        std::vector<char> waiting(first.size() * classes, 0);
+        auto queue = [&](uint32_t block, size_t c) {
+            if (waiting.size() < (block + 1) * classes) {
+                waiting.resize((block + 1) * classes, 0);
+            }
+            if (!waiting[block * classes + c]) {
+                waiting[block * classes + c] = 1;
+                work.emplace_back(block, static_cast<uint32_t>(c));
+            }
+        };
+        const uint32_t smaller = first.size() == 2 && end[1] - first[1] < end[0] - first[0] ? 1 : 0;
+        for (size_t c = 1; c < classes; ++c) {
+            queue(smaller, c);
+        }
+
+        std::vector<uint32_t> splitter;
+        std::vector<uint32_t> touched;
+        while (!work.empty()) {
+            const uint32_t block = work.back().first;
+            const size_t c = work.back().second;
+            work.pop_back();
+            waiting[block * classes + c] = 0;
+
+            // The block may be cut while its predecessors are marked, so it is copied first
+            splitter.assign(elements.begin() + first[block], elements.begin() + end[block]);
+            touched.clear();
+            for (uint32_t target : splitter) {
+                for (uint32_t i = predecessorStart[target * classes + c]; i < predecessorStart[target * classes + c + 1]; ++i) {
+                    const uint32_t state = predecessors[i];
+                    const uint32_t owner = blockOf[state];
+                    if (location[state] < marked[owner]) {
+                        continue;
+                    }
+                    if (marked[owner] == first[owner]) {
+                        touched.push_back(owner);
+                    }
+                    const uint32_t swapped = elements[marked[owner]];
+                    std::swap(elements[location[state]], elements[marked[owner]]);
+                    location[swapped] = location[state];
+                    location[state] = marked[owner]++;
+                }
+            }
+
+            for (uint32_t owner : touched) {
+                if (marked[owner] == end[owner]) {
+                    marked[owner] = first[owner];
+                    continue;
+                }
+                // The marked states become a new block
+                const uint32_t created = static_cast<uint32_t>(first.size());
+                first.push_back(first[owner]);
+                end.push_back(marked[owner]);
+                marked.push_back(first[owner]);
+                first[owner] = marked[owner];
+                for (uint32_t i = first[created]; i < end[created]; ++i) {
+                    blockOf[elements[i]] = created;
+                }
+                const uint32_t smallerHalf = end[created] - first[created] <= end[owner] - first[owner] ? created : owner;
+                for (size_t d = 1; d < classes; ++d) {
+                    if (waiting[owner * classes + d]) {
+                        queue(created, d);
+                    } else {
+                        queue(smallerHalf, d);
+                    }
+                }
+            }
+        }
+        return blockOf;
+    }
+
+    // Runs `steps` transitions on every lane; lane l reads data[l][i & masks[l]] at step i, so a
+    // parked lane (mask 0) keeps reading its one idle byte
+    using StepFunction = void (*)(const FiniteAutomaton& automaton, uint32_t* states, const uint8_t* const* data,
+                                  const size_t* masks, size_t steps);
+
+    template <size_t Lanes>
+    static void stepScalar(const FiniteAutomaton& automaton, uint32_t* states, const uint8_t* const* data,
+                           const size_t* masks, size_t steps) {
+        const uint32_t* next = automaton.table.data();
+        const uint32_t* classOf = automaton.classOf.data();
+        uint32_t current[Lanes];
+        std::copy(states, states + Lanes, current);
+        for (size_t i = 0; i < steps; ++i) {
+            for (size_t l = 0; l < Lanes; ++l) {
+                current[l] = next[current[l] + classOf[data[l][i & masks[l]]]];
+            }
+        }
+        std::copy(current, current + Lanes, states);
+    }
+
+#ifdef DFA_NFA_X86
+    // 16 lanes as two vectors of 8: the classes are loaded per lane, the next states gathered
+    __attribute__((target("avx2")))
+    static void stepAvx2(const FiniteAutomaton& automaton, uint32_t* states, const uint8_t* const* data,
+                         const size_t* masks, size_t steps) {
+        const int* next = reinterpret_cast<const int*>(automaton.table.data());
+        const uint32_t* c = automaton.classOf.data();
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + 8));
+        for (size_t i = 0; i < steps; ++i) {
+            const __m256i classesLow = _mm256_setr_epi32(
+                c[data[0][i & masks[0]]], c[data[1][i & masks[1]]], c[data[2][i & masks[2]]], c[data[3][i & masks[3]]],
+                c[data[4][i & masks[4]]], c[data[5][i & masks[5]]], c[data[6][i & masks[6]]], c[data[7][i & masks[7]]]);
+            const __m256i classesHigh = _mm256_setr_epi32(
+                c[data[8][i & masks[8]]], c[data[9][i & masks[9]]], c[data[10][i & masks[10]]], c[data[11][i & masks[11]]],
+                c[data[12][i & masks[12]]], c[data[13][i & masks[13]]], c[data[14][i & masks[14]]], c[data[15][i & masks[15]]]);
+            low = _mm256_i32gather_epi32(next, _mm256_add_epi32(low, classesLow), 4);
+            high = _mm256_i32gather_epi32(next, _mm256_add_epi32(high, classesHigh), 4);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(states), low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(states + 8), high);
+    }
+
+    // 16 lanes in one vector
+    __attribute__((target("avx512f")))
+    static void stepAvx512(const FiniteAutomaton& automaton, uint32_t* states, const uint8_t* const* data,
+                           const size_t* masks, size_t steps) {
+        const int* next = reinterpret_cast<const int*>(automaton.table.data());
+        const uint32_t* c = automaton.classOf.data();
+        __m512i current = _mm512_loadu_si512(states);
+        for (size_t i = 0; i < steps; ++i) {
+            const __m512i classes = _mm512_setr_epi32(
+                c[data[0][i & masks[0]]], c[data[1][i & masks[1]]], c[data[2][i & masks[2]]], c[data[3][i & masks[3]]],
+                c[data[4][i & masks[4]]], c[data[5][i & masks[5]]], c[data[6][i & masks[6]]], c[data[7][i & masks[7]]],
+                c[data[8][i & masks[8]]], c[data[9][i & masks[9]]], c[data[10][i & masks[10]]], c[data[11][i & masks[11]]],
+                c[data[12][i & masks[12]]], c[data[13][i & masks[13]]], c[data[14][i & masks[14]]], c[data[15][i & masks[15]]]);
+            current = _mm512_mask_i32gather_epi32(current, 0xFFFF, _mm512_add_epi32(current, classes), next, 4);
+        }
+        _mm512_storeu_si512(states, current);
+    }
+#endif
+
+    /*
+      Classifies many inputs at once with `Lanes` independent streams. Every lane holds one input;
+      all lanes advance together by as many steps as the shortest one has left, so the step kernel
+      runs without per-byte checks, and a lane whose input ended takes the next one. Interleaving
+      independent streams hides the latency of the dependent table loads of a single stream. The
+      inputs are handed out shortest first (a counting sort on the length), so lanes running side by
+      side end together and the steps between refills stay long. Lanes left without input are
+      parked on an idle byte until the last stream ends.
+     */
+    template <size_t Lanes>
+    void classifyStreams(const std::string_view* lines, size_t count, char* verdicts, StepFunction step) const {
+        constexpr size_t kBuckets = 256;
+        size_t bucketStart[kBuckets + 1] = {};
+        for (size_t i = 0; i < count; ++i) {
+            ++bucketStart[std::min(lines[i].size(), kBuckets - 1) + 1];
+        }
+        for (size_t b = 0; b < kBuckets; ++b) {
+            bucketStart[b + 1] += bucketStart[b];
+        }
+        std::vector<uint32_t> order(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[bucketStart[std::min(lines[i].size(), kBuckets - 1)]++] = static_cast<uint32_t>(i);
+        }
+
+        static const uint8_t idle = 0;
+        const uint8_t* data[Lanes];
+        size_t masks[Lanes];
+        size_t left[Lanes];
+        size_t line[Lanes];
+        uint32_t states[Lanes];
+        size_t next = 0;
+        size_t busy = 0;
+
+        auto refill = [&](size_t l) {
+            while (next < count && lines[order[next]].empty()) {
+                verdicts[order[next++]] = accepting[start / classCount];
+            }
+            if (next < count) {
+                line[l] = order[next++];
+                data[l] = reinterpret_cast<const uint8_t*>(lines[line[l]].data());
+                masks[l] = SIZE_MAX;
+                left[l] = lines[line[l]].size();
+                ++busy;
+            } else {
+                data[l] = &idle;
+                masks[l] = 0;
+                left[l] = SIZE_MAX;
+            }
+            states[l] = start;
+        };
+
+        for (size_t l = 0; l < Lanes; ++l) {
+            refill(l);
+        }
+        while (busy > 0) {
+            size_t steps = SIZE_MAX;
+            for (size_t l = 0; l < Lanes; ++l) {
+                steps = std::min(steps, left[l]);
+            }
+            step(*this, states, data, masks, steps);
+            for (size_t l = 0; l < Lanes; ++l) {
+                if (masks[l] == 0) {
+                    continue;
+                }
+                data[l] += steps;
+                left[l] -= steps;
+                if (left[l] == 0) {
+                    verdicts[line[l]] = accepting[states[l] / classCount];
+                    --busy;
+                    refill(l);
+                }
+            }
+        }
+    }
+
+    /*
+      Maps every state to the state reached from it after reading the chunk. All states run as lanes
+      over the same bytes, so each byte is classified once and the lanes' loads are independent. Lanes
+      that reach the same state are merged every 4 KB; most automata synchronise quickly and the rest
+      of the chunk then runs as a single stream.
+     */
+    void mapChunk(const uint8_t* bytes, size_t size, uint32_t* mapping) const {
+        const size_t states = stateCount();
+        std::vector<uint32_t> lanes(states);
+        std::vector<uint32_t> laneOf(states);
+        std::vector<int32_t> merged(states);
+        for (size_t state = 0; state < states; ++state) {
+            lanes[state] = static_cast<uint32_t>(state * classCount);
+            laneOf[state] = static_cast<uint32_t>(state);
+        }
+        std::vector<uint32_t> renumbered(states);
+        const uint32_t* next = table.data();
+        size_t active = states;
+        for (size_t at = 0; at < size;) {
+            const size_t end = std::min(size, at + 4096);
+            if (active == 1) {
+                uint32_t state = lanes[0];
+                for (; at < end; ++at) {
+                    state = next[state + classOf[bytes[at]]];
+                }
+                lanes[0] = state;
+                continue;
+            }
+            for (; at < end; ++at) {
+                const uint32_t column = classOf[bytes[at]];
+                for (size_t l = 0; l < active; ++l) {
+                    lanes[l] = next[lanes[l] + column];
+                }
+            }
+            // Merge lanes in the same state
+            std::fill(merged.begin(), merged.end(), -1);
+            size_t kept = 0;
+            for (size_t l = 0; l < active; ++l) {
+                int32_t& target = merged[lanes[l] / classCount];
+                if (target < 0) {
+                    target = static_cast<int32_t>(kept);
+                    lanes[kept++] = lanes[l];
+                }
+                renumbered[l] = static_cast<uint32_t>(target);
+            }
+            for (uint32_t& lane : laneOf) {
+                lane = renumbered[lane];
+            }
+            active = kept;
+        }
+        for (size_t state = 0; state < states; ++state) {
+            mapping[state] = lanes[laneOf[state]];
+        }
+    }
+
+    // Splits the next lines of `contents` from `at` on, at most `max` of them, dropping "\r\n" endings
+    static void splitLines(std::string_view contents, size_t& at, size_t max, std::vector<std::string_view>& lines) {
+        lines.clear();
+        while (lines.size() < max && at < contents.size()) {
+            const void* found = std::memchr(contents.data() + at, '\n', contents.size() - at);
+            size_t end = found ? static_cast<size_t>(static_cast<const char*>(found) - contents.data()) : contents.size();
+            std::string_view line = contents.substr(at, end - at);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            lines.push_back(line);
+            at = end + 1;
+        }
+    }
+
+public:
+    // Function for loading automaton, checks for commentaries or empty lines. The file is mapped
+    // and scanned in place; the automaton is compiled as soon as the definition is valid.
+    bool loadAutomaton(const std::string& filename) {
+        auto started = std::chrono::steady_clock::now();
+        MappedFile file;
+
+        if (!file.open(filename)) {
+            std::cerr << "Failed to open file: " << filename << std::endl;
+            return false;
+        }
+
+        DefinitionScanner scanner(file.contents());
+        std::string_view line;
+        std::string_view keyword;
+        bool inSection = false;
+        std::vector<std::pair<std::string_view, std::vector<std::string_view>>> rawDelta;
+        std::vector<std::string_view> rawFirst;
+        std::vector<std::string_view> rawAccepted;
+
+        // States are interned first, so the other sections may come before [states]
+        while (scanner.next(line)) {
+            if (line == "[eof]") {
+                break;
+            }
+            if (line == "[start]") {
+                inSection = true;
+                keyword = std::string_view();
+            } else if (line == "[end]") {
+                inSection = false;
+            } else if (inSection && keyword.empty() && line.substr(0, 7) == "keyword") {
+                size_t colon = line.find(':');
+                keyword = colon == std::string_view::npos ? std::string_view("?") : trimView(line.substr(colon + 1));
+            } else if (!inSection) {
+                continue;
+            } else if (keyword == "alphabet") {
+                if (line.size() != 1) {
+                    errors.push_back("alphabet symbol '" + std::string(line) + "' is not a single character");
+                } else if (std::find(alphabet.begin(), alphabet.end(), static_cast<uint8_t>(line[0])) == alphabet.end()) {
+                    alphabet.push_back(static_cast<uint8_t>(line[0]));
+                }
+            } else if (keyword == "states") {
+                size_t id = static_cast<size_t>(names.intern(line));
+                if (isState.size() <= id) {
+                    isState.resize(id + 1, 0);
+                }
+                if (!isState[id]) {
+                    isState[id] = 1;
+                    stateLines.push_back(static_cast<int32_t>(id));
+                }
+            } else if (keyword == "firstState") {
+                rawFirst.push_back(line);
+            } else if (keyword == "acceptedStates") {
+                rawAccepted.push_back(line);
+            } else if (keyword == "delta") {
+                addDeltaLine(line, rawDelta);
+            }
+        }
+
+        if (stateLines.empty()) {
+            errors.push_back("no states defined");
+        }
+        if (rawFirst.size() != 1) {
+            errors.push_back("firstState must name exactly one state");
+        } else if ((firstState = stateOf(rawFirst[0])) < 0) {
+            errors.push_back("firstState " + std::string(rawFirst[0]) + " is not a state");
+        }
+        for (std::string_view name : rawAccepted) {
+            int32_t state = stateOf(name);
+            if (state < 0) {
+                errors.push_back("accepted state " + std::string(name) + " is not a state");
+            } else {
+                acceptedLines.push_back(state);
+            }
+        }
+        for (const auto& raw : rawDelta) {
+            const std::vector<std::string_view>& parts = raw.second;
+            DeltaLine delta{stateOf(parts[0]), kEpsilon, {}};
+            bool valid = delta.from >= 0;
+            if (parts[1] != "ε") {
+                valid = valid && parts[1].size() == 1 &&
+                        std::find(alphabet.begin(), alphabet.end(), static_cast<uint8_t>(parts[1][0])) != alphabet.end();
+                delta.symbol = parts[1].empty() ? kEpsilon : static_cast<uint8_t>(parts[1][0]);
+            }
+            for (size_t i = 2; i < parts.size(); ++i) {
+                delta.to.push_back(stateOf(parts[i]));
+                valid = valid && delta.to.back() >= 0;
+            }
+            if (!valid) {
+                errors.push_back("invalid transition " + std::string(raw.first));
+            } else {
+                deltaLines.push_back(std::move(delta));
+            }
+        }
+
+        if (outputLevel == OutputLevel::Summary) {
+            auto finished = std::chrono::steady_clock::now();
+            reportLoad(filename, file.size(), std::chrono::duration<double>(finished - started).count());
+        }
+        if (isValidAutomaton()) {
+            compile();
+        }
+        return true;
+    }
+
+    // Function for checking valid automaton; reportErrors() says what is wrong with it otherwise
+    bool isValidAutomaton() const {
+        return errors.empty();
+    }
+
+    void reportErrors() const {
+        for (const std::string& error : errors) {
+            std::cout << "Invalid automaton: " << error << std::endl;
+        }
+    }
+
+    // Builds the NFA bitsets, then, unless the DFA is determinised lazily, the minimal dense DFA:
+    // closures, subset construction, Hopcroft
+    void compile() {
+        auto started = std::chrono::steady_clock::now();
+
+        // NFA states are numbered in the order of the [states] section
+        std::vector<int32_t> nfaOf(names.size(), -1);
+        nfaStates = stateLines.size();
+        for (size_t i = 0; i < stateLines.size(); ++i) {
+            nfaOf[stateLines[i]] = static_cast<int32_t>(i);
+        }
+        classCount = static_cast<uint32_t>(alphabet.size() + 1);
+        classOf.fill(0);
+        for (size_t i = 0; i < alphabet.size(); ++i) {
+            classOf[alphabet[i]] = static_cast<uint32_t>(i + 1);
+        }
+
+        const size_t words = subsetWords = (nfaStates + 63) / 64;
+        std::vector<std::vector<uint32_t>> epsilon(nfaStates);
+        std::vector<std::vector<uint32_t>> targets(nfaStates * classCount);
+        nfaTransitions = 0;
+        for (const DeltaLine& delta : deltaLines) {
+            const uint32_t from = static_cast<uint32_t>(nfaOf[delta.from]);
+            std::vector<uint32_t>& into = delta.symbol == kEpsilon ? epsilon[from] : targets[from * classCount + classOf[delta.symbol]];
+            for (int32_t to : delta.to) {
+                into.push_back(static_cast<uint32_t>(nfaOf[to]));
+                ++nfaTransitions;
+            }
+        }
+        std::vector<uint64_t> closures = epsilonClosures(epsilon, words);
+
+        // moves[state][class]: every NFA state reached by reading the class from `state`, closed under ε
+        moves.assign(nfaStates * classCount * words, 0);
+        for (size_t state = 0; state < nfaStates; ++state) {
+            for (size_t c = 1; c < classCount; ++c) {
+                uint64_t* move = moves.data() + (state * classCount + c) * words;
+                for (uint32_t to : targets[state * classCount + c]) {
+                    const uint64_t* closure = closures.data() + static_cast<size_t>(to) * words;
+                    for (size_t w = 0; w < words; ++w) {
+                        move[w] |= closure[w];
+                    }
+                }
+            }
+        }
+        acceptedSet.assign(words, 0);
+        for (int32_t state : acceptedLines) {
+            acceptedSet[nfaOf[state] / 64] |= uint64_t(1) << (nfaOf[state] % 64);
+        }
+        const uint64_t* startClosure = closures.data() + static_cast<size_t>(nfaOf[firstState]) * words;
+        startSet.assign(startClosure, startClosure + words);
+        if (lazyCache > 0) {
+            if (outputLevel == OutputLevel::Summary) {
+                auto finished = std::chrono::steady_clock::now();
+                std::cerr << "NFA: " << nfaStates << " states, " << nfaTransitions << " transitions; lazy DFA cache: "
+                          << static_cast<double>(lazyCache) / (1024.0 * 1024.0) << " MB ("
+                          << std::chrono::duration<double>(finished - started).count() << " s)" << std::endl;
+            }
+            return;
+        }
+
+        // Subset construction; subset 0 is the empty set, the dead state
+        SubsetCache cache(words);
+        std::vector<uint64_t> subset(words, 0);
+        bool added;
+        cache.intern(subset.data(), added);
+        const uint32_t startSubset = cache.intern(startSet.data(), added);
+        std::vector<uint32_t> next;
+        std::vector<uint8_t> subsetAccepting;
+        std::vector<uint32_t> members;
+        for (uint32_t id = 0; id < cache.count(); ++id) {
+            members.clear();
+            uint8_t isAccepting = 0;
+            for (size_t w = 0; w < words; ++w) {
+                const uint64_t bits = cache[id][w];
+                isAccepting |= (bits & acceptedSet[w]) != 0;
+                for (uint64_t rest = bits; rest != 0; rest &= rest - 1) {
+                    members.push_back(static_cast<uint32_t>(w * 64 + __builtin_ctzll(rest)));
+                }
+            }
+            subsetAccepting.push_back(isAccepting);
+            next.push_back(0);
+            for (size_t c = 1; c < classCount; ++c) {
+                std::fill(subset.begin(), subset.end(), 0);
+                for (uint32_t member : members) {
+                    const uint64_t* move = moves.data() + (member * classCount + c) * words;
+                    for (size_t w = 0; w < words; ++w) {
+                        subset[w] |= move[w];
+                    }
+                }
+                next.push_back(cache.intern(subset.data(), added));
+            }
+        }
+        subsetStates = cache.count();
+        std::vector<uint64_t>().swap(moves);
+
+        // Minimisation, then the dense table over the blocks
+        std::vector<uint32_t> blockOf = minimise(next, subsetAccepting, subsetStates, classCount);
+        const size_t blocks = *std::max_element(blockOf.begin(), blockOf.end()) + 1;
+        table.assign(blocks * classCount, 0);
+        accepting.assign(blocks, 0);
+        for (size_t id = 0; id < subsetStates; ++id) {
+            const size_t block = blockOf[id];
+            accepting[block] = subsetAccepting[id];
+            for (size_t c = 0; c < classCount; ++c) {
+                table[block * classCount + c] = blockOf[next[id * classCount + c]] * classCount;
+            }
+        }
+        start = blockOf[startSubset] * classCount;
+        dead = blockOf[0] * classCount;
+
+        if (outputLevel == OutputLevel::Summary) {
+            auto finished = std::chrono::steady_clock::now();
+            std::cerr << "NFA: " << nfaStates << " states, " << nfaTransitions << " transitions; subset construction: "
+                      << subsetStates << " states; minimal DFA: " << stateCount() << " states ("
+                      << std::chrono::duration<double>(finished - started).count() << " s)" << std::endl;
+        }
+    }
+
+    // States of the minimal DFA, the dead state included
+    size_t stateCount() const {
+        return accepting.size();
+    }
+
+    // Runs the minimal DFA over the bytes. The loop is unrolled and only checks for the dead state
+    // once per 64 bytes, which is enough to stop early on inputs rejected by a short prefix.
+    bool accepts(const char* data, size_t size) const {
+        const uint32_t* next = table.data();
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        uint32_t state = start;
+        size_t at = 0;
+        while (at + 64 <= size) {
+            for (size_t end = at + 64; at < end; at += 4) {
+                state = next[state + classOf[bytes[at]]];
+                state = next[state + classOf[bytes[at + 1]]];
+                state = next[state + classOf[bytes[at + 2]]];
+                state = next[state + classOf[bytes[at + 3]]];
+            }
+            if (state == dead) {
+                return false;
+            }
+        }
+        for (; at < size; ++at) {
+            state = next[state + classOf[bytes[at]]];
+        }
+        return accepting[state / classCount] != 0;
+    }
+
+    // Inputs at least this long are split into chunks and run by acceptsParallel() in batch runs
+    static constexpr size_t kLongInput = size_t(1) << 22;
+
+    // Lines classified together by one call of classifyLines() in batch runs
+    static constexpr size_t kChunkLines = 4096;
+
+    // Mean input length from which Kernel::Auto runs the inputs as parallel streams
+    static constexpr size_t kStreamLength = 48;
+
+    static const char* kernelName(Kernel chosen) {
+        switch (chosen) {
+            case Kernel::Scalar: return "scalar";
+            case Kernel::Interleaved: return "interleaved";
+            case Kernel::Avx2: return "avx2";
+            case Kernel::Avx512: return "avx512";
+            default: return "auto";
+        }
+    }
+
+    static bool isSupported(Kernel chosen) {
+#ifdef DFA_NFA_X86
+        if (chosen == Kernel::Avx2) {
+            return __builtin_cpu_supports("avx2");
+        }
+        if (chosen == Kernel::Avx512) {
+            return __builtin_cpu_supports("avx512f");
+        }
+#else
+        if (chosen == Kernel::Avx2 || chosen == Kernel::Avx512) {
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    // The widest multi-stream kernel the processor supports
+    static Kernel bestKernel() {
+        return isSupported(Kernel::Avx512) ? Kernel::Avx512 : isSupported(Kernel::Avx2) ? Kernel::Avx2 : Kernel::Interleaved;
+    }
+
+    void setKernel(Kernel chosen) {
+        kernel = chosen;
+    }
+
+    /*
+      Classifies `count` inputs into verdicts (1 accepted, 0 rejected) with the chosen kernel, which
+      must be supported. Kernel::Auto runs bestKernel() on inputs of kStreamLength bytes or more on
+      average and the scalar kernel on shorter ones: out-of-order execution already overlaps the
+      runs of consecutive short inputs, and refilling the lanes would cost more than it hides.
+     */
+    void classifyLines(const std::string_view* lines, size_t count, char* verdicts, Kernel chosen) const {
+        if (chosen == Kernel::Auto) {
+            size_t bytes = 0;
+            for (size_t i = 0; i < count; ++i) {
+                bytes += lines[i].size();
+            }
+            chosen = count >= 16 && bytes >= count * kStreamLength ? bestKernel() : Kernel::Scalar;
+        }
+        switch (chosen) {
+#ifdef DFA_NFA_X86
+            case Kernel::Avx2:
+                classifyStreams<16>(lines, count, verdicts, stepAvx2);
+                return;
+            case Kernel::Avx512:
+                classifyStreams<16>(lines, count, verdicts, stepAvx512);
+                return;
+#endif
+            case Kernel::Interleaved:
+                classifyStreams<16>(lines, count, verdicts, stepScalar<16>);
+                return;
+            default:
+                for (size_t i = 0; i < count; ++i) {
+                    verdicts[i] = accepts(lines[i].data(), lines[i].size());
+                }
+        }
+    }
+
+    /*
+      Speculative parallel-prefix run of one long input: the input is cut into chunks, every chunk
+      but the first is mapped from all states at once (see mapChunk()) on the pool while the first
+      runs from the start state, and the mappings are then composed left to right. Each mapping costs
+      as much as the states not yet synchronised, usually little more than one stream.
+     */
+    bool acceptsParallel(const char* data, size_t size, WorkStealingPool& pool) const {
+        const size_t chunks = pool.size() < 2 ? 1 : std::min<size_t>(pool.size() * 4, size / (size_t(1) << 16));
+        if (chunks <= 1) {
+            return accepts(data, size);
+        }
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        const size_t states = stateCount();
+        std::vector<uint32_t> mappings(chunks * states);
+        uint32_t first = start;
+        pool.parallelFor(chunks, [&](unsigned, size_t k) {
+            const size_t begin = size / chunks * k;
+            const size_t end = k + 1 == chunks ? size : size / chunks * (k + 1);
+            if (k == 0) {
+                for (size_t at = begin; at < end; ++at) {
+                    first = table[first + classOf[bytes[at]]];
+                }
+            } else {
+                mapChunk(bytes + begin, end - begin, mappings.data() + k * states);
+            }
+        }, 1);
+        uint32_t state = first;
+        for (size_t k = 1; k < chunks; ++k) {
+            state = mappings[k * states + state / classCount];
+        }
+        return accepting[state / classCount] != 0;
+    }
+
+    // Determinise lazily in at most `bytes` of DFA states instead of building the full minimal DFA;
+    // takes effect when the automaton is loaded
+    void setLazyCache(size_t bytes) {
+        lazyCache = bytes;
+    }
+
+    bool isLazy() const {
+        return lazyCache > 0;
+    }
+
+    // Worker threads for a long single input, 0 for one per hardware thread
+    void setThreads(unsigned count) {
+        threads = count;
+    }
+
+    void setOutputLevel(OutputLevel level) {
+        outputLevel = level;
+    }
+
+    // Writes the minimal DFA in the input format. The dead state and the transitions into it are
+    // left out, since a missing transition rejects just the same; the start state is q0.
+    bool writeMinimal(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cerr << "Failed to write file: " << path << std::endl;
+            return false;
+        }
+
+        // Breadth-first numbering from the start state gives stable, readable names
+        std::vector<int32_t> number(stateCount(), -1);
+        std::vector<uint32_t> order(1, start / classCount);
+        number[start / classCount] = 0;
+        for (size_t k = 0; k < order.size(); ++k) {
+            for (size_t c = 1; c < classCount; ++c) {
+                uint32_t to = table[order[k] * classCount + c] / classCount;
+                if (to * classCount != dead && number[to] < 0) {
+                    number[to] = static_cast<int32_t>(order.size());
+                    order.push_back(to);
+                }
+            }
+        }
+        if (start == dead) {
+            order.clear();
+        }
+
+        out << "# minimal DFA, " << order.size() << " states\n";
+        out << "[start]\nkeyword:alphabet\n";
+        for (uint8_t symbol : alphabet) {
+            out << static_cast<char>(symbol) << '\n';
+        }
+        out << "[end]\n[start]\nkeyword:states\nq0\n";
+        for (size_t k = 1; k < order.size(); ++k) {
+            out << 'q' << k << '\n';
+        }
+        out << "[end]\n[start]\nkeyword:firstState\nq0\n[end]\n[start]\nkeyword:acceptedStates\n";
+        for (size_t k = 0; k < order.size(); ++k) {
+            if (accepting[order[k]]) {
+                out << 'q' << k << '\n';
+            }
+        }
+        out << "[end]\n[start]\nkeyword:delta\n";
+        for (size_t k = 0; k < order.size(); ++k) {
+            for (size_t c = 1; c < classCount; ++c) {
+                uint32_t to = table[order[k] * classCount + c];
+                if (to != dead) {
+                    out << "(q" << k << ',' << static_cast<char>(alphabet[c - 1]) << ")=q" << number[to / classCount] << '\n';
+                }
+            }
+        }
+        out << "[end]\n[eof]\n";
+        return static_cast<bool>(out);
+    }
+
+    // Automaton execution function
+    void startAutomaton() {
+        std::string input;
+        std::cout << "Enter input string: ";
+        std::getline(std::cin, input);
+        if (!input.empty() && input.back() == '\r') {
+            input.pop_back();
+        }
+
+        std::unique_ptr<WorkStealingPool> pool;
+        std::unique_ptr<LazyDfa> lazy;
+        if (isLazy()) {
+            lazy = std::make_unique<LazyDfa>(*this, lazyCache);
+        } else if (input.size() >= kLongInput) {
+            pool = std::make_unique<WorkStealingPool>(threads);
+        }
+        auto started = std::chrono::steady_clock::now();
+        bool accepted = lazy ? lazy->accepts(input.data(), input.size())
+                        : pool ? acceptsParallel(input.data(), input.size(), *pool) : accepts(input.data(), input.size());
+        auto finished = std::chrono::steady_clock::now();
+        std::cout << (accepted ? "Input accepted!" : "Input rejected!") << std::endl;
+        if (outputLevel == OutputLevel::Summary) {
+            std::cout << "Time: " << std::chrono::duration<double>(finished - started).count() << " s" << std::endl;
+            if (lazy) {
+                reportLazy(lazy->statistics());
+            }
+        }
+    }
+
+    // Classifies every line of the inputs file and prints, in input order: <line number> <accept|reject>.
+    // The file is mapped and its lines are classified straight out of the mapping, chunks of lines in
+    // parallel with the chosen kernel; lines of kLongInput bytes or more are run afterwards, one at
+    // a time, by acceptsParallel(). A lazy DFA runs every line on its worker's own cache instead,
+    // the budget shared out between the workers. The output of a block of lines is formatted into one buffer.
+    bool runBatch(const std::string& inputsPath, unsigned threads) const {
+        MappedFile inputs;
+        if (!inputs.open(inputsPath)) {
+            std::cerr << "Failed to open file: " << inputsPath << std::endl;
+            return false;
+        }
+
+        WorkStealingPool pool(threads);
+        std::vector<LazyDfa> lazy;
+        if (isLazy()) {
+            lazy.reserve(pool.size());
+            for (unsigned worker = 0; worker < pool.size(); ++worker) {
+                lazy.emplace_back(*this, lazyCache / pool.size());
+            }
+        }
+        const std::string_view contents = inputs.contents();
+        const size_t blockLines = 1 << 18;
+        std::vector<std::string_view> lines;
+        std::vector<char> verdicts(blockLines);
+        std::string output;
+        size_t lineNumber = 0;
+        size_t accepted = 0;
+
+        auto started = std::chrono::steady_clock::now();
+        size_t at = 0;
+        while (at < contents.size()) {
+            splitLines(contents, at, blockLines, lines);
+
+            pool.parallelFor((lines.size() + kChunkLines - 1) / kChunkLines, [&](unsigned worker, size_t chunk) {
+                const size_t end = std::min(lines.size(), (chunk + 1) * kChunkLines);
+                if (!lazy.empty()) {
+                    for (size_t i = chunk * kChunkLines; i < end; ++i) {
+                        verdicts[i] = lazy[worker].accepts(lines[i].data(), lines[i].size());
+                    }
+                    return;
+                }
+                for (size_t i = chunk * kChunkLines; i < end;) {
+                    size_t shortEnd = i;
+                    while (shortEnd < end && lines[shortEnd].size() < kLongInput) {
+                        ++shortEnd;
+                    }
+                    classifyLines(lines.data() + i, shortEnd - i, verdicts.data() + i, kernel);
+                    i = shortEnd;
+                    while (i < end && lines[i].size() >= kLongInput) {
+                        ++i;
+                    }
+                }
+            }, 1);
+            for (size_t i = 0; i < lines.size() && lazy.empty(); ++i) {
+                if (lines[i].size() >= kLongInput) {
+                    verdicts[i] = acceptsParallel(lines[i].data(), lines[i].size(), pool);
+                }
+            }
+
+            output.clear();
+            for (size_t i = 0; i < lines.size(); ++i) {
+                output += std::to_string(++lineNumber);
+                output += verdicts[i] ? "\taccept\n" : "\treject\n";
+                accepted += verdicts[i];
+            }
+            std::cout << output;
+        }
+        std::cout.flush();
+        auto finished = std::chrono::steady_clock::now();
+
+        if (outputLevel != OutputLevel::Verdict) {
+            double seconds = std::chrono::duration<double>(finished - started).count();
+            std::cerr << "Inputs: " << lineNumber << " (" << accepted << " accepted) on " << pool.size() << " threads" << std::endl;
+            std::cerr << "Time: " << seconds << " s" << std::endl;
+            if (seconds > 0) {
+                std::cerr << "Throughput: " << lineNumber / seconds << " inputs/s, "
+                          << static_cast<double>(contents.size()) / (1024.0 * 1024.0) / seconds << " MB/s" << std::endl;
+            }
+            LazyDfa::Stats total;
+            for (const LazyDfa& dfa : lazy) {
+                total.statesBuilt += dfa.statistics().statesBuilt;
+                total.flushes += dfa.statistics().flushes;
+                total.simulatedInputs += dfa.statistics().simulatedInputs;
+            }
+            if (!lazy.empty()) {
+                reportLazy(total);
+            }
+        }
+        return true;
+    }
+
+    static void reportLazy(const LazyDfa::Stats& stats) {
+        std::cerr << "Lazy DFA: " << stats.statesBuilt << " states built, " << stats.flushes << " cache flushes, "
+                  << stats.simulatedInputs << " inputs finished on the NFA" << std::endl;
+    }
+
+    // Times every supported kernel on the lines of the corpus, one thread, best of three runs, then the
+    // whole corpus as a single input, with one stream and with the parallel-prefix run on the pool.
+    // Prints inputs/s and GB/s; fails if two ways of running disagree on a verdict.
+    bool runBench(const std::string& corpusPath, unsigned threads) const {
+        MappedFile corpus;
+        if (!corpus.open(corpusPath)) {
+            std::cerr << "Failed to open file: " << corpusPath << std::endl;
+            return false;
+        }
+        const std::string_view contents = corpus.contents();
+        std::vector<std::string_view> lines;
+        size_t at = 0;
+        splitLines(contents, at, SIZE_MAX, lines);
+        size_t bytes = 0;
+        for (std::string_view line : lines) {
+            bytes += line.size();
+        }
+        std::cout << "Corpus: " << lines.size() << " inputs, " << static_cast<double>(bytes) / 1e9 << " GB" << std::endl;
+
+        auto best = [](const std::function<void()>& run) {
+            double fastest = 0;
+            for (int repeat = 0; repeat < 3; ++repeat) {
+                auto started = std::chrono::steady_clock::now();
+                run();
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+                fastest = repeat == 0 ? seconds : std::min(fastest, seconds);
+            }
+            return fastest;
+        };
+
+        std::vector<char> expected(lines.size());
+        std::vector<char> verdicts(lines.size());
+        if (isLazy()) {
+            LazyDfa::Stats stats;
+            double seconds = best([&] {
+                LazyDfa dfa(*this, lazyCache);
+                for (size_t i = 0; i < lines.size(); ++i) {
+                    verdicts[i] = dfa.accepts(lines[i].data(), lines[i].size());
+                }
+                stats = dfa.statistics();
+            });
+            std::cout << "lazy DFA: " << lines.size() / seconds << " inputs/s, "
+                      << static_cast<double>(bytes) / 1e9 / seconds << " GB/s" << std::endl;
+            reportLazy(stats);
+            seconds = best([&] {
+                LazyDfa dfa(*this, lazyCache);
+                for (size_t i = 0; i < lines.size(); ++i) {
+                    expected[i] = dfa.simulateFromStart(lines[i].data(), lines[i].size());
+                }
+            });
+            std::cout << "NFA simulation: " << lines.size() / seconds << " inputs/s, "
+                      << static_cast<double>(bytes) / 1e9 / seconds << " GB/s" << std::endl;
+            if (verdicts != expected) {
+                std::cerr << "The lazy DFA disagrees with the NFA simulation" << std::endl;
+                return false;
+            }
+            return true;
+        }
+        for (Kernel candidate : {Kernel::Scalar, Kernel::Interleaved, Kernel::Avx2, Kernel::Avx512, Kernel::Auto}) {
+            if (!isSupported(candidate)) {
+                continue;
+            }
+            std::vector<char>& into = candidate == Kernel::Scalar ? expected : verdicts;
+            double seconds = best([&] {
+                for (size_t i = 0; i < lines.size(); i += kChunkLines) {
+                    classifyLines(lines.data() + i, std::min(kChunkLines, lines.size() - i), into.data() + i, candidate);
+                }
+            });
+            std::cout << kernelName(candidate) << ": " << lines.size() / seconds << " inputs/s, "
+                      << static_cast<double>(bytes) / 1e9 / seconds << " GB/s" << std::endl;
+            if (into != expected) {
+                std::cerr << "Kernel " << kernelName(candidate) << " disagrees with the scalar kernel" << std::endl;
+                return false;
+            }
+        }
+
+        WorkStealingPool pool(threads);
+        bool single = false;
+        bool parallel = false;
+        double seconds = best([&] { single = accepts(contents.data(), contents.size()); });
+        std::cout << "one input: " << static_cast<double>(contents.size()) / 1e9 / seconds << " GB/s" << std::endl;
+        seconds = best([&] { parallel = acceptsParallel(contents.data(), contents.size(), pool); });
+        std::cout << "one input, parallel prefix on " << pool.size() << " threads: "
+                  << static_cast<double>(contents.size()) / 1e9 / seconds << " GB/s" << std::endl;
+        if (single != parallel) {
+            std::cerr << "The parallel-prefix run disagrees with the single stream" << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
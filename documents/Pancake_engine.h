@@ -0,0 +1,255 @@
+#ifndef PANCAKE_ENGINE_H
+#define PANCAKE_ENGINE_H
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PANCAKE_X86 1
+#endif
+
+/**
+  Tuned pancake sort for long arrays (up to ~10^6 elements), with the same flip policy as
+  pancakeSort() in Pancake_sorting.h.
+
+  Every round finds the two largest elements of the unsorted prefix in one pass and places both:
+  the largest at the bottom of the prefix with at most two flips, then the runner-up, whose index
+  after those flips is computed instead of searched for, with at most two more. This halves the
+  scans of the reference version. Only the bottom of the prefix can be fixed by prefix reversals,
+  so the second element has to be the runner-up: the minimum could only be placed at the top,
+  which every later flip moves again.
+
+  The AVX2 kernel keeps the best two (value, index) pairs of each of 8 lanes with compares and
+  blends, and flips reverse blocks of 8 in registers while swapping them from both ends. On
+  arrays of distinct values the flips are exactly those of pancakeSort(); with duplicates the
+  runner-up may be another copy of the same value, which sorts just as well.
+
+  The flips are returned instead of printed: entry k is the length of the prefix reversed by
+  flip k, so a sequence can be replayed on a device or checked with applyFlips().
+ */
+class PancakeSorter {
+public:
+    // How the scans and flips run: scalar code, the AVX2 kernels, or the best one supported
+    enum class Kernel {
+        Scalar,
+        Avx2,
+        Auto
+    };
+
+    using FlipSequence = std::vector<uint32_t>;
+
+    explicit PancakeSorter(Kernel chosen = Kernel::Auto) : kernel(chosen == Kernel::Auto ? bestKernel() : chosen) {
+        if (!isSupported(kernel)) {
+            kernel = Kernel::Scalar;
+        }
+    }
+
+    Kernel activeKernel() const {
+        return kernel;
+    }
+
+    // Sorts `arr` in place and returns the flips that did it
+    FlipSequence sort(std::vector<int>& arr) const {
+        FlipSequence flips;
+        sort(arr, flips);
+        return flips;
+    }
+
+    // Same, reusing the memory of `flips`, which is cleared first
+    void sort(std::vector<int>& arr, FlipSequence& flips) const {
+        flips.clear();
+        int* data = arr.data();
+        uint32_t size = static_cast<uint32_t>(arr.size());
+        while (size > 1) {
+            uint32_t first;
+            uint32_t second;
+            topTwo(data, size, first, second);
+
+            // The largest goes to the bottom of the prefix; follow the runner-up through the flips
+            if (first != size - 1) {
+                if (first != 0) {
+                    flip(data, first + 1, flips);
+                    second = second <= first ? first - second : second;
+                }
+                flip(data, size, flips);
+                second = size - 1 - second;
+            }
+            --size;
+
+            if (second != size - 1) {
+                if (second != 0) {
+                    flip(data, second + 1, flips);
+                }
+                flip(data, size, flips);
+            }
+            --size;
+        }
+    }
+
+    // Reverses the prefixes listed in `flips`, in order
+    static void applyFlips(std::vector<int>& arr, const FlipSequence& flips) {
+        for (uint32_t length : flips) {
+            std::reverse(arr.begin(), arr.begin() + length);
+        }
+    }
+
+    static const char* kernelName(Kernel chosen) {
+        switch (chosen) {
+            case Kernel::Scalar: return "scalar";
+            case Kernel::Avx2: return "avx2";
+            default: return "auto";
+        }
+    }
+
+    static bool isSupported(Kernel chosen) {
+#ifdef PANCAKE_X86
+        if (chosen == Kernel::Avx2) {
+            return __builtin_cpu_supports("avx2");
+        }
+#else
+        if (chosen == Kernel::Avx2) {
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    static Kernel bestKernel() {
+        return isSupported(Kernel::Avx2) ? Kernel::Avx2 : Kernel::Scalar;
+    }
+
+private:
+    Kernel kernel;
+
+    void topTwo(const int* data, uint32_t size, uint32_t& first, uint32_t& second) const {
+#ifdef PANCAKE_X86
+        if (kernel == Kernel::Avx2 && topTwoAvx2(data, size, first, second)) {
+            return;
+        }
+#endif
+        topTwoScalar(data, size, first, second);
+    }
+
+    void flip(int* data, uint32_t length, FlipSequence& flips) const {
+        flips.push_back(length);
+#ifdef PANCAKE_X86
+        if (kernel == Kernel::Avx2) {
+            reverseAvx2(data, length);
+            return;
+        }
+#endif
+        std::reverse(data, data + length);
+    }
+
+    // Whether (value, index) a comes before b: larger values first, then the first occurrence
+    static bool better(int valueA, uint32_t indexA, int valueB, uint32_t indexB) {
+        return valueA > valueB || (valueA == valueB && indexA < indexB);
+    }
+
+    // Index of the first largest element and of the largest among the others; size >= 2
+    static void topTwoScalar(const int* data, uint32_t size, uint32_t& first, uint32_t& second) {
+        first = 0;
+        second = 1;
+        if (data[1] > data[0]) {
+            std::swap(first, second);
+        }
+        int value1 = data[first];
+        int value2 = data[second];
+        for (uint32_t i = 2; i < size; ++i) {
+            const int x = data[i];
+            if (x > value2) {
+                if (x > value1) {
+                    second = first;
+                    value2 = value1;
+                    first = i;
+                    value1 = x;
+                } else {
+                    second = i;
+                    value2 = x;
+                }
+            }
+        }
+    }
+
+#ifdef PANCAKE_X86
+    // Lanes start from (INT_MIN, no index) and only take strictly larger values, so a prefix that
+    // holds INT_MIN may leave fewer than two candidates; false then, and the scalar scan decides
+    __attribute__((target("avx2")))
+    static bool topTwoAvx2(const int* data, uint32_t size, uint32_t& first, uint32_t& second) {
+        if (size < 16) {
+            return false;
+        }
+        __m256i value1 = _mm256_set1_epi32(INT_MIN);
+        __m256i value2 = value1;
+        __m256i index1 = _mm256_set1_epi32(-1);
+        __m256i index2 = index1;
+        __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i stride = _mm256_set1_epi32(8);
+        uint32_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            const __m256i above1 = _mm256_cmpgt_epi32(x, value1);
+            const __m256i above2 = _mm256_cmpgt_epi32(x, value2);
+            value2 = _mm256_blendv_epi8(_mm256_blendv_epi8(value2, x, above2), value1, above1);
+            index2 = _mm256_blendv_epi8(_mm256_blendv_epi8(index2, index, above2), index1, above1);
+            value1 = _mm256_blendv_epi8(value1, x, above1);
+            index1 = _mm256_blendv_epi8(index1, index, above1);
+            index = _mm256_add_epi32(index, stride);
+        }
+
+        alignas(32) int values[16];
+        alignas(32) int indices[16];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(values), value1);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(values + 8), value2);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(indices), index1);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(indices + 8), index2);
+
+        // The best two of the lane candidates and of the tail
+        bool found1 = false;
+        bool found2 = false;
+        auto offer = [&](int value, uint32_t at) {
+            if (!found1 || better(value, at, data[first], first)) {
+                second = first;
+                found2 = found1;
+                first = at;
+                found1 = true;
+            } else if (!found2 || better(value, at, data[second], second)) {
+                second = at;
+                found2 = true;
+            }
+        };
+        for (size_t c = 0; c < 16; ++c) {
+            if (indices[c] >= 0) {
+                offer(values[c], static_cast<uint32_t>(indices[c]));
+            }
+        }
+        for (; i < size; ++i) {
+            offer(data[i], i);
+        }
+        return found2;
+    }
+
+    // Swaps blocks of 8 from both ends, each reversed by one permutation, then reverses the middle
+    __attribute__((target("avx2")))
+    static void reverseAvx2(int* data, uint32_t length) {
+        const __m256i reversed = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        int* low = data;
+        int* high = data + length;
+        while (high - low >= 16) {
+            high -= 8;
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(low));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(high));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(low), _mm256_permutevar8x32_epi32(b, reversed));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(high), _mm256_permutevar8x32_epi32(a, reversed));
+            low += 8;
+        }
+        std::reverse(low, high);
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,436 @@
+#ifndef PANCAKE_ENUMERATOR_H
+#define PANCAKE_ENUMERATOR_H
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include "work_stealing_pool.h"
+#include "definition_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define PANCAKE_MMAP 1
+#endif
+
+// Ranking of the permutations of 0..n-1 onto 0..n!-1 in O(n) (Myrvold and Ruskey). The order is
+// not lexicographic, but rank and unrank are inverse bijections, which is all a table needs.
+struct PermutationRank {
+    static uint64_t factorial(uint32_t n) {
+        uint64_t result = 1;
+        for (uint32_t k = 2; k <= n; ++k) {
+            result *= k;
+        }
+        return result;
+    }
+
+    // Consumes `perm` and `inverse` (inverse[perm[i]] == i)
+    static uint64_t rank(uint8_t* perm, uint8_t* inverse, uint32_t n) {
+        uint64_t result = 0;
+        uint64_t multiplier = 1;
+        for (uint32_t k = n; k > 1; --k) {
+            const uint8_t digit = perm[k - 1];
+            std::swap(perm[k - 1], perm[inverse[k - 1]]);
+            std::swap(inverse[digit], inverse[k - 1]);
+            result += digit * multiplier;
+            multiplier *= k;
+        }
+        return result;
+    }
+
+    static void unrank(uint64_t rank, uint8_t* perm, uint32_t n) {
+        for (uint32_t i = 0; i < n; ++i) {
+            perm[i] = static_cast<uint8_t>(i);
+        }
+        for (uint32_t k = n; k > 1; --k) {
+            std::swap(perm[k - 1], perm[rank % k]);
+            rank /= k;
+        }
+    }
+};
+
+// Layout of a distance table file: this header, then one nibble per permutation rank (the low
+// nibble of byte r / 2 for even r), holding min(distance, 15)
+struct PancakeTableHeader {
+    char magic[8];                // "LFAPANC1"
+    uint32_t size;                // n
+    uint32_t diameter;            // largest distance, the pancake number of n
+    uint64_t states;              // n!
+    uint64_t distribution[32];    // permutations at each distance
+    uint8_t reserved[40];
+};
+
+static_assert(sizeof(PancakeTableHeader) == 320, "the table layout is part of the file format");
+
+/**
+  Breadth-first search from the sorted permutation over all n! permutations of n pancakes,
+  giving the flip distance of every one of them (up to n = 14, ~8.7 * 10^10 states).
+
+  Permutations are identified by their rank, and the whole search lives in one array of 2 bits
+  per rank: 0 for not reached yet, 3 for expanded, and 1 or 2 for the frontier and the next
+  level, which swap codes at every level. That array is the visited set and both frontiers at
+  once, so nothing else grows with n!. Each level scans the array in word-aligned chunks on a
+  work stealing pool, picking the frontier fields of a 64-bit word with a few bit operations;
+  a worker marks a child, or its own expanded state, with one atomic OR of the word, so no locks
+  are taken.
+
+  When the array would not fit in the memory limit it is backed by a scratch file instead of
+  anonymous memory, and the kernel pages it to disk as needed. A distance table is written the
+  same way, straight into a mapped file that PancakeDistanceTable maps back for O(1) queries.
+ */
+class PancakeEnumerator {
+public:
+    static constexpr uint32_t kMaxSize = 14;
+
+    struct Options {
+        unsigned threads = 0;             // 0 uses one worker per hardware thread
+        uint64_t memoryLimit = 0;         // bytes of RAM for the search; 0 is half of the physical memory
+        std::string scratchDir = "/tmp";  // where the search array goes when it is over the limit
+        std::string tablePath;            // distance table to write, none when empty
+    };
+
+    struct Result {
+        std::vector<uint64_t> distribution;  // permutations at each distance; the last index is the pancake number
+        uint64_t states = 0;
+        bool spilled = false;                // whether the search array was file-backed
+        bool ok = false;
+    };
+
+    PancakeEnumerator() : PancakeEnumerator(Options()) {}
+
+    explicit PancakeEnumerator(Options chosen) : options(std::move(chosen)), pool(options.threads) {}
+
+    Result enumerate(uint32_t n) {
+        Result result;
+        if (n < 1 || n > kMaxSize) {
+            std::cerr << "Pancake enumeration supports 1 to " << kMaxSize << " elements" << std::endl;
+            return result;
+        }
+        const uint64_t states = PermutationRank::factorial(n);
+        const uint64_t words = (states + 31) / 32;
+        result.states = states;
+        result.spilled = words * 8 > memoryLimit();
+
+        MappedBuffer search;
+        if (!search.create(words * 8, result.spilled ? options.scratchDir + "/pancake_bfs.XXXXXX" : "", true)) {
+            return result;
+        }
+        MappedBuffer table;
+        if (!options.tablePath.empty() &&
+            !table.create(sizeof(PancakeTableHeader) + (states + 1) / 2, options.tablePath, false)) {
+            return result;
+        }
+        uint64_t* fields = static_cast<uint64_t*>(search.data());
+        uint8_t* distances = table.data() ? static_cast<uint8_t*>(table.data()) + sizeof(PancakeTableHeader) : nullptr;
+
+        uint8_t identity[kMaxSize];
+        uint8_t inverse[kMaxSize];
+        for (uint32_t i = 0; i < n; ++i) {
+            identity[i] = inverse[i] = static_cast<uint8_t>(i);
+        }
+        mark(fields, PermutationRank::rank(identity, inverse, n), 1);
+
+        const size_t chunks = static_cast<size_t>((words + kChunkWords - 1) / kChunkWords);
+        for (uint32_t depth = 0;; ++depth) {
+            const uint64_t code = depth % 2 + 1;
+            const uint64_t next = 3 - code;
+            std::atomic<uint64_t> reached{0};
+            pool.parallelFor(chunks, [&](unsigned, size_t chunk) {
+                const uint64_t first = chunk * kChunkWords;
+                const uint64_t last = std::min(words, first + kChunkWords);
+                uint64_t count = 0;
+                uint8_t perm[kMaxSize];
+                uint8_t child[kMaxSize];
+                uint8_t childInverse[kMaxSize];
+                for (uint64_t word = first; word < last; ++word) {
+                    // One bit, the low one of the field, for every field equal to `code`
+                    const uint64_t differ = __atomic_load_n(&fields[word], __ATOMIC_RELAXED) ^ (code * kLowBits);
+                    uint64_t matches = ~(differ | differ >> 1) & kLowBits;
+                    while (matches) {
+                        const uint64_t rank = word * 32 + static_cast<uint64_t>(__builtin_ctzll(matches)) / 2;
+                        matches &= matches - 1;
+                        ++count;
+                        mark(fields, rank, kExpanded);
+                        if (distances) {
+                            distances[rank / 2] |= static_cast<uint8_t>(std::min<uint32_t>(depth, 15) << (rank % 2 * 4));
+                        }
+                        PermutationRank::unrank(rank, perm, n);
+                        for (uint32_t length = 2; length <= n; ++length) {
+                            std::memcpy(child, perm, n);
+                            std::reverse(child, child + length);
+                            for (uint32_t i = 0; i < n; ++i) {
+                                childInverse[child[i]] = static_cast<uint8_t>(i);
+                            }
+                            const uint64_t target = PermutationRank::rank(child, childInverse, n);
+                            if (field(fields, target) == 0) {
+                                mark(fields, target, next);
+                            }
+                        }
+                    }
+                }
+                reached.fetch_add(count, std::memory_order_relaxed);
+            }, 1);
+            if (reached.load() == 0) {
+                break;
+            }
+            result.distribution.push_back(reached.load());
+        }
+
+        if (distances) {
+            PancakeTableHeader header{};
+            std::memcpy(header.magic, kMagic, sizeof(header.magic));
+            header.size = n;
+            header.diameter = static_cast<uint32_t>(result.distribution.size() - 1);
+            header.states = states;
+            for (size_t d = 0; d < result.distribution.size() && d < 32; ++d) {
+                header.distribution[d] = result.distribution[d];
+            }
+            std::memcpy(table.data(), &header, sizeof(header));
+            if (!table.close()) {
+                std::cerr << "Error writing file: " << options.tablePath << std::endl;
+                return result;
+            }
+        }
+        result.ok = true;
+        return result;
+    }
+
+    unsigned threads() const {
+        return pool.size();
+    }
+
+private:
+    friend class PancakeDistanceTable;
+
+    static constexpr const char* kMagic = "LFAPANC1";
+    static constexpr uint64_t kLowBits = 0x5555555555555555ull;
+    static constexpr uint64_t kExpanded = 3;
+    static constexpr uint64_t kChunkWords = 1 << 12;   // 2^17 ranks, a multiple of both 32 and 2
+
+    // A zero-filled region of anonymous memory or of a file mapped shared. An empty path means
+    // memory; a path ending in XXXXXX is a scratch file, removed as soon as it is mapped.
+    class MappedBuffer {
+    public:
+        MappedBuffer() = default;
+
+        ~MappedBuffer() {
+            close();
+        }
+
+        MappedBuffer(const MappedBuffer&) = delete;
+        MappedBuffer& operator=(const MappedBuffer&) = delete;
+
+        bool create(uint64_t bytes, std::string path, bool scratch) {
+            size_ = static_cast<size_t>(bytes);
+#ifdef PANCAKE_MMAP
+            if (path.empty()) {
+                void* mapped = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (mapped == MAP_FAILED) {
+                    std::cerr << "Cannot allocate " << size_ << " bytes" << std::endl;
+                    return false;
+                }
+                data_ = mapped;
+                return true;
+            }
+            int fd = scratch ? mkstemp(&path[0]) : ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                std::cerr << "Error opening file: " << path << std::endl;
+                return false;
+            }
+            void* mapped = MAP_FAILED;
+            if (ftruncate(fd, static_cast<off_t>(size_)) == 0) {
+                mapped = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+            if (scratch) {
+                unlink(path.c_str());
+            }
+            if (mapped == MAP_FAILED) {
+                std::cerr << "Cannot map " << size_ << " bytes of " << path << std::endl;
+                return false;
+            }
+            data_ = mapped;
+            mapped_ = true;
+            return true;
+#else
+            // Without mmap everything stays in memory and a table is written out on close
+            data_ = std::calloc(size_, 1);
+            path_ = scratch ? std::string() : path;
+            if (!data_) {
+                std::cerr << "Cannot allocate " << size_ << " bytes" << std::endl;
+            }
+            return data_ != nullptr;
+#endif
+        }
+
+        // Unmaps (a file mapping is written back first); false if the data could not be saved
+        bool close() {
+            bool saved = true;
+            if (!data_) {
+                return saved;
+            }
+#ifdef PANCAKE_MMAP
+            if (mapped_) {
+                saved = msync(data_, size_, MS_SYNC) == 0;
+            }
+            munmap(data_, size_);
+#else
+            if (!path_.empty()) {
+                std::FILE* file = std::fopen(path_.c_str(), "wb");
+                saved = file && std::fwrite(data_, 1, size_, file) == size_;
+                saved = file && std::fclose(file) == 0 && saved;
+            }
+            std::free(data_);
+#endif
+            data_ = nullptr;
+            mapped_ = false;
+            return saved;
+        }
+
+        void* data() const {
+            return data_;
+        }
+
+    private:
+        void* data_ = nullptr;
+        size_t size_ = 0;
+        bool mapped_ = false;
+        std::string path_;
+    };
+
+    Options options;
+    WorkStealingPool pool;
+
+    uint64_t memoryLimit() const {
+        if (options.memoryLimit > 0) {
+            return options.memoryLimit;
+        }
+#ifdef PANCAKE_MMAP
+        const long pages = sysconf(_SC_PHYS_PAGES);
+        const long pageSize = sysconf(_SC_PAGESIZE);
+        if (pages > 0 && pageSize > 0) {
+            return static_cast<uint64_t>(pages) * static_cast<uint64_t>(pageSize) / 2;
+        }
+#endif
+        return UINT64_MAX;
+    }
+
+    static uint64_t field(const uint64_t* fields, uint64_t rank) {
+        return __atomic_load_n(&fields[rank / 32], __ATOMIC_RELAXED) >> (rank % 32 * 2) & 3;
+    }
+
+    // Children of one level all get the same code, so racing marks of one field agree; marking a
+    // frontier field kExpanded sets its remaining bit
+    static void mark(uint64_t* fields, uint64_t rank, uint64_t code) {
+        __atomic_fetch_or(&fields[rank / 32], code << (rank % 32 * 2), __ATOMIC_RELAXED);
+    }
+};
+
+/**
+  Read-only view of a table written by PancakeEnumerator, mapped rather than loaded, so opening
+  even the table of 14 pancakes is instant and only the pages queried are read.
+
+  A nibble holds distances up to 15 exactly. The pancake numbers of n <= 14 are at most 16, so a
+  15 is resolved from the neighbours: the permutation is at distance 15 if one flip reaches a
+  permutation at 14, and at 16 otherwise.
+ */
+class PancakeDistanceTable {
+public:
+    bool open(const std::string& path) {
+        if (!file.open(path)) {
+            std::cerr << "Error opening file: " << path << std::endl;
+            return false;
+        }
+        if (file.size() < sizeof(PancakeTableHeader)) {
+            std::cerr << "Not a pancake distance table: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(&header, file.contents().data(), sizeof(header));
+        if (std::memcmp(header.magic, PancakeEnumerator::kMagic, sizeof(header.magic)) != 0 ||
+            header.size < 1 || header.size > PancakeEnumerator::kMaxSize ||
+            header.states != PermutationRank::factorial(header.size) ||
+            file.size() < sizeof(PancakeTableHeader) + (header.states + 1) / 2) {
+            std::cerr << "Not a pancake distance table: " << path << std::endl;
+            return false;
+        }
+        nibbles = reinterpret_cast<const uint8_t*>(file.contents().data()) + sizeof(PancakeTableHeader);
+        return true;
+    }
+
+    uint32_t size() const {
+        return header.size;
+    }
+
+    uint32_t diameter() const {
+        return header.diameter;
+    }
+
+    std::vector<uint64_t> distribution() const {
+        return std::vector<uint64_t>(header.distribution, header.distribution + std::min<uint32_t>(header.diameter + 1, 32));
+    }
+
+    // Fewest flips that sort `arr`; -1 if its length is not the size of the table or its values
+    // are not distinct (the table holds permutations, and fixing one order of equal values
+    // would not give the minimum)
+    int distance(const std::vector<int>& arr) const {
+        const uint32_t n = header.size;
+        if (!nibbles || arr.size() != n) {
+            return -1;
+        }
+        uint8_t order[PancakeEnumerator::kMaxSize];
+        uint8_t perm[PancakeEnumerator::kMaxSize];
+        for (uint32_t i = 0; i < n; ++i) {
+            order[i] = static_cast<uint8_t>(i);
+        }
+        std::sort(order, order + n, [&](uint8_t a, uint8_t b) { return arr[a] < arr[b]; });
+        for (uint32_t rank = 0; rank < n; ++rank) {
+            if (rank > 0 && arr[order[rank - 1]] == arr[order[rank]]) {
+                return -1;
+            }
+            perm[order[rank]] = static_cast<uint8_t>(rank);
+        }
+
+        const uint32_t stored = lookup(perm);
+        if (stored < 15) {
+            return static_cast<int>(stored);
+        }
+        uint8_t child[PancakeEnumerator::kMaxSize];
+        for (uint32_t length = 2; length <= n; ++length) {
+            std::memcpy(child, perm, n);
+            std::reverse(child, child + length);
+            if (lookup(child) == 14) {
+                return 15;
+            }
+        }
+        return 16;
+    }
+
+private:
+    MappedFile file;
+    PancakeTableHeader header{};
+    const uint8_t* nibbles = nullptr;
+
+    uint32_t lookup(const uint8_t* perm) const {
+        const uint32_t n = header.size;
+        uint8_t copy[PancakeEnumerator::kMaxSize];
+        uint8_t inverse[PancakeEnumerator::kMaxSize];
+        std::memcpy(copy, perm, n);
+        for (uint32_t i = 0; i < n; ++i) {
+            inverse[copy[i]] = static_cast<uint8_t>(i);
+        }
+        const uint64_t rank = PermutationRank::rank(copy, inverse, n);
+        return nibbles[rank / 2] >> (rank % 2 * 4) & 15;
+    }
+};
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef PANCAKE_SOLVER_H
+#define PANCAKE_SOLVER_H
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include "work_stealing_pool.h"
+
+/**
+  Optimal prefix-reversal solver: finds a shortest flip sequence that sorts an array, where
+  pancakeSort() needs up to 2n - 3 flips.
+
+  The values are ranked densely (equal values share a rank, so the search runs on value classes
+  and any order of equal values is sorted) and stored as bytes with a plate below them, ranked
+  one past the largest. Iterative deepening A* uses the gap lower bound: every pair of neighbours
+  whose ranks differ by more than one needs at least one flip to separate them, and a flip of
+  length k changes only the pair (k - 1, k), so the bound of a child is updated in O(1). With
+  repeated values no gaps does not mean sorted ([0 1 0]), so the goal is checked with is_sorted.
+  The search flips the one permutation in place and flips back on return, never copying it;
+  children that close a gap are tried first and the flip just made is never repeated. Such a
+  child cuts right above a rank neighbour of the top pancake, so the two candidates are found
+  directly when the values are distinct; at nodes with no slack left in the bound they are the
+  only children, and the other cuts are not even looked at.
+
+  Each bound is searched in parallel: the tree is cut a level or two below the root into
+  subtrees, which a work stealing pool hands out, so one deep subtree does not leave the other
+  cores idle. Any sequence found within a bound is optimal, since the previous bound had none;
+  the first one found stops every worker. Which of several optimal sequences is returned may
+  depend on timing.
+ */
+class PancakeSolver {
+public:
+    using FlipSequence = std::vector<uint32_t>;
+
+    static constexpr size_t kMaxSize = 255;
+
+    struct Solution {
+        FlipSequence flips;   // entry k is the length of the prefix reversed by flip k
+        uint32_t lowerBound = 0; // gaps of the input
+        uint64_t nodes = 0;   // permutations expanded over all bounds
+        bool solved = false;  // false only for arrays longer than kMaxSize
+    };
+
+    // threads == 0 uses one worker per hardware thread
+    explicit PancakeSolver(unsigned threads = 0) : pool(threads) {}
+
+    Solution solve(const std::vector<int>& arr) {
+        Solution solution;
+        const size_t n = arr.size();
+        if (n > kMaxSize) {
+            return solution;
+        }
+
+        // Rank the values densely; equal values get the same rank
+        std::vector<int> values(arr);
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        distinct = values.size() == n;
+        root.assign(n + 1, static_cast<uint8_t>(values.size()));
+        for (size_t i = 0; i < n; ++i) {
+            root[i] = static_cast<uint8_t>(std::lower_bound(values.begin(), values.end(), arr[i]) - values.begin());
+        }
+
+        uint32_t gaps = 0;
+        for (size_t i = 0; i < n; ++i) {
+            gaps += isGap(root[i], root[i + 1]);
+        }
+        solution.lowerBound = gaps;
+        solution.solved = true;
+        nodes = 0;
+        if (isSorted(root, gaps)) {
+            return solution;
+        }
+
+        std::vector<Worker> workers(pool.size());
+        for (uint32_t bound = gaps;; ++bound) {
+            // Subtrees: enough for every worker to steal from, at most two levels deep
+            tasks.clear();
+            found.store(false);
+            FlipSequence path;
+            std::vector<uint8_t> state = root;
+            size_t depth = 1;
+            split(state, path, 0, gaps, bound, depth);
+            if (!found.load() && tasks.size() < 16 * static_cast<size_t>(pool.size()) && bound >= 2) {
+                tasks.clear();
+                depth = 2;
+                split(state, path, 0, gaps, bound, depth);
+            }
+
+            pool.parallelFor(tasks.size(), [&](unsigned id, size_t index) {
+                if (found.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                Worker& worker = workers[id];
+                worker.state = root;
+                worker.path = tasks[index].path;
+                for (uint32_t length : worker.path) {
+                    std::reverse(worker.state.begin(), worker.state.begin() + length);
+                }
+                worker.nodes = 0;
+                const uint32_t previous = worker.path.empty() ? 0 : worker.path.back();
+                if (search(worker, static_cast<uint32_t>(worker.path.size()), tasks[index].gaps, bound, previous)) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!found.exchange(true)) {
+                        best = worker.path;
+                    }
+                }
+                nodes.fetch_add(worker.nodes, std::memory_order_relaxed);
+            }, 1);
+
+            if (found.load()) {
+                solution.flips = best;
+                solution.nodes = nodes.load();
+                return solution;
+            }
+        }
+    }
+
+    unsigned threads() const {
+        return pool.size();
+    }
+
+private:
+    // A subtree root: the flips leading to it and its gap count
+    struct Task {
+        FlipSequence path;
+        uint32_t gaps;
+    };
+
+    struct Worker {
+        std::vector<uint8_t> state;
+        FlipSequence path;
+        uint64_t nodes = 0;
+    };
+
+    WorkStealingPool pool;
+    std::vector<uint8_t> root;
+    bool distinct = true;
+    std::vector<Task> tasks;
+    std::atomic<bool> found{false};
+    std::atomic<uint64_t> nodes{0};
+    std::mutex mutex;
+    FlipSequence best;
+
+    static bool isGap(uint8_t a, uint8_t b) {
+        return a > b + 1 || b > a + 1;
+    }
+
+    // Without gaps distinct ranks are sorted; repeated ones still need the check
+    bool isSorted(const std::vector<uint8_t>& state, uint32_t gaps) const {
+        return gaps == 0 && (distinct || std::is_sorted(state.begin(), state.end()));
+    }
+
+    // Change of the gap count when the prefix of `length` is reversed: only the pair
+    // (length - 1, length) changes, into (0, length)
+    static int gapDelta(const std::vector<uint8_t>& state, uint32_t length) {
+        return static_cast<int>(isGap(state[0], state[length])) - static_cast<int>(isGap(state[length - 1], state[length]));
+    }
+
+    // Collects the nodes `depth` flips below `state` that fit the bound; a sorted node found on
+    // the way is the answer and ends the split
+    void split(std::vector<uint8_t>& state, FlipSequence& path, uint32_t g, uint32_t gaps, uint32_t bound, size_t depth) {
+        if (isSorted(state, gaps)) {
+            best = path;
+            found.store(true);
+            return;
+        }
+        if (path.size() == depth) {
+            tasks.push_back(Task{path, gaps});
+            return;
+        }
+        const uint32_t n = static_cast<uint32_t>(state.size() - 1);
+        for (uint32_t length = 2; length <= n && !found.load(); ++length) {
+            if (!path.empty() && length == path.back()) {
+                continue;
+            }
+            const uint32_t child = static_cast<uint32_t>(static_cast<int>(gaps) + gapDelta(state, length));
+            if (g + 1 + child > bound) {
+                continue;
+            }
+            std::reverse(state.begin(), state.begin() + length);
+            path.push_back(length);
+            split(state, path, g + 1, child, bound, depth);
+            path.pop_back();
+            std::reverse(state.begin(), state.begin() + length);
+        }
+    }
+
+    // Depth-first search below the worker's state within `bound`; the path holds the solution on success
+    bool search(Worker& worker, uint32_t g, uint32_t gaps, uint32_t bound, uint32_t previous) {
+        if (isSorted(worker.state, gaps)) {
+            return true;
+        }
+        ++worker.nodes;
+        if ((worker.nodes & 0x3FF) == 0 && found.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        std::vector<uint8_t>& state = worker.state;
+        const uint32_t n = static_cast<uint32_t>(state.size() - 1);
+        const uint32_t slack = bound - g - gaps;
+
+        // A flip closes a gap only if it cuts right above a rank neighbour of the top pancake;
+        // with distinct values there are at most two such children, found without looking at
+        // every cut, otherwise they are picked from the deltas of all cuts below
+        const uint8_t top = state[0];
+        for (int side = -1; side <= 1 && distinct; side += 2) {
+            if ((side < 0 && top == 0) || (side > 0 && top == n)) {
+                continue;
+            }
+            const uint8_t* at = static_cast<const uint8_t*>(std::memchr(state.data() + 2, top + side, n - 1));
+            if (!at) {
+                continue;
+            }
+            const uint32_t length = static_cast<uint32_t>(at - state.data());
+            if (length == previous || !isGap(state[length - 1], state[length])) {
+                continue;
+            }
+            if (descend(worker, length, g, gaps - 1, bound)) {
+                return true;
+            }
+        }
+        const int first = distinct ? 0 : -1;
+        if (slack == 0 && first == 0) {
+            return false;
+        }
+
+        // Then the children that keep the count and, with slack to spare, those that add a gap
+        int8_t delta[kMaxSize + 1];
+        for (uint32_t length = 2; length <= n; ++length) {
+            delta[length] = static_cast<int8_t>(gapDelta(state, length));
+        }
+        for (int pass = first; pass <= 1 && pass < static_cast<int>(slack); ++pass) {
+            for (uint32_t length = 2; length <= n; ++length) {
+                if (delta[length] == pass && length != previous &&
+                    descend(worker, length, g, gaps + pass, bound)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool descend(Worker& worker, uint32_t length, uint32_t g, uint32_t gaps, uint32_t bound) {
+        std::reverse(worker.state.begin(), worker.state.begin() + length);
+        worker.path.push_back(length);
+        if (search(worker, g + 1, gaps, bound, length)) {
+            return true;
+        }
+        worker.path.pop_back();
+        std::reverse(worker.state.begin(), worker.state.begin() + length);
+        return false;
+    }
+};
+
+#endif
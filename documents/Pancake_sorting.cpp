@@ -1,50 +1,59 @@
-#include <iostream>
-#include <vector>
-#include <algorithm>
+#include "Pancake_sorting.h"
+#include "Pancake_engine.h"
+#include "Pancake_solver.h"
+#include "Pancake_enumerator.h"
 
-// Function to flip (reverse) the sub-array arr[0...i]
-void flip(std::vector<int>& arr, int i) {
-    std::reverse(arr.begin(), arr.begin() + i + 1);
-}
+#include <string>
 
-// Function to find the index of the maximum element in arr[0...n-1]
-int findMaxIndex(const std::vector<int>& arr, int n) {
-    auto it = std::max_element(arr.begin(), arr.begin() + n);
-    return std::distance(arr.begin(), it);
-}
-// Helper function to print the array
-void printArray(const std::vector<int>& arr) {
-    for (size_t i = 0; i < arr.size(); ++i) {
-        std::cout << arr[i] << " ";
+// The main function to test the code
+// Usage: ./pancake_sort [--optimal] [--table FILE] [--threads N]
+//        ./pancake_sort --enumerate N [--table FILE] [--memory BYTES] [--scratch DIR] [--threads N]
+// --optimal also searches for a shortest flip sequence (arrays of up to 255 elements) and
+// --table looks the number of flips up in a distance table. --enumerate prints how many of the
+// N! permutations are at each flip distance and, with --table, writes that table.
+int main(int argc, char* argv[]) {
+    bool optimal = false;
+    unsigned threads = 0;
+    uint32_t enumerate = 0;
+    std::string tablePath;
+    PancakeEnumerator::Options enumeration;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--optimal") {
+            optimal = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--enumerate" && i + 1 < argc) {
+            enumerate = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--table" && i + 1 < argc) {
+            tablePath = argv[++i];
+        } else if (arg == "--memory" && i + 1 < argc) {
+            enumeration.memoryLimit = std::stoull(argv[++i]);
+        } else if (arg == "--scratch" && i + 1 < argc) {
+            enumeration.scratchDir = argv[++i];
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
     }
-    std::cout << std::endl;
-}
-void pancakeSort(std::vector<int>& arr) {
-    int n = arr.size();
-
-    // Start from the complete array size and gradually reduce it by one
-    for (int current_size = n; current_size > 1; --current_size) {
-        // Find the index of the maximum element in the unsorted sub-array arr[0...current_size-1]
-        int max_index = findMaxIndex(arr, current_size);
 
-        if (max_index != current_size - 1) {
-            // 1. Bring the maximum element to the front 
-            if (max_index != 0) {
-                flip(arr, max_index);
-            }
-
-            // 2. Move the maximum element (now at the front) to its correct position.
-            flip(arr, current_size - 1);
+    if (enumerate > 0) {
+        enumeration.threads = threads;
+        enumeration.tablePath = tablePath;
+        PancakeEnumerator::Result result = PancakeEnumerator(enumeration).enumerate(enumerate);
+        if (!result.ok) {
+            return 1;
+        }
+        for (size_t distance = 0; distance < result.distribution.size(); ++distance) {
+            std::cout << distance << " flips: " << result.distribution[distance] << std::endl;
         }
+        std::cout << "Pancake number of " << enumerate << ": " << result.distribution.size() - 1 << std::endl;
+        return 0;
+    }
+    PancakeDistanceTable table;
+    if (!tablePath.empty() && !table.open(tablePath)) {
+        return 1;
     }
-    ::printArray(arr);
-
-}
-
-
-
-// The main function to test the code
-int main() {
     int n;
     std::vector<int> array;
     std::cout<<"Input the amount of elements in the array: ";
@@ -60,10 +69,39 @@ int main() {
     std::cout << "------------------------------------"<<std::endl;
     std::cout << "Initial array: ";
     printArray(array);
+    const std::vector<int> initial = array;
     std::cout << "------------------------------------"<<std::endl;
     std::cout << "Sorted array: ";
-    pancakeSort(array);
-    
+    PancakeSorter::FlipSequence flips = PancakeSorter().sort(array);
+    printArray(array);
+    std::cout << "Flips (prefix lengths): ";
+    for (uint32_t length : flips) {
+        std::cout << length << " ";
+    }
+    std::cout << std::endl;
+
+    if (optimal) {
+        PancakeSolver::Solution solution = PancakeSolver(threads).solve(initial);
+        std::cout << "------------------------------------"<<std::endl;
+        if (!solution.solved) {
+            std::cout << "The optimal search supports at most " << PancakeSolver::kMaxSize << " elements" << std::endl;
+            return 1;
+        }
+        std::cout << "Optimal flips (" << solution.flips.size() << " instead of " << flips.size() << "): ";
+        for (uint32_t length : solution.flips) {
+            std::cout << length << " ";
+        }
+        std::cout << std::endl;
+    }
+    if (!tablePath.empty()) {
+        std::cout << "------------------------------------"<<std::endl;
+        const int distance = table.distance(initial);
+        if (distance < 0) {
+            std::cout << "The table is for arrays of " << table.size() << " distinct elements" << std::endl;
+            return 1;
+        }
+        std::cout << "Optimal flips (from the table): " << distance << std::endl;
+    }
 
     return 0;
 }
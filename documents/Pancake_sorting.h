@@ -0,0 +1,64 @@
+#ifndef PANCAKE_SORTING_H
+#define PANCAKE_SORTING_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// What a sort cost: the number of flips, and the elements scanned for a maximum or moved by a flip
+struct PancakeStats {
+    size_t flips = 0;
+    size_t touched = 0;
+};
+
+// Function to flip (reverse) the sub-array arr[0...i]
+inline void flip(std::vector<int>& arr, int i) {
+    std::reverse(arr.begin(), arr.begin() + i + 1);
+}
+
+// Function to find the index of the maximum element in arr[0...n-1]
+inline int findMaxIndex(const std::vector<int>& arr, int n) {
+    auto it = std::max_element(arr.begin(), arr.begin() + n);
+    return std::distance(arr.begin(), it);
+}
+// Helper function to print the array
+inline void printArray(const std::vector<int>& arr) {
+    for (size_t i = 0; i < arr.size(); ++i) {
+        std::cout << arr[i] << " ";
+    }
+    std::cout << std::endl;
+}
+// Sorts the array in place; the cost is added to `stats` when one is given
+inline void pancakeSort(std::vector<int>& arr, PancakeStats* stats = nullptr) {
+    int n = arr.size();
+
+    // Start from the complete array size and gradually reduce it by one
+    for (int current_size = n; current_size > 1; --current_size) {
+        // Find the index of the maximum element in the unsorted sub-array arr[0...current_size-1]
+        int max_index = findMaxIndex(arr, current_size);
+        if (stats) {
+            stats->touched += current_size;
+        }
+
+        if (max_index != current_size - 1) {
+            // 1. Bring the maximum element to the front 
+            if (max_index != 0) {
+                flip(arr, max_index);
+                if (stats) {
+                    stats->flips++;
+                    stats->touched += max_index + 1;
+                }
+            }
+
+            // 2. Move the maximum element (now at the front) to its correct position.
+            flip(arr, current_size - 1);
+            if (stats) {
+                stats->flips++;
+                stats->touched += current_size;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "Power_digits.h"
+
+#include <iostream>
+#include <string>
+
+// Usage: ./power_digits even|zero MAX_EXPONENT [--from K] [--threads N] [--scalar]
+// even: the powers 2^k, K <= k <= MAX_EXPONENT, with only even digits (2^11_2.py)
+// zero: the powers without a digit 0 among them, and how many have one (86_conj.py)
+// The powers themselves are printed up to 2^10000; the scan has no upper limit.
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " even|zero MAX_EXPONENT [--from K] [--threads N] [--scalar]" << std::endl;
+        return 1;
+    }
+    const std::string query = argv[1];
+    if (query != "even" && query != "zero") {
+        std::cerr << "Unknown query: " << query << std::endl;
+        return 1;
+    }
+    const uint64_t maxExponent = std::stoull(argv[2]);
+    uint64_t from = 1;
+    unsigned threads = 0;
+    PowerDigitScanner::Kernel kernel = PowerDigitScanner::Kernel::Auto;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--from" && i + 1 < argc) {
+            from = std::stoull(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--scalar") {
+            kernel = PowerDigitScanner::Kernel::Scalar;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    PowerDigitScanner scanner(threads, kernel);
+    const bool even = query == "even";
+    PowerDigitScanner::Report report =
+        scanner.scan(even ? PowerDigitScanner::Query::OnlyEvenDigits : PowerDigitScanner::Query::ContainsZero, from, maxExponent);
+
+    if (even) {
+        std::cout << "-----Powers of 2 from 2^" << from << " to 2^" << maxExponent << " that have only even digits -----" << std::endl;
+    } else {
+        std::cout << "-----Powers of 2 from 2^" << from << " to 2^" << maxExponent << " that do not have a single zero -----" << std::endl;
+    }
+    for (uint64_t exponent : report.rare) {
+        if (exponent <= 10000) {
+            std::cout << PowerDigitScanner::decimal(exponent) << " = ";
+        }
+        std::cout << "2^" << exponent << std::endl;
+    }
+    if (!even) {
+        std::cout << report.holding << " of " << report.scanned << " powers have at least one zero" << std::endl;
+    }
+    std::cerr << report.scanned << " exponents in " << report.seconds << " s: " << report.exponentsPerSecond()
+              << " exponents/s (" << scanner.threads() << " threads, " << PowerDigitScanner::kernelName(scanner.activeKernel())
+              << ")" << std::endl;
+    return 0;
+}
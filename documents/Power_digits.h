@@ -0,0 +1,337 @@
+#ifndef POWER_DIGITS_H
+#define POWER_DIGITS_H
+
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "work_stealing_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POWER_DIGITS_X86 1
+#endif
+
+/**
+  Native version of the queries of 2^11_2.py and 86_conj.py: which powers 2^k, for k in a
+  range, have only even digits, and which have no digit 0.
+
+  The scripts rebuild 2^k for every exponent and peel its digits with % 10, quadratic work per
+  exponent. Here 2^k is kept in limbs of base 10^18 (18 decimal digits per uint64_t, lowest limb
+  first) and doubled in place from one exponent to the next. A limb below 5 * 10^17 doubles
+  without a carry and one above it carries exactly 1, which the limb above absorbs without
+  carrying again, so every limb of 2 * x depends only on two limbs of x: no carry chain, and the
+  AVX2 kernel doubles 4 limbs per instruction. Digits are tested 4 at a time with a table of the
+  10^4 groups, from the lowest limb up, so most exponents are rejected in the first limb.
+
+  The range is cut into blocks of about equal work (a doubling costs as many limbs as 2^k has),
+  which a work stealing pool hands out; each block starts from 2^from computed by square and
+  multiply, with schoolbook products in base 10^9 and 128-bit column sums.
+ */
+class PowerDigitScanner {
+public:
+    enum class Query {
+        OnlyEvenDigits,
+        ContainsZero
+    };
+
+    // How powers are doubled: scalar code, the AVX2 kernel, or the best one supported
+    enum class Kernel {
+        Scalar,
+        Avx2,
+        Auto
+    };
+
+    using Limbs = std::vector<uint64_t>;
+
+    struct Report {
+        uint64_t scanned = 0;
+        uint64_t holding = 0;             // exponents for which the query holds
+        std::vector<uint64_t> rare;       // in order: exponents with only even digits, or with no zero
+        double seconds = 0;
+
+        double exponentsPerSecond() const {
+            return seconds > 0 ? static_cast<double>(scanned) / seconds : 0;
+        }
+    };
+
+    static constexpr uint64_t kBase = 1000000000000000000ull;
+
+    explicit PowerDigitScanner(unsigned threads = 0, Kernel chosen = Kernel::Auto)
+        : pool(threads), kernel(chosen == Kernel::Auto ? bestKernel() : chosen) {
+        if (!isSupported(kernel)) {
+            kernel = Kernel::Scalar;
+        }
+    }
+
+    Kernel activeKernel() const {
+        return kernel;
+    }
+
+    unsigned threads() const {
+        return pool.size();
+    }
+
+    // Answers `query` for 2^k, from <= k <= to
+    Report scan(Query query, uint64_t from, uint64_t to) {
+        Report report;
+        if (from > to) {
+            return report;
+        }
+        auto started = std::chrono::steady_clock::now();
+
+        // Block b ends where the work from `from`, which grows like k^2, reaches (b + 1) / blocks
+        const size_t blocks = static_cast<size_t>(std::min<uint64_t>(to - from + 1, pool.size() * 4));
+        std::vector<uint64_t> starts{from};
+        const double low = static_cast<double>(from);
+        const double high = static_cast<double>(to) + 1;
+        for (size_t b = 1; b < blocks; ++b) {
+            const uint64_t start = static_cast<uint64_t>(std::sqrt(low * low + (high * high - low * low) * b / blocks));
+            if (start > starts.back() && start <= to) {
+                starts.push_back(start);
+            }
+        }
+        starts.push_back(to + 1);
+
+        std::mutex mutex;
+        pool.parallelFor(starts.size() - 1, [&](unsigned, size_t block) {
+            const uint64_t first = starts[block];
+            const uint64_t last = starts[block + 1];
+            Limbs limbs = power(first);
+            limbs.reserve(limbCount(last));
+            uint64_t holding = 0;
+            std::vector<uint64_t> rare;
+            for (uint64_t exponent = first;; ++exponent) {
+                const bool holds = query == Query::OnlyEvenDigits ? onlyEvenDigits(limbs) : containsZero(limbs);
+                holding += holds;
+                if (holds == (query == Query::OnlyEvenDigits)) {
+                    rare.push_back(exponent);
+                }
+                if (exponent + 1 == last) {
+                    break;
+                }
+                doubleInPlace(limbs);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            report.holding += holding;
+            report.rare.insert(report.rare.end(), rare.begin(), rare.end());
+        }, 1);
+
+        std::sort(report.rare.begin(), report.rare.end());
+        report.scanned = to - from + 1;
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return report;
+    }
+
+    // 2^exponent in base 10^18 limbs, by square and multiply
+    static Limbs power(uint64_t exponent) {
+        // Base 10^9 while multiplying: a column of products then fits a 128-bit sum
+        std::vector<uint32_t> value{1};
+        for (int bit = 63; bit >= 0; --bit) {
+            if (value.size() > 1 || value[0] > 1) {
+                value = square(value);
+            }
+            if (exponent >> bit & 1) {
+                uint32_t carry = 0;
+                for (uint32_t& limb : value) {
+                    const uint32_t doubled = limb * 2 + carry;
+                    carry = doubled >= kSmallBase;
+                    limb = doubled - (carry ? kSmallBase : 0);
+                }
+                if (carry) {
+                    value.push_back(carry);
+                }
+            }
+        }
+        Limbs limbs((value.size() + 1) / 2);
+        for (size_t i = 0; i < value.size(); ++i) {
+            limbs[i / 2] += i % 2 ? uint64_t(value[i]) * kSmallBase : value[i];
+        }
+        return limbs;
+    }
+
+    // 2^exponent in decimal
+    static std::string decimal(uint64_t exponent) {
+        const Limbs limbs = power(exponent);
+        std::string text = std::to_string(limbs.back());
+        for (size_t i = limbs.size() - 1; i-- > 0;) {
+            const std::string digits = std::to_string(limbs[i]);
+            text += std::string(18 - digits.size(), '0') + digits;
+        }
+        return text;
+    }
+
+    // Leading zeros of the top limb are even, so every limb can be tested whole
+    static bool onlyEvenDigits(const Limbs& limbs) {
+        const Tables& table = tables();
+        for (uint64_t limb : limbs) {
+            const uint32_t parts[2] = {static_cast<uint32_t>(limb % kSmallBase), static_cast<uint32_t>(limb / kSmallBase)};
+            for (uint32_t part : parts) {
+                if (!(table.flags[part / 100000] & table.flags[part / 10 % 10000] & kAllEven) || part % 2) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // The top limb has leading zeros that are no digits, so it is tested digit by digit
+    static bool containsZero(const Limbs& limbs) {
+        const Tables& table = tables();
+        for (size_t i = 0; i + 1 < limbs.size(); ++i) {
+            const uint32_t parts[2] = {static_cast<uint32_t>(limbs[i] % kSmallBase), static_cast<uint32_t>(limbs[i] / kSmallBase)};
+            for (uint32_t part : parts) {
+                if ((table.flags[part / 100000] | table.flags[part / 10 % 10000]) & kHasZero || part % 10 == 0) {
+                    return true;
+                }
+            }
+        }
+        for (uint64_t top = limbs.back(); top > 0; top /= 10) {
+            if (top % 10 == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static const char* kernelName(Kernel chosen) {
+        switch (chosen) {
+            case Kernel::Scalar: return "scalar";
+            case Kernel::Avx2: return "avx2";
+            default: return "auto";
+        }
+    }
+
+    static bool isSupported(Kernel chosen) {
+#ifdef POWER_DIGITS_X86
+        if (chosen == Kernel::Avx2) {
+            return __builtin_cpu_supports("avx2");
+        }
+#else
+        if (chosen == Kernel::Avx2) {
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    static Kernel bestKernel() {
+        return isSupported(Kernel::Avx2) ? Kernel::Avx2 : Kernel::Scalar;
+    }
+
+private:
+    static constexpr uint32_t kSmallBase = 1000000000;   // base of the seeds, and half a limb when testing digits
+    static constexpr uint64_t kHalf = kBase / 2;   // limbs from here on carry when doubled
+    static constexpr uint8_t kAllEven = 1;
+    static constexpr uint8_t kHasZero = 2;
+
+    // Flags of every group of 4 digits, leading zeros included
+    struct Tables {
+        std::array<uint8_t, 10000> flags{};
+
+        Tables() {
+            for (uint32_t group = 0; group < 10000; ++group) {
+                uint8_t flag = kAllEven;
+                for (uint32_t rest = group, digit = 0; digit < 4; ++digit, rest /= 10) {
+                    if (rest % 2) {
+                        flag &= ~kAllEven;
+                    }
+                    if (rest % 10 == 0) {
+                        flag |= kHasZero;
+                    }
+                }
+                flags[group] = flag;
+            }
+        }
+    };
+
+    WorkStealingPool pool;
+    Kernel kernel;
+
+    static const Tables& tables() {
+        static const Tables instance;
+        return instance;
+    }
+
+    // Limbs of 2^exponent, from its number of decimal digits
+    static size_t limbCount(uint64_t exponent) {
+        return static_cast<size_t>(static_cast<double>(exponent) * 0.30102999566398120 / 18) + 2;
+    }
+
+    static std::vector<uint32_t> square(const std::vector<uint32_t>& value) {
+        const size_t size = value.size();
+        std::vector<uint32_t> result(2 * size);
+        unsigned __int128 carry = 0;
+        for (size_t column = 0; column + 1 < 2 * size; ++column) {
+            // Each pair i < j appears twice in the column, the middle term once
+            unsigned __int128 sum = 0;
+            const size_t first = column < size ? 0 : column - size + 1;
+            for (size_t i = first, j = column - first; i < j; ++i, --j) {
+                sum += uint64_t(value[i]) * value[j];
+            }
+            sum *= 2;
+            if (column % 2 == 0) {
+                sum += uint64_t(value[column / 2]) * value[column / 2];
+            }
+            sum += carry;
+            result[column] = static_cast<uint32_t>(sum % kSmallBase);
+            carry = sum / kSmallBase;
+        }
+        result[2 * size - 1] = static_cast<uint32_t>(carry);
+        while (result.size() > 1 && result.back() == 0) {
+            result.pop_back();
+        }
+        return result;
+    }
+
+    void doubleInPlace(Limbs& limbs) const {
+        if (limbs.back() >= kHalf) {
+            limbs.push_back(0);
+        }
+        size_t done = limbs.size();
+#ifdef POWER_DIGITS_X86
+        if (kernel == Kernel::Avx2) {
+            done = doubleAvx2(limbs.data(), limbs.size());
+        }
+#endif
+        // Downwards, so limbs[i - 1] is still the old value when limbs[i] is written
+        for (size_t i = done; i-- > 1;) {
+            limbs[i] = twice(limbs[i]) + (limbs[i - 1] >= kHalf);
+        }
+        limbs[0] = twice(limbs[0]);
+    }
+
+    static uint64_t twice(uint64_t limb) {
+        return limb * 2 - (limb >= kHalf ? kBase : 0);
+    }
+
+#ifdef POWER_DIGITS_X86
+    // Doubles the limbs from the top down, 4 at a time, while 4 more and the limb below them
+    // remain; returns how many limbs at the bottom are left for the scalar loop. Limbs stay
+    // below 2^63, so the signed compare works.
+    __attribute__((target("avx2")))
+    static size_t doubleAvx2(uint64_t* limbs, size_t count) {
+        const __m256i half = _mm256_set1_epi64x(static_cast<long long>(kHalf - 1));
+        const __m256i base = _mm256_set1_epi64x(static_cast<long long>(kBase));
+        size_t i = count;
+        while (i >= 5) {
+            i -= 4;
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(limbs + i));
+            const __m256i below = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(limbs + i - 1));
+            const __m256i carries = _mm256_cmpgt_epi64(x, half);
+            const __m256i incoming = _mm256_srli_epi64(_mm256_cmpgt_epi64(below, half), 63);
+            const __m256i doubled = _mm256_sub_epi64(_mm256_add_epi64(x, x), _mm256_and_si256(carries, base));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(limbs + i), _mm256_add_epi64(doubled, incoming));
+        }
+        return i;
+    }
+#endif
+};
+
+#endif
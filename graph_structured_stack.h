@@ -0,0 +1,357 @@
+#ifndef GRAPH_STRUCTURED_STACK_H
+#define GRAPH_STRUCTURED_STACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+  Graph-structured stack for branching pushdown execution, in the style of a GLR parser.
+
+  A stack is a handle to its top node, and a node links to every node it was pushed on: its
+  predecessors. A node stands for all the stacks made of its symbol on top of one of the stacks
+  of a predecessor, so branches share their suffixes and a fork is a copy of a handle. Nodes are
+  merged on (symbol, state, depth) within a level: the caller opens a level per input position
+  with nextLevel(), and a push that finds the node of its key already made in the level adds
+  `below` to its predecessors instead of making another node. Branches that pushed the same
+  symbol into the same state at the same position therefore share one top whatever lies below,
+  which bounds the nodes of a level by symbols * states (times the depths, when the caller keeps
+  them apart). pop() returns every predecessor. With depth 0 for every node, a loop that keeps
+  pushing within a level closes into a cycle of the graph instead of growing the stack.
+
+  Nodes and predecessor edges live in fixed-size blocks of an arena and are never moved, and
+  collect() returns those unreachable from a set of live handles to free lists for reuse.
+ */
+class GraphStructuredStack {
+public:
+    using Handle = int32_t;
+    static constexpr Handle kEmpty = -1;
+
+    // The predecessors of a node, as returned by pop()
+    class Predecessors {
+    public:
+        class Iterator {
+        public:
+            Iterator(const GraphStructuredStack* stacks, int32_t edge) : stacks_(stacks), edge_(edge) {}
+
+            Handle operator*() const {
+                return stacks_->edge(edge_).below;
+            }
+
+            Iterator& operator++() {
+                edge_ = stacks_->edge(edge_).next;
+                return *this;
+            }
+
+            bool operator!=(const Iterator& other) const {
+                return edge_ != other.edge_;
+            }
+
+        private:
+            const GraphStructuredStack* stacks_;
+            int32_t edge_;
+        };
+
+        Predecessors(const GraphStructuredStack* stacks, int32_t first) : stacks_(stacks), first_(first) {}
+
+        Iterator begin() const {
+            return Iterator(stacks_, first_);
+        }
+
+        Iterator end() const {
+            return Iterator(stacks_, kNone);
+        }
+
+    private:
+        const GraphStructuredStack* stacks_;
+        int32_t first_;
+    };
+
+    // Pushes `symbol` on `below` into `state`; the node is new or merged with the one of the same
+    // key in this level. `added` tells whether `below` was not a predecessor of it yet.
+    Handle push(Handle below, int32_t symbol, int32_t state, uint32_t depth, bool& added) {
+        if (nodeSlots_.empty() || (usedNodeSlots_.size() + 1) * 2 > nodeSlots_.size()) {
+            rehashNodes(nodeSlots_.empty() ? 1024 : nodeSlots_.size() * 2);
+        }
+        const size_t slot = findNode(symbol, state, depth);
+        Handle handle = nodeSlots_[slot];
+        if (handle == kEmpty) {
+            handle = allocateNode();
+            Node& created = node(handle);
+            created.symbol = symbol;
+            created.state = state;
+            created.depth = depth;
+            created.edges = kNone;
+            created.mark = epoch_;
+            nodeSlots_[slot] = handle;
+            usedNodeSlots_.push_back(slot);
+        }
+        added = link(handle, below);
+        return handle;
+    }
+
+    Predecessors pop(Handle top) const {
+        return Predecessors(this, node(top).edges);
+    }
+
+    int32_t top(Handle handle) const {
+        return node(handle).symbol;
+    }
+
+    uint32_t depth(Handle handle) const {
+        return handle == kEmpty ? 0 : node(handle).depth;
+    }
+
+    // Starts a new level: later pushes no longer merge with the nodes made so far
+    void nextLevel() {
+        for (size_t slot : usedNodeSlots_) {
+            nodeSlots_[slot] = kEmpty;
+        }
+        for (size_t slot : usedEdgeSlots_) {
+            edgeSlots_[slot] = kNone;
+        }
+        usedNodeSlots_.clear();
+        usedEdgeSlots_.clear();
+    }
+
+    // Frees every node and edge that is not reachable from one of the given handles; the level
+    // is closed as by nextLevel()
+    void collect(const std::vector<Handle>& roots) {
+        ++epoch_;
+        std::vector<Handle> pending;
+        for (Handle root : roots) {
+            if (root != kEmpty && node(root).mark != epoch_) {
+                node(root).mark = epoch_;
+                pending.push_back(root);
+            }
+        }
+        while (!pending.empty()) {
+            const Handle at = pending.back();
+            pending.pop_back();
+            for (Handle below : pop(at)) {
+                if (below != kEmpty && node(below).mark != epoch_) {
+                    node(below).mark = epoch_;
+                    pending.push_back(below);
+                }
+            }
+        }
+
+        nextLevel();
+        std::vector<char> isFree(allocatedNodes_, 0);
+        for (Handle handle : freeNodes_) {
+            isFree[handle] = 1;
+        }
+        for (size_t handle = 0; handle < allocatedNodes_; ++handle) {
+            Node& dead = node(static_cast<Handle>(handle));
+            if (!isFree[handle] && dead.mark != epoch_) {
+                freeNodes_.push_back(static_cast<Handle>(handle));
+                for (int32_t at = dead.edges; at != kNone; at = edge(at).next) {
+                    freeEdges_.push_back(at);
+                }
+            }
+        }
+        collectedAt_ = liveNodes();
+    }
+
+    // True once the arena holds at least twice as many nodes as survived the last collection
+    bool wantsCollection() const {
+        return liveNodes() > 2 * collectedAt_ + kBlockSize;
+    }
+
+    // Drops every stack but keeps the arena blocks for reuse
+    void clear() {
+        nextLevel();
+        freeNodes_.clear();
+        freeEdges_.clear();
+        allocatedNodes_ = 0;
+        allocatedEdges_ = 0;
+        collectedAt_ = 0;
+        peakLive_ = 0;
+    }
+
+    size_t liveNodes() const {
+        return allocatedNodes_ - freeNodes_.size();
+    }
+
+    size_t liveEdges() const {
+        return allocatedEdges_ - freeEdges_.size();
+    }
+
+    size_t peakLiveNodes() const {
+        return peakLive_;
+    }
+
+    // Bytes reserved by the node and edge blocks, the free lists and the merging tables
+    size_t arenaBytes() const {
+        return nodeBlocks_.size() * kBlockSize * sizeof(Node) + edgeBlocks_.size() * kBlockSize * sizeof(Edge) +
+               (freeNodes_.capacity() + freeEdges_.capacity() + nodeSlots_.capacity()) * sizeof(Handle) +
+               edgeSlots_.capacity() * sizeof(int32_t) +
+               (usedNodeSlots_.capacity() + usedEdgeSlots_.capacity()) * sizeof(size_t);
+    }
+
+private:
+    struct Node {
+        int32_t symbol;
+        int32_t state;
+        uint32_t depth;
+        int32_t edges;   // first predecessor edge, kNone for none
+        uint32_t mark;
+    };
+
+    // One predecessor of a node, in a list per node
+    struct Edge {
+        Handle from;
+        Handle below;
+        int32_t next;
+    };
+
+    static constexpr size_t kBlockSize = 4096;
+    static constexpr int32_t kNone = -1;
+
+    std::vector<std::unique_ptr<Node[]>> nodeBlocks_;
+    std::vector<std::unique_ptr<Edge[]>> edgeBlocks_;
+    std::vector<Handle> freeNodes_;
+    std::vector<int32_t> freeEdges_;
+    std::vector<Handle> nodeSlots_;  // open addressing table of the nodes of this level, kEmpty if unused
+    std::vector<int32_t> edgeSlots_; // same for the edges added in this level, kNone if unused
+    std::vector<size_t> usedNodeSlots_;  // slots filled in this level, so it is closed without a sweep
+    std::vector<size_t> usedEdgeSlots_;
+    size_t allocatedNodes_ = 0;
+    size_t allocatedEdges_ = 0;
+    size_t collectedAt_ = 0;
+    size_t peakLive_ = 0;
+    uint32_t epoch_ = 0;
+
+    Node& node(Handle handle) {
+        return nodeBlocks_[handle / kBlockSize][handle % kBlockSize];
+    }
+
+    const Node& node(Handle handle) const {
+        return nodeBlocks_[handle / kBlockSize][handle % kBlockSize];
+    }
+
+    Edge& edge(int32_t index) {
+        return edgeBlocks_[index / kBlockSize][index % kBlockSize];
+    }
+
+    const Edge& edge(int32_t index) const {
+        return edgeBlocks_[index / kBlockSize][index % kBlockSize];
+    }
+
+    Handle allocateNode() {
+        Handle handle;
+        if (!freeNodes_.empty()) {
+            handle = freeNodes_.back();
+            freeNodes_.pop_back();
+        } else {
+            if (allocatedNodes_ % kBlockSize == 0) {
+                nodeBlocks_.push_back(std::make_unique<Node[]>(kBlockSize));
+            }
+            handle = static_cast<Handle>(allocatedNodes_++);
+        }
+        peakLive_ = liveNodes() > peakLive_ ? liveNodes() : peakLive_;
+        return handle;
+    }
+
+    int32_t allocateEdge() {
+        if (!freeEdges_.empty()) {
+            const int32_t index = freeEdges_.back();
+            freeEdges_.pop_back();
+            return index;
+        }
+        if (allocatedEdges_ % kBlockSize == 0) {
+            edgeBlocks_.push_back(std::make_unique<Edge[]>(kBlockSize));
+        }
+        return static_cast<int32_t>(allocatedEdges_++);
+    }
+
+    // Adds `below` to the predecessors of `from`, false if it is one already. Only nodes of the
+    // current level get edges, so the table of this level's edges finds every duplicate.
+    bool link(Handle from, Handle below) {
+        if (edgeSlots_.empty() || (usedEdgeSlots_.size() + 1) * 2 > edgeSlots_.size()) {
+            rehashEdges(edgeSlots_.empty() ? 1024 : edgeSlots_.size() * 2);
+        }
+        const size_t slot = findEdge(from, below);
+        if (edgeSlots_[slot] != kNone) {
+            return false;
+        }
+        const int32_t index = allocateEdge();
+        Edge& created = edge(index);
+        created.from = from;
+        created.below = below;
+        created.next = node(from).edges;
+        node(from).edges = index;
+        edgeSlots_[slot] = index;
+        usedEdgeSlots_.push_back(slot);
+        return true;
+    }
+
+    static size_t mix(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+
+    // Slot holding the node (symbol, state, depth) of this level, or the empty slot where it belongs
+    size_t findNode(int32_t symbol, int32_t state, uint32_t depth) const {
+        const size_t mask = nodeSlots_.size() - 1;
+        size_t slot = mix(((static_cast<uint64_t>(static_cast<uint32_t>(symbol)) << 32) | static_cast<uint32_t>(state)) ^
+                          (static_cast<uint64_t>(depth) * 0x9E3779B97F4A7C15ULL)) & mask;
+        while (nodeSlots_[slot] != kEmpty) {
+            const Node& candidate = node(nodeSlots_[slot]);
+            if (candidate.symbol == symbol && candidate.state == state && candidate.depth == depth) {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    size_t findEdge(Handle from, Handle below) const {
+        const size_t mask = edgeSlots_.size() - 1;
+        size_t slot = mix((static_cast<uint64_t>(static_cast<uint32_t>(from)) << 32) | static_cast<uint32_t>(below)) & mask;
+        while (edgeSlots_[slot] != kNone) {
+            const Edge& candidate = edge(edgeSlots_[slot]);
+            if (candidate.from == from && candidate.below == below) {
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    // Grows the tables of this level; size must be a power of two
+    void rehashNodes(size_t size) {
+        std::vector<Handle> old;
+        old.swap(nodeSlots_);
+        nodeSlots_.assign(size, kEmpty);
+        usedNodeSlots_.clear();
+        for (Handle handle : old) {
+            if (handle != kEmpty) {
+                const Node& live = node(handle);
+                const size_t slot = findNode(live.symbol, live.state, live.depth);
+                nodeSlots_[slot] = handle;
+                usedNodeSlots_.push_back(slot);
+            }
+        }
+    }
+
+    void rehashEdges(size_t size) {
+        std::vector<int32_t> old;
+        old.swap(edgeSlots_);
+        edgeSlots_.assign(size, kNone);
+        usedEdgeSlots_.clear();
+        for (int32_t index : old) {
+            if (index != kNone) {
+                const size_t slot = findEdge(edge(index).from, edge(index).below);
+                edgeSlots_[slot] = index;
+                usedEdgeSlots_.push_back(slot);
+            }
+        }
+    }
+};
+
+#endif
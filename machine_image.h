@@ -0,0 +1,291 @@
+#ifndef MACHINE_IMAGE_H
+#define MACHINE_IMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "definition_file.h"
+
+// Read-only view of an array, either owned by a vector or mapped straight from an image file
+template <typename T>
+class ArrayView {
+public:
+    ArrayView() = default;
+    ArrayView(const T* data, size_t size) : data_(data), size_(size) {}
+    ArrayView(const std::vector<T>& vector) : data_(vector.data()), size_(vector.size()) {}
+
+    const T& operator[](size_t i) const {
+        return data_[i];
+    }
+
+    const T* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+private:
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Names stored back to back: name i is bytes[offsets[i], offsets[i + 1])
+class StringTable {
+public:
+    StringTable() = default;
+    StringTable(ArrayView<uint32_t> offsets, ArrayView<char> bytes) : offsets_(offsets), bytes_(bytes) {}
+
+    std::string_view operator[](size_t i) const {
+        return std::string_view(bytes_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]);
+    }
+
+    size_t size() const {
+        return offsets_.empty() ? 0 : offsets_.size() - 1;
+    }
+
+    ArrayView<uint32_t> offsets() const {
+        return offsets_;
+    }
+
+    ArrayView<char> bytes() const {
+        return bytes_;
+    }
+
+    // True if every offset lies inside the bytes and the offsets never decrease
+    bool isConsistent() const {
+        if (offsets_.empty() || offsets_[0] != 0 || offsets_[offsets_.size() - 1] != bytes_.size()) {
+            return false;
+        }
+        for (size_t i = 1; i < offsets_.size(); ++i) {
+            if (offsets_[i] < offsets_[i - 1]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    ArrayView<uint32_t> offsets_;
+    ArrayView<char> bytes_;
+};
+
+// Builds a StringTable when the names come from a text definition
+class PackedStrings {
+public:
+    void clear() {
+        offsets_.assign(1, 0);
+        bytes_.clear();
+    }
+
+    void add(std::string_view name) {
+        bytes_.insert(bytes_.end(), name.begin(), name.end());
+        offsets_.push_back(static_cast<uint32_t>(bytes_.size()));
+    }
+
+    StringTable view() const {
+        return StringTable(offsets_, bytes_);
+    }
+
+private:
+    std::vector<uint32_t> offsets_{0};
+    std::vector<char> bytes_;
+};
+
+/**
+  Versioned binary image of a compiled machine.
+
+  An image is a header, a table of sections and the sections themselves, each one a plain array
+  starting on an 8-byte boundary. The loaders map the file and point their tables straight at
+  the sections, so starting from an image does no parsing and no allocation proportional to the
+  machine; the rules are only range-checked, in one pass over the tables. The header carries a
+  checksum of everything after it, which a crafted file can match, so the range checks are what
+  keep the tables from indexing out of bounds; a file that fails any check is refused as a whole.
+
+  Arrays are stored in the byte order of the machine that wrote them, and the header records it,
+  so an image is only loaded where it was built.
+ */
+class MachineImage {
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kTuringMachine = 1;
+    static constexpr uint32_t kPushdownAutomaton = 2;
+
+    static bool isImage(std::string_view contents) {
+        return contents.size() >= sizeof(kMagic) && std::memcmp(contents.data(), kMagic, sizeof(kMagic)) == 0;
+    }
+
+    // Maps the image and checks its header, sections and checksum; `error` says why it was refused
+    bool open(const std::string& path, uint32_t kind, std::string& error) {
+        if (!file_.open(path)) {
+            error = "cannot open file";
+            return false;
+        }
+        std::string_view contents = file_.contents();
+        if (contents.size() < sizeof(Header) || !isImage(contents)) {
+            error = "not a machine image";
+            return false;
+        }
+        std::memcpy(&header_, contents.data(), sizeof(Header));
+        if (header_.byteOrder != kByteOrder) {
+            error = "image was written on a machine with a different byte order";
+            return false;
+        }
+        if (header_.version != kVersion) {
+            error = "unsupported image version " + std::to_string(header_.version);
+            return false;
+        }
+        if (header_.kind != kind) {
+            error = "image holds a different kind of machine";
+            return false;
+        }
+        const uint64_t tableEnd = sizeof(Header) + static_cast<uint64_t>(header_.sectionCount) * sizeof(Section);
+        if (tableEnd > contents.size()) {
+            error = "truncated image";
+            return false;
+        }
+        if (checksum(contents.substr(sizeof(Header))) != header_.checksum) {
+            error = "checksum mismatch";
+            return false;
+        }
+        sections_ = reinterpret_cast<const Section*>(contents.data() + sizeof(Header));
+        for (uint32_t i = 0; i < header_.sectionCount; ++i) {
+            const Section& section = sections_[i];
+            if (section.offset % 8 != 0 || section.offset < tableEnd || section.offset > contents.size() ||
+                section.size > contents.size() - section.offset) {
+                error = "corrupt section table";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Section `id` as an array of T; an empty view if it is missing or its size is not a multiple of T
+    template <typename T>
+    ArrayView<T> array(uint32_t id) const {
+        static_assert(std::is_trivially_copyable<T>::value, "image sections hold plain data only");
+        for (uint32_t i = 0; i < header_.sectionCount; ++i) {
+            if (sections_[i].id == id && sections_[i].size % sizeof(T) == 0) {
+                return ArrayView<T>(reinterpret_cast<const T*>(file_.contents().data() + sections_[i].offset),
+                                    static_cast<size_t>(sections_[i].size / sizeof(T)));
+            }
+        }
+        return ArrayView<T>();
+    }
+
+    size_t size() const {
+        return file_.size();
+    }
+
+    // FNV-1a over 8-byte words, then over the trailing bytes
+    static uint64_t checksum(std::string_view bytes) {
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        size_t at = 0;
+        for (; at + 8 <= bytes.size(); at += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes.data() + at, 8);
+            hash = (hash ^ word) * 0x100000001B3ULL;
+        }
+        for (; at < bytes.size(); ++at) {
+            hash = (hash ^ static_cast<unsigned char>(bytes[at])) * 0x100000001B3ULL;
+        }
+        return hash;
+    }
+
+private:
+    friend class ImageWriter;
+
+    static constexpr char kMagic[8] = {'L', 'F', 'A', 'I', 'M', 'A', 'G', 'E'};
+    static constexpr uint32_t kByteOrder = 0x01020304;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t kind;
+        uint32_t byteOrder;
+        uint32_t sectionCount;
+        uint64_t checksum;
+    };
+
+    struct Section {
+        uint32_t id;
+        uint32_t reserved;
+        uint64_t offset;  // from the start of the file
+        uint64_t size;    // in bytes
+    };
+
+    MappedFile file_;
+    Header header_{};
+    const Section* sections_ = nullptr;
+};
+
+// Collects the sections of an image and writes them out with their header and checksum
+class ImageWriter {
+public:
+    explicit ImageWriter(uint32_t kind) : kind_(kind) {}
+
+    template <typename T>
+    void add(uint32_t id, ArrayView<T> data) {
+        static_assert(std::is_trivially_copyable<T>::value, "image sections hold plain data only");
+        const char* bytes = reinterpret_cast<const char*>(data.data());
+        sections_.push_back(std::make_pair(id, std::string(bytes, bytes + data.size() * sizeof(T))));
+    }
+
+    // Adds a string table as two sections, the offsets and the bytes
+    void add(uint32_t offsetsId, uint32_t bytesId, const StringTable& strings) {
+        add(offsetsId, strings.offsets());
+        add(bytesId, strings.bytes());
+    }
+
+    bool write(const std::string& path) const {
+        using Header = MachineImage::Header;
+        using Section = MachineImage::Section;
+
+        std::string image(sizeof(Header) + sections_.size() * sizeof(Section), '\0');
+        for (size_t i = 0; i < sections_.size(); ++i) {
+            image.resize((image.size() + 7) / 8 * 8, '\0');
+            Section section{sections_[i].first, 0, image.size(), sections_[i].second.size()};
+            std::memcpy(&image[sizeof(Header) + i * sizeof(Section)], &section, sizeof(Section));
+            image += sections_[i].second;
+        }
+
+        Header header{};
+        std::memcpy(header.magic, MachineImage::kMagic, sizeof(header.magic));
+        header.version = MachineImage::kVersion;
+        header.kind = kind_;
+        header.byteOrder = MachineImage::kByteOrder;
+        header.sectionCount = static_cast<uint32_t>(sections_.size());
+        header.checksum = MachineImage::checksum(std::string_view(image).substr(sizeof(Header)));
+        std::memcpy(&image[0], &header, sizeof(Header));
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(image.data(), static_cast<std::streamsize>(image.size()));
+        return static_cast<bool>(out);
+    }
+
+private:
+    uint32_t kind_;
+    std::vector<std::pair<uint32_t, std::string>> sections_;
+};
+
+#endif
@@ -0,0 +1,1735 @@
+#ifndef PDA_H
+#define PDA_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "context_free_grammar.h"
+#include "definition_file.h"
+#include "graph_structured_stack.h"
+#include "machine_image.h"
+#include "run_profile.h"
+#include "trace_sink.h"
+#include "work_stealing_pool.h"
+
+/**
+  PushdownAutomaton class for parsing and executing PDA operations
+  
+  Input file must follow this model:
+  [states]
+  state_1 value
+  state_2 value 
+  ( value refers to S for start_state, F for final_state or anything else for intermediary states usually 0) 
+  there can only be one start state, but if there are more than one state signaled with S, the last one will be considered the start state; 
+  there can only be one final state, but if there are more than one state signaled with F, the last one will be considered the final state;
+  
+  [sigma]
+  letter_1
+  letter_2
+
+  [rules]
+  state_1 input_value pop_value push_value state_2 (first rule must have the start state on the first state position)
+  state_3 input_value pop_value push_value state_4
+
+  After loading, states and symbols are interned into integers and the rules are bucketed by
+  (state, input symbol), with epsilon rules in a bucket of their own, so a step only looks at
+  the rules that can apply. Inside a bucket the rules keep their order from the file.
+
+  By default the automaton runs greedily: it takes the first rule that applies and never
+  backtracks. The nondeterministic mode instead explores every configuration breadth-first,
+  so it accepts whenever some sequence of choices reaches a final state.
+
+  For membership queries the automaton can also be converted into an equivalent context-free
+  grammar (see buildGrammar()) and the input recognized by CYK on the Chomsky Normal Form of
+  the grammar or by Earley on the grammar itself. Both decide exactly whether some run reads the
+  whole input and ends in a final state, with no bound on the stack.
+
+ */
+class PushdownAutomaton {
+public:
+    // Outcome of running the automaton on one input
+    struct RunResult {
+        bool accepted = false;
+        bool stuck = false;       // no transition for the input symbol at `position`
+        size_t position = 0;      // number of input symbols consumed
+        std::string state;        // state the automaton ended in
+        size_t steps = 0;         // transitions applied (configurations explored when nondeterministic)
+        size_t maxStackDepth = 0;
+        bool invalid = false;     // streaming runs: the symbol at `position` is not in sigma
+        std::string symbol;       // streaming runs: the symbol the run stopped on
+    };
+    
+    // How membership is decided: by running the automaton or by parsing with its grammar
+    enum class Recognizer {
+        Automaton,
+        Cyk,
+        Earley
+    };
+    
+    // One traced transition: the state it led to and how it changed the stack
+    struct TraceRecord {
+        int32_t state;
+        int32_t popped;           // kEpsilon if nothing was popped
+        int32_t pushed;           // kEpsilon if nothing was pushed
+    };
+    
+    static constexpr int32_t kEpsilon = -1;
+    
+    // Rule with states and symbols interned; kEpsilon stands for "e"
+    struct CompiledRule {
+        int32_t from;
+        int32_t input;
+        int32_t pop;
+        int32_t push;
+        int32_t to;
+    };
+    
+    // A configuration of the nondeterministic search at a fixed input position
+    struct Configuration {
+        int32_t state;
+        GraphStructuredStack::Handle stack;  // top of the stack, kEmpty for the empty stack
+        
+        bool operator==(const Configuration& other) const {
+            return state == other.state && stack == other.stack;
+        }
+    };
+    
+    struct ConfigurationHash {
+        size_t operator()(const Configuration& configuration) const {
+            return std::hash<uint64_t>()((static_cast<uint64_t>(configuration.state) << 32) ^ static_cast<uint32_t>(configuration.stack));
+        }
+    };
+    
+    // Memory of the breadth-first search, reused between inputs
+    struct SearchScratch {
+        GraphStructuredStack stacks;
+        std::vector<Configuration> frontier;
+        std::vector<Configuration> next;
+        std::unordered_set<Configuration, ConfigurationHash> visited;
+        std::unordered_map<GraphStructuredStack::Handle, std::vector<uint32_t>> pops;  // epsilon rules popped through a node, this level
+        std::vector<std::pair<GraphStructuredStack::Handle, GraphStructuredStack::Handle>> newEdges;  // (node, predecessor) to replay
+    };
+    
+private:
+    static constexpr int32_t kNotInSigma = -2;
+    
+    // A line of the [rules] section with its tokens interned
+    struct RuleLine {
+        int32_t parts[5];
+        uint32_t count;           // tokens on the line; only lines of exactly 5 are valid rules
+    };
+    
+    // Definition as loaded, every token interned into `names` while the file is parsed
+    NameTable names;
+    bool hasStates = false;
+    bool hasSigma = false;
+    bool hasRules = false;
+    std::vector<std::pair<int32_t, int32_t>> stateLines;  // state name and kind (S, F, ...), kMissing if none
+    std::vector<int32_t> sigmaLines;                     // sigma symbols without duplicates
+    std::vector<char> inSigmaLines;                      // indexed by name id
+    std::vector<RuleLine> ruleLines;                     // rules without duplicates, in file order
+    std::vector<uint32_t> ruleSlots;                     // open addressing set of indices into ruleLines
+    
+    // Compiled representation, built by compile() once the file is loaded or mapped from a
+    // binary image by loadImage()
+    std::vector<int32_t> stateOfName;                    // name id -> state id, -1 if not a state
+    std::vector<int32_t> symbolOfName;                   // name id -> symbol id, kEpsilon or kNotInSigma
+    StringTable stateNames;
+    StringTable symbolNames;                             // sigma without "e"
+    bool sigmaHasEpsilon = false;
+    ArrayView<uint8_t> finalStates;                      // indexed by state id
+    int32_t startState = -1;
+    ArrayView<CompiledRule> rules;                       // valid rules in file order
+    ArrayView<uint32_t> bucketStart;                     // offsets into bucketRules, see bucketOf()
+    ArrayView<uint32_t> bucketRules;                     // rule indices grouped by (state, input)
+    
+    // What the tables above view after compile()
+    struct CompiledTables {
+        PackedStrings stateNames;
+        PackedStrings symbolNames;
+        std::vector<uint8_t> finalStates;
+        std::vector<CompiledRule> rules;
+        std::vector<uint32_t> bucketStart;
+        std::vector<uint32_t> bucketRules;
+    };
+    CompiledTables compiled;
+    MachineImage image;
+    bool fromImage = false;
+    
+    // What happens on (state, input or e, stack top) when the automaton is deterministic
+    struct TableAction {
+        int32_t to;               // -1 if no rule applies
+        int32_t push;             // kEpsilon if nothing is pushed
+        uint8_t pops;             // 1 if the top is popped
+        uint8_t closes;           // 1 if `to` has epsilon rules, so a closure must follow
+    };
+    static constexpr size_t kMaxTableActions = size_t(1) << 22;
+    
+    // Set by proveDeterministic() at load time. The table, indexed by actionIndex(), is filled by
+    // actions() on the first run that uses it, so loads and the other engines never pay for it.
+    bool deterministic = false;
+    bool tableEnabled = true;
+    mutable std::vector<TableAction> actionTable;
+    mutable std::atomic<bool> tableBuilt{false};
+    mutable std::mutex tableMutex;
+    
+    // Sections of a binary image of the automaton
+    enum ImageSection : uint32_t {
+        kImageInfo = 1,
+        kImageStateOffsets,
+        kImageStateBytes,
+        kImageSymbolOffsets,
+        kImageSymbolBytes,
+        kImageFinalStates,
+        kImageRules,
+        kImageBucketStart,
+        kImageBucketRules
+    };
+    
+    struct ImageInfo {
+        uint32_t stateCount;
+        uint32_t symbolCount;
+        int32_t startState;
+        uint32_t sigmaHasEpsilon;
+    };
+    
+    bool nondeterministic = false;
+    size_t maxStackDepth = 0;
+    Recognizer recognizer = Recognizer::Automaton;
+    unsigned threads = 0;
+    ContextFreeGrammar grammar;
+    std::unique_ptr<ChomskyGrammar> chomsky;
+    std::unique_ptr<CykRecognizer> cyk;
+    std::unique_ptr<EarleyRecognizer> earley;
+    OutputLevel outputLevel = OutputLevel::Trace;
+    size_t traceCapacity = 1 << 16;
+    std::string profilePath;             // prefix of the profile reports, empty if not profiling
+    std::string streamPath;              // input streamed from this file ("-" for stdin), empty to prompt
+    
+    // Helper function to split a string into words
+    std::vector<std::string> splitString(const std::string& str) const {
+        std::vector<std::string> tokens;
+        std::istringstream iss(str);
+        std::string token;
+        
+        while (iss >> token) {
+            tokens.push_back(token);
+        }
+        
+        return tokens;
+    }
+
+    int32_t symbolId(std::string_view symbol) const {
+        int32_t name = names.find(symbol);
+        return name == NameTable::kMissing || static_cast<size_t>(name) >= symbolOfName.size() ? kNotInSigma
+                                                                                           : symbolOfName[name];
+    }
+    
+    bool inSigma(std::string_view symbol) const {
+        return symbolId(symbol) != kNotInSigma;
+    }
+    
+    static size_t hashOf(const RuleLine& rule) {
+        uint64_t hash = rule.count;
+        for (uint32_t i = 0; i < 5; ++i) {
+            hash = (hash ^ static_cast<uint32_t>(rule.parts[i])) * 0x100000001B3ULL;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 29));
+    }
+    
+    static bool sameRule(const RuleLine& a, const RuleLine& b) {
+        return a.count == b.count && std::equal(a.parts, a.parts + 5, b.parts);
+    }
+    
+    // Appends the rule unless the same line was already loaded; replaces the old linear scan
+    void addRuleLine(const RuleLine& rule) {
+        const uint32_t unused = UINT32_MAX;
+        if ((ruleLines.size() + 1) * 2 > ruleSlots.size()) {
+            ruleSlots.assign(ruleSlots.empty() ? 1024 : ruleSlots.size() * 2, unused);
+            for (size_t i = 0; i < ruleLines.size(); ++i) {
+                size_t slot = hashOf(ruleLines[i]) & (ruleSlots.size() - 1);
+                while (ruleSlots[slot] != unused) {
+                    slot = (slot + 1) & (ruleSlots.size() - 1);
+                }
+                ruleSlots[slot] = static_cast<uint32_t>(i);
+            }
+        }
+        size_t slot = hashOf(rule) & (ruleSlots.size() - 1);
+        while (ruleSlots[slot] != unused) {
+            if (sameRule(ruleLines[ruleSlots[slot]], rule)) {
+                return;
+            }
+            slot = (slot + 1) & (ruleSlots.size() - 1);
+        }
+        ruleSlots[slot] = static_cast<uint32_t>(ruleLines.size());
+        ruleLines.push_back(rule);
+    }
+    
+    size_t bucketOf(int32_t state, int32_t input) const {
+        return static_cast<size_t>(state) * (symbolNames.size() + 1) + static_cast<size_t>(input + 1);
+    }
+    
+    // Whether the rules and buckets of a loaded image only name states, symbols and rules that
+    // exist, and every bucket holds the rules of its own (state, input); one pass over both
+    bool tablesInRange() const {
+        const int32_t states = static_cast<int32_t>(stateNames.size());
+        const int32_t symbols = static_cast<int32_t>(symbolNames.size());
+        for (const CompiledRule& rule : rules) {
+            if (rule.from < 0 || rule.from >= states || rule.to < 0 || rule.to >= states ||
+                rule.input < kEpsilon || rule.input >= symbols || rule.pop < kEpsilon || rule.pop >= symbols ||
+                rule.push < kEpsilon || rule.push >= symbols) {
+                return false;
+            }
+        }
+        if (bucketStart[0] != 0) {
+            return false;
+        }
+        for (size_t bucket = 0; bucket + 1 < bucketStart.size(); ++bucket) {
+            if (bucketStart[bucket + 1] < bucketStart[bucket]) {
+                return false;
+            }
+            for (uint32_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i) {
+                if (bucketRules[i] >= rules.size() ||
+                    bucketOf(rules[bucketRules[i]].from, rules[bucketRules[i]].input) != bucket) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    
+    // Numbers states and symbols and buckets the valid rules by (state, input)
+    void compile() {
+        stateOfName.assign(names.size(), -1);
+        symbolOfName.assign(names.size(), kNotInSigma);
+        compiled = CompiledTables();
+        sigmaHasEpsilon = false;
+        startState = -1;
+        
+        int32_t stateCount = 0;
+        for (const auto& state : stateLines) {
+            int32_t& id = stateOfName[state.first];
+            if (id < 0) {
+                id = stateCount++;
+                compiled.stateNames.add(names.name(state.first));
+                compiled.finalStates.push_back(0);
+            }
+            if (state.second != NameTable::kMissing && names.name(state.second) == "S") {
+                startState = id;
+            }
+            else if (state.second != NameTable::kMissing && names.name(state.second) == "F") {
+                compiled.finalStates[id] = 1;
+            }
+        }
+        int32_t symbolCount = 0;
+        for (int32_t symbol : sigmaLines) {
+            if (names.name(symbol) == "e") {
+                sigmaHasEpsilon = true;
+                symbolOfName[symbol] = kEpsilon;
+            }
+            else {
+                symbolOfName[symbol] = symbolCount++;
+                compiled.symbolNames.add(names.name(symbol));
+            }
+        }
+        stateNames = compiled.stateNames.view();
+        symbolNames = compiled.symbolNames.view();
+        for (const auto& rule : ruleLines) {
+            if (isValidRule(rule)) {
+                compiled.rules.push_back(CompiledRule{stateOfName[rule.parts[0]], symbolOfName[rule.parts[1]], symbolOfName[rule.parts[2]],
+                                                      symbolOfName[rule.parts[3]], stateOfName[rule.parts[4]]});
+            }
+        }
+        
+        // Counting sort of the rules by bucket keeps the file order inside every bucket
+        std::vector<uint32_t>& starts = compiled.bucketStart;
+        starts.assign(stateNames.size() * (symbolNames.size() + 1) + 1, 0);
+        for (const CompiledRule& rule : compiled.rules) {
+            starts[bucketOf(rule.from, rule.input) + 1]++;
+        }
+        for (size_t i = 1; i < starts.size(); ++i) {
+            starts[i] += starts[i - 1];
+        }
+        compiled.bucketRules.assign(compiled.rules.size(), 0);
+        std::vector<uint32_t> fill(starts.begin(), starts.end() - 1);
+        for (size_t i = 0; i < compiled.rules.size(); ++i) {
+            compiled.bucketRules[fill[bucketOf(compiled.rules[i].from, compiled.rules[i].input)]++] = static_cast<uint32_t>(i);
+        }
+        
+        finalStates = compiled.finalStates;
+        rules = compiled.rules;
+        bucketStart = compiled.bucketStart;
+        bucketRules = compiled.bucketRules;
+        proveDeterministic();
+    }
+    
+    size_t actionIndex(int32_t state, int32_t input, int32_t top) const {
+        const size_t width = symbolNames.size() + 1;
+        return (static_cast<size_t>(state) * width + static_cast<size_t>(input + 1)) * width + static_cast<size_t>(top + 1);
+    }
+    
+    // Proves the automaton deterministic: at most one rule applies to each (state, input or e, stack
+    // top; none for the empty stack). An input rule on a state and top that also have an epsilon
+    // rule conflicts with nothing, since execute() closes the e moves before reading and so never
+    // takes it. The first applicable rule is then the only one, and executeTable() follows the run
+    // of execute() by direct lookups. Two rules of a bucket share a top only if they pop the same
+    // symbol or one pops nothing, so each bucket is checked in one pass with a stamp per top.
+    void proveDeterministic() {
+        deterministic = false;
+        actionTable.clear();
+        actionTable.shrink_to_fit();
+        tableBuilt.store(false);
+        const int32_t symbols = static_cast<int32_t>(symbolNames.size());
+        std::vector<uint32_t> shadowed(symbolNames.size(), 0);  // popped by an epsilon rule of the state
+        std::vector<uint32_t> taken(symbolNames.size(), 0);     // popped by a rule of the bucket
+        uint32_t stamp = 0;
+        for (int32_t state = 0; state < static_cast<int32_t>(stateNames.size()); ++state) {
+            const uint32_t stateStamp = ++stamp;
+            bool epsilonOnAnyTop = false;
+            bool epsilonOnSomeTop = false;
+            const size_t epsilonBucket = bucketOf(state, kEpsilon);
+            for (uint32_t i = bucketStart[epsilonBucket]; i < bucketStart[epsilonBucket + 1]; ++i) {
+                const CompiledRule& rule = rules[bucketRules[i]];
+                if (rule.pop == kEpsilon) {
+                    if (epsilonOnAnyTop || epsilonOnSomeTop) {
+                        return;
+                    }
+                    epsilonOnAnyTop = true;
+                } else {
+                    if (epsilonOnAnyTop || shadowed[rule.pop] == stateStamp) {
+                        return;
+                    }
+                    shadowed[rule.pop] = stateStamp;
+                    epsilonOnSomeTop = true;
+                }
+            }
+            if (epsilonOnAnyTop) {
+                continue;  // no input rule of the state is ever taken
+            }
+            
+            for (int32_t input = 0; input < symbols; ++input) {
+                const uint32_t bucketStamp = ++stamp;
+                bool onAnyTop = false;
+                bool onSomeTop = false;
+                const size_t bucket = bucketOf(state, input);
+                for (uint32_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i) {
+                    const CompiledRule& rule = rules[bucketRules[i]];
+                    if (rule.pop == kEpsilon) {
+                        // It applies on the empty stack, which no epsilon rule of the state pops
+                        if (onAnyTop || onSomeTop) {
+                            return;
+                        }
+                        onAnyTop = true;
+                    } else if (shadowed[rule.pop] != stateStamp) {
+                        if (onAnyTop || taken[rule.pop] == bucketStamp) {
+                            return;
+                        }
+                        taken[rule.pop] = bucketStamp;
+                        onSomeTop = true;
+                    }
+                }
+            }
+        }
+        deterministic = true;
+    }
+    
+    // The action table of a deterministic automaton, filled on first use; callers check usesTable()
+    const TableAction* actions() const {
+        if (!tableBuilt.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(tableMutex);
+            if (!tableBuilt.load(std::memory_order_relaxed)) {
+                fillActionTable();
+                tableBuilt.store(true, std::memory_order_release);
+            }
+        }
+        return actionTable.data();
+    }
+    
+    // Tabulates the only move of every (state, input or e, top); input columns where an epsilon
+    // rule applies stay empty, as the closure always takes that rule first
+    void fillActionTable() const {
+        const int32_t symbols = static_cast<int32_t>(symbolNames.size());
+        const size_t width = symbolNames.size() + 1;
+        std::vector<uint8_t> hasEpsilon(stateNames.size(), 0);
+        for (size_t state = 0; state < stateNames.size(); ++state) {
+            const size_t bucket = bucketOf(static_cast<int32_t>(state), kEpsilon);
+            hasEpsilon[state] = bucketStart[bucket] != bucketStart[bucket + 1];
+        }
+        
+        actionTable.assign(stateNames.size() * width * width, TableAction{-1, kEpsilon, 0, 0});
+        for (int32_t state = 0; state < static_cast<int32_t>(stateNames.size()); ++state) {
+            // Epsilon first, so the input columns can skip the tops it takes
+            for (int32_t input = kEpsilon; input < symbols; ++input) {
+                const size_t bucket = bucketOf(state, input);
+                for (uint32_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i) {
+                    const CompiledRule& rule = rules[bucketRules[i]];
+                    const int32_t first = rule.pop == kEpsilon ? -1 : rule.pop;
+                    const int32_t last = rule.pop == kEpsilon ? symbols - 1 : rule.pop;
+                    for (int32_t top = first; top <= last; ++top) {
+                        if (input != kEpsilon && actionTable[actionIndex(state, kEpsilon, top)].to >= 0) {
+                            continue;
+                        }
+                        actionTable[actionIndex(state, input, top)] =
+                            TableAction{rule.to, rule.push, static_cast<uint8_t>(rule.pop != kEpsilon), hasEpsilon[rule.to]};
+                    }
+                }
+            }
+        }
+    }
+    
+public:
+    // Function for loading automaton, checks for commentaries or empty lines. The file is mapped
+    // and tokenized in place; tokens are interned and duplicate lines dropped by hashing.
+    bool loadAutomaton(const std::string& filename) {
+        auto started = std::chrono::steady_clock::now();
+        MappedFile file;
+        
+        if (!file.open(filename)) {
+            std::cerr << "Failed to open file: " << filename << std::endl;
+            return false;
+        }
+        if (MachineImage::isImage(file.contents())) {
+            file.close();
+            return loadImage(filename);
+        }
+        
+        DefinitionScanner scanner(file.contents());
+        std::string_view line;
+        std::string_view currentSection;
+        std::string_view parts[5];
+        
+        while (scanner.next(line)) {
+            // Check if this is a section header; a repeated header starts the section over
+            std::string_view section;
+            if (DefinitionScanner::isSection(line, section)) {
+                currentSection = section;
+                if (section == "states") {
+                    hasStates = true;
+                    stateLines.clear();
+                }
+                else if (section == "sigma") {
+                    hasSigma = true;
+                    sigmaLines.clear();
+                    inSigmaLines.clear();
+                }
+                else if (section == "rules") {
+                    hasRules = true;
+                    ruleLines.clear();
+                    ruleSlots.clear();
+                }
+            } 
+            else if (currentSection == "sigma") {
+                size_t symbol = static_cast<size_t>(names.intern(line));
+                if (inSigmaLines.size() <= symbol) {
+                    inSigmaLines.resize(symbol + 1, 0);
+                }
+                if (!inSigmaLines[symbol]) {
+                    inSigmaLines[symbol] = 1;
+                    sigmaLines.push_back(static_cast<int32_t>(symbol));
+                }
+            }
+            else if (currentSection == "states") {
+                size_t count = splitTokens(line, parts, 2);
+                stateLines.emplace_back(names.intern(parts[0]), count > 1 ? names.intern(parts[1]) : NameTable::kMissing);
+            }
+            else if (currentSection == "rules") {
+                RuleLine rule{{-1, -1, -1, -1, -1}, static_cast<uint32_t>(splitTokens(line, parts, 5))};
+                for (uint32_t i = 0; i < rule.count && i < 5; ++i) {
+                    rule.parts[i] = names.intern(parts[i]);
+                }
+                addRuleLine(rule);
+            }
+        }
+        
+        if (outputLevel == OutputLevel::Summary) {
+            auto finished = std::chrono::steady_clock::now();
+            reportLoad(filename, file.size(), std::chrono::duration<double>(finished - started).count());
+        }
+        if (isValidAutomaton()) {
+            compile();
+        }
+        return true;
+    }
+    
+    // Maps a binary image written by emitImage(); the automaton then runs on the mapped tables
+    bool loadImage(const std::string& filename) {
+        auto started = std::chrono::steady_clock::now();
+        std::string error;
+        if (!image.open(filename, MachineImage::kPushdownAutomaton, error)) {
+            std::cerr << "Invalid automaton image " << filename << ": " << error << std::endl;
+            return false;
+        }
+        
+        ArrayView<ImageInfo> info = image.array<ImageInfo>(kImageInfo);
+        stateNames = StringTable(image.array<uint32_t>(kImageStateOffsets), image.array<char>(kImageStateBytes));
+        symbolNames = StringTable(image.array<uint32_t>(kImageSymbolOffsets), image.array<char>(kImageSymbolBytes));
+        finalStates = image.array<uint8_t>(kImageFinalStates);
+        rules = image.array<CompiledRule>(kImageRules);
+        bucketStart = image.array<uint32_t>(kImageBucketStart);
+        bucketRules = image.array<uint32_t>(kImageBucketRules);
+        if (info.size() != 1 || stateNames.size() != info[0].stateCount || symbolNames.size() != info[0].symbolCount ||
+            !stateNames.isConsistent() || !symbolNames.isConsistent() || finalStates.size() != stateNames.size() ||
+            info[0].startState < 0 || static_cast<size_t>(info[0].startState) >= stateNames.size() ||
+            bucketStart.size() != stateNames.size() * (symbolNames.size() + 1) + 1 ||
+            bucketRules.size() != rules.size() || bucketStart[bucketStart.size() - 1] != rules.size() || !tablesInRange()) {
+            std::cerr << "Invalid automaton image " << filename << ": inconsistent tables" << std::endl;
+            return false;
+        }
+        startState = info[0].startState;
+        sigmaHasEpsilon = info[0].sigmaHasEpsilon != 0;
+        
+        // Inputs are still read as text, so the few symbol names are interned again
+        for (size_t symbol = 0; symbol < symbolNames.size(); ++symbol) {
+            names.intern(symbolNames[symbol]);
+        }
+        int32_t epsilon = sigmaHasEpsilon ? names.intern("e") : NameTable::kMissing;
+        symbolOfName.assign(names.size(), kNotInSigma);
+        for (size_t symbol = 0; symbol < symbolNames.size(); ++symbol) {
+            symbolOfName[names.find(symbolNames[symbol])] = static_cast<int32_t>(symbol);
+        }
+        if (epsilon != NameTable::kMissing) {
+            symbolOfName[epsilon] = kEpsilon;
+        }
+        proveDeterministic();
+        fromImage = true;
+        
+        if (outputLevel == OutputLevel::Summary) {
+            auto finished = std::chrono::steady_clock::now();
+            reportLoad(filename, image.size(), std::chrono::duration<double>(finished - started).count());
+        }
+        return true;
+    }
+    
+    // Writes the compiled tables as a binary image that loads without parsing; call only on a valid automaton
+    bool emitImage(const std::string& path) const {
+        ImageInfo info{static_cast<uint32_t>(stateNames.size()), static_cast<uint32_t>(symbolNames.size()), startState,
+                       sigmaHasEpsilon ? 1u : 0u};
+        ImageWriter writer(MachineImage::kPushdownAutomaton);
+        writer.add(kImageInfo, ArrayView<ImageInfo>(&info, 1));
+        writer.add(kImageStateOffsets, kImageStateBytes, stateNames);
+        writer.add(kImageSymbolOffsets, kImageSymbolBytes, symbolNames);
+        writer.add(kImageFinalStates, finalStates);
+        writer.add(kImageRules, rules);
+        writer.add(kImageBucketStart, bucketStart);
+        writer.add(kImageBucketRules, bucketRules);
+        if (!writer.write(path)) {
+            std::cerr << "Failed to write file: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Function for checking valid automaton; an image was checked before it was written
+    bool isValidAutomaton() const {
+        return fromImage || (hasStates && hasSigma && hasRules);
+    }
+    
+    bool isValidRule(const RuleLine& rule) const {
+        // Rule should have 5 components
+        if (rule.count != 5) {
+            return false;
+        }
+        
+        // First and fifth components should be valid states
+        if (stateOfName[rule.parts[0]] < 0 || stateOfName[rule.parts[4]] < 0) {
+            return false;
+        }
+        
+        // Second, third, and fourth components should be valid sigma values
+        if (symbolOfName[rule.parts[1]] == kNotInSigma || symbolOfName[rule.parts[2]] == kNotInSigma ||
+            symbolOfName[rule.parts[3]] == kNotInSigma) {
+            return false;
+        }
+        
+        return true;
+    }
+    
+    // Function for checking all valid rules
+    bool allValidRules() const {
+        for (const auto& rule : ruleLines) {
+            if (!isValidRule(rule)) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    // Function for checking valid first rule, must have the start_state on the first state position
+    bool isValidFirstRule() const {
+        if (fromImage) {
+            return true;
+        }
+        if (ruleLines.empty() || startState < 0) {
+            return false;
+        }
+        
+        return names.name(ruleLines[0].parts[0]) == stateNames[startState];
+    }
+    
+    // Function for checking valid input
+    bool isValidInput(const std::vector<std::string>& input) const {
+        for (const auto& value : input) {
+            if (!inSigma(value)) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    // Interns a valid input; an input symbol "e" is matched against the epsilon rules, as before
+    void encodeInput(const std::vector<std::string>& input, std::vector<int32_t>& encoded) const {
+        encoded.clear();
+        for (const auto& value : input) {
+            encoded.push_back(symbolId(value));
+        }
+    }
+    
+    // Getter for a section of the automaton, rebuilt from the interned tokens
+    std::vector<std::vector<std::string>> getSection(const std::string& section) const {
+        std::vector<std::vector<std::string>> lines;
+        if (section == "states") {
+            for (const auto& state : stateLines) {
+                lines.push_back({names.name(state.first)});
+                if (state.second != NameTable::kMissing) {
+                    lines.back().push_back(names.name(state.second));
+                }
+            }
+        }
+        else if (section == "sigma") {
+            for (int32_t symbol : sigmaLines) {
+                lines.push_back({names.name(symbol)});
+            }
+        }
+        else if (section == "rules") {
+            for (const auto& rule : ruleLines) {
+                lines.emplace_back();
+                for (uint32_t i = 0; i < rule.count && i < 5; ++i) {
+                    lines.back().push_back(names.name(rule.parts[i]));
+                }
+            }
+        }
+        return lines;
+    }
+    
+    // Function to apply a rule given the current state, stack, and rule; records it in `trace` if given
+    bool applyRule(const CompiledRule& rule, int32_t& currState, std::vector<int32_t>& stack, TraceRing<TraceRecord>* trace = nullptr) const {
+        // For pop value "e", we don't need to pop anything
+        // For any other pop value, we need to check if it matches the top of the stack
+        if (rule.pop != kEpsilon) {
+            if (stack.empty() || stack.back() != rule.pop) {
+                return false;  // Can't apply this rule
+            }
+            // Pop the value
+            stack.pop_back();
+        }
+        
+        // Push value (if not "e")
+        if (rule.push != kEpsilon) {
+            stack.push_back(rule.push);
+        }
+        
+        // Update current state
+        currState = rule.to;
+        
+        if (trace) {
+            trace->push(TraceRecord{currState, rule.pop, rule.push});
+        }
+        
+        return true;
+    }
+    
+    // Prints the traced transitions as "state -> [stack]" lines. The stacks are rebuilt by undoing
+    // the records backwards from the final stack, so they are exact even if early records were dropped.
+    void dumpTrace(const TraceRing<TraceRecord>& trace, const std::vector<int32_t>& finalStack) const {
+        std::vector<int32_t> stack = finalStack;
+        for (size_t i = trace.size(); i-- > 0;) {
+            if (trace[i].pushed != kEpsilon) {
+                stack.pop_back();
+            }
+            if (trace[i].popped != kEpsilon) {
+                stack.push_back(trace[i].popped);
+            }
+        }
+        
+        if (trace.dropped() > 0) {
+            std::cout << "... " << trace.dropped() << " earlier transitions not kept" << std::endl;
+        }
+        else {
+            std::cout << stateNames[startState] << " -> ";
+        }
+        
+        std::string line;
+        for (size_t i = 0; i < trace.size(); ++i) {
+            if (trace[i].popped != kEpsilon) {
+                stack.pop_back();
+            }
+            if (trace[i].pushed != kEpsilon) {
+                stack.push_back(trace[i].pushed);
+            }
+            
+            // Print current state and stack
+            line = std::string(stateNames[trace[i].state]) + " -> [";
+            for (size_t j = 0; j < stack.size(); ++j) {
+                line += symbolNames[stack[j]];
+                if (j < stack.size() - 1) {
+                    line += ", ";
+                }
+            }
+            line += "]\n";
+            std::cout << line;
+        }
+        std::cout.flush();
+    }
+    
+    // Applies the first rule of the (state, input) bucket whose pop value matches the stack, raises
+    // `maxDepth` to the stack depth after it and counts it in `profile` (a NoProfile records nothing)
+    template <typename Profile>
+    bool applyFirstRule(int32_t input, int32_t& currState, std::vector<int32_t>& stack, size_t& maxDepth,
+                        TraceRing<TraceRecord>* trace, Profile& profile) const {
+        const size_t bucket = bucketOf(currState, input);
+        for (uint32_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i) {
+            if (applyRule(rules[bucketRules[i]], currState, stack, trace)) {
+                maxDepth = std::max(maxDepth, stack.size());
+                profile.fire(bucketRules[i]);
+                profile.depth(stack.size());
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // Helper to apply epsilon transitions, returns how many were applied
+    template <typename Profile>
+    size_t applyEpsilonTransitions(int32_t& currState, std::vector<int32_t>& stack, size_t& maxDepth,
+                                   TraceRing<TraceRecord>* trace, Profile& profile) const {
+        size_t applied = 0;
+        
+        // Keep taking the first applicable epsilon transition until none applies
+        while (applyFirstRule(kEpsilon, currState, stack, maxDepth, trace, profile)) {
+            applied++;
+        }
+        
+        return applied;
+    }
+    
+    // Runs the automaton on an encoded input; `stack` is scratch memory that is cleared first.
+    // Transitions are recorded in `trace` when one is given; untraced runs of a deterministic
+    // automaton take the table-driven executeTable() instead.
+    RunResult execute(const std::vector<int32_t>& inputString, std::vector<int32_t>& stack,
+                      TraceRing<TraceRecord>* trace = nullptr) const {
+        if (!trace && usesTable()) {
+            size_t next = 0;
+            auto source = [&](int32_t& symbol) {
+                if (next == inputString.size()) {
+                    return false;
+                }
+                symbol = inputString[next++];
+                return true;
+            };
+            return executeTable(source, stack);
+        }
+        NoProfile profile;
+        return execute(inputString, stack, trace, profile);
+    }
+    
+    // Same as above, also counting every applied rule and the stack depth after it in `profile`,
+    // which must come from newProfile()
+    RunResult execute(const std::vector<int32_t>& inputString, std::vector<int32_t>& stack, RunProfile& profile,
+                      TraceRing<TraceRecord>* trace = nullptr) const {
+        return execute(inputString, stack, trace, profile);
+    }
+    
+    // An empty profile with one counter per rule
+    RunProfile newProfile() const {
+        return RunProfile(rules.size());
+    }
+    
+    // Names the rules of the profile as they are written in the definition file
+    ProfileLabels profileLabels() const {
+        ProfileLabels labels;
+        labels.machine = "pda";
+        for (size_t state = 0; state < stateNames.size(); ++state) {
+            labels.states.emplace_back(stateNames[state]);
+        }
+        auto symbol = [this](int32_t id) {
+            return id == kEpsilon ? std::string("e") : std::string(symbolNames[id]);
+        };
+        for (const CompiledRule& rule : rules) {
+            labels.rules.push_back(std::string(stateNames[rule.from]) + " " + symbol(rule.input) + " " + symbol(rule.pop) +
+                                   " " + symbol(rule.push) + " " + std::string(stateNames[rule.to]));
+            labels.ruleStates.push_back(rule.from);
+        }
+        return labels;
+    }
+    
+    // The NoProfile instantiation is the plain interpreter, with no profiling code in it
+    template <typename Profile>
+    RunResult execute(const std::vector<int32_t>& inputString, std::vector<int32_t>& stack,
+                      TraceRing<TraceRecord>* trace, Profile& profile) const {
+        RunResult result;
+        int32_t currState = startState;
+        stack.clear();
+        
+        // Apply initial epsilon transitions before processing input
+        result.steps += applyEpsilonTransitions(currState, stack, result.maxStackDepth, trace, profile);
+        
+        // Iterating through input
+        for (size_t i = 0; i < inputString.size(); i++) {
+            if (!applyFirstRule(inputString[i], currState, stack, result.maxStackDepth, trace, profile)) {
+                result.stuck = true;
+                result.position = i;
+                result.state = stateNames[currState];
+                return result;
+            }
+            result.steps++;
+            
+            // Apply epsilon transitions after this input
+            result.steps += applyEpsilonTransitions(currState, stack, result.maxStackDepth, trace, profile);
+        }
+        
+        result.position = inputString.size();
+        result.state = stateNames[currState];
+        result.accepted = finalStates[currState] != 0;
+        return result;
+    }
+    
+    // Streaming run: the symbols are read from `tokens` while the automaton steps, so memory is
+    // bounded by the stack and the chunk buffer rather than by the input, and nothing is read past
+    // the first symbol that is outside sigma or has no transition. `stack` is cleared first.
+    RunResult executeStream(TokenStream& tokens, std::vector<int32_t>& stack, TraceRing<TraceRecord>* trace = nullptr) const {
+        if (!trace && usesTable()) {
+            std::string_view token;
+            SymbolCache cache;
+            auto source = [&](int32_t& symbol) {
+                if (!tokens.next(token)) {
+                    return false;
+                }
+                symbol = cache.lookup(*this, token);
+                return true;
+            };
+            RunResult result = executeTable(source, stack);
+            if (result.stuck || result.invalid) {
+                result.symbol = std::string(token);
+            }
+            result.accepted = result.accepted && !tokens.failed();
+            return result;
+        }
+        NoProfile profile;
+        return executeStream(tokens, stack, trace, profile);
+    }
+    
+    RunResult executeStream(TokenStream& tokens, std::vector<int32_t>& stack, RunProfile& profile,
+                            TraceRing<TraceRecord>* trace = nullptr) const {
+        return executeStream(tokens, stack, trace, profile);
+    }
+    
+    template <typename Profile>
+    RunResult executeStream(TokenStream& tokens, std::vector<int32_t>& stack, TraceRing<TraceRecord>* trace,
+                            Profile& profile) const {
+        RunResult result;
+        int32_t currState = startState;
+        stack.clear();
+        
+        result.steps += applyEpsilonTransitions(currState, stack, result.maxStackDepth, trace, profile);
+        
+        std::string_view token;
+        SymbolCache cache;
+        while (tokens.next(token)) {
+            const int32_t symbol = cache.lookup(*this, token);
+            if (symbol == kNotInSigma || !applyFirstRule(symbol, currState, stack, result.maxStackDepth, trace, profile)) {
+                result.invalid = symbol == kNotInSigma;
+                result.stuck = !result.invalid;
+                result.symbol = std::string(token);
+                result.state = stateNames[currState];
+                return result;
+            }
+            result.position++;
+            result.steps++;
+            
+            result.steps += applyEpsilonTransitions(currState, stack, result.maxStackDepth, trace, profile);
+        }
+        
+        result.state = stateNames[currState];
+        result.accepted = finalStates[currState] != 0 && !tokens.failed();
+        return result;
+    }
+    
+    // Whether the automaton was proven deterministic when it was loaded
+    bool isDeterministic() const {
+        return deterministic;
+    }
+    
+    // Lets deterministic automata run on the action table (the default) or forces the general interpreter
+    void setTableExecution(bool enabled) {
+        tableEnabled = enabled;
+    }
+    
+    bool usesTable() const {
+        const size_t width = symbolNames.size() + 1;
+        return deterministic && tableEnabled && symbolNames.size() <= 65536 && stateNames.size() * width * width <= kMaxTableActions;
+    }
+    
+    // Streamed inputs tend to repeat a symbol, so the last lookup is remembered
+    struct SymbolCache {
+        std::string token;
+        int32_t symbol = kNotInSigma;
+        
+        int32_t lookup(const PushdownAutomaton& pda, std::string_view next) {
+            if (next != token) {
+                token.assign(next.data(), next.size());
+                symbol = pda.symbolId(next);
+            }
+            return symbol;
+        }
+    };
+    
+    // The deterministic runner: every move is one lookup in the action table, and the stack is a
+    // contiguous array of 8-bit cells (16-bit beyond 256 symbols) reused by the thread between runs.
+    // `source(symbol)` yields the next input symbol, false at the end; kNotInSigma stops the run as
+    // an invalid input. The final stack is copied to `stack`.
+    template <typename Source>
+    RunResult executeTable(Source& source, std::vector<int32_t>& stack) const {
+        return symbolNames.size() <= 256 ? executeTable<uint8_t>(source, stack) : executeTable<uint16_t>(source, stack);
+    }
+    
+    template <typename Cell, typename Source>
+    RunResult executeTable(Source& source, std::vector<int32_t>& stack) const {
+        thread_local std::vector<Cell> reused(4096);
+        std::vector<Cell>& cells = reused;
+        RunResult result;
+        const TableAction* table = actions();
+        const size_t width = symbolNames.size() + 1;
+        const size_t plane = width * width;
+        
+        // The row of the current state, and the top as a column (0 for the empty stack), kept in
+        // registers rather than recomputed from the state and the stack at every move
+        const TableAction* row = table + static_cast<size_t>(startState) * plane;
+        size_t top = 0;
+        Cell* cell = cells.data();
+        size_t depth = 0;
+        size_t capacity = cells.size();
+        size_t maxDepth = 0;
+        // Counted in locals: stores to 8-bit cells may alias anything in memory, `result` included
+        size_t steps = 0;
+        size_t position = 0;
+        
+        auto move = [&](const TableAction& action) {
+            if (action.pops) {
+                --depth;
+                top = depth ? static_cast<size_t>(cell[depth - 1]) + 1 : 0;
+            }
+            if (action.push != kEpsilon) {
+                if (depth == capacity) {
+                    cells.resize(capacity * 2);
+                    cell = cells.data();
+                    capacity = cells.size();
+                }
+                cell[depth++] = static_cast<Cell>(action.push);
+                top = static_cast<size_t>(action.push) + 1;
+                maxDepth = std::max(maxDepth, depth);
+            }
+            row = table + static_cast<size_t>(action.to) * plane;
+        };
+        auto closure = [&]() {
+            for (const TableAction* action = row + top; action->to >= 0; action = row + top) {
+                move(*action);
+                steps++;
+            }
+        };
+        
+        closure();
+        int32_t symbol;
+        while (source(symbol)) {
+            if (symbol == kNotInSigma) {
+                result.invalid = true;
+                break;
+            }
+            const TableAction& action = row[static_cast<size_t>(symbol + 1) * width + top];
+            if (action.to < 0) {
+                result.stuck = true;
+                break;
+            }
+            move(action);
+            steps++;
+            position++;
+            if (action.closes) {
+                closure();
+            }
+        }
+        
+        stack.assign(cell, cell + depth);
+        result.steps = steps;
+        result.position = position;
+        result.maxStackDepth = maxDepth;
+        result.state = stateNames[static_cast<size_t>(row - table) / plane];
+        result.accepted = !result.stuck && !result.invalid && finalStates[static_cast<size_t>(row - table) / plane] != 0;
+        return result;
+    }
+    
+    // Ends `rule` on `below`, the stack left after its pop (the stack of the configuration if it pops
+    // nothing), and adds the configuration reached to `to` unless it was seen in this level. Nodes
+    // keep their depth only under a depth bound (0 is no bound), where a push past it is dropped;
+    // without one every node has depth 0, so an epsilon push loop closes into a cycle. A push that
+    // adds a predecessor to a merged node is queued, so the pops already made through that node
+    // are repeated on it.
+    void finishRule(const CompiledRule& rule, GraphStructuredStack::Handle below, SearchScratch& scratch, size_t depthBound,
+                    std::vector<Configuration>& to) const {
+        GraphStructuredStack::Handle top = below;
+        if (rule.push != kEpsilon) {
+            const uint32_t depth = depthBound > 0 ? scratch.stacks.depth(below) + 1 : 0;
+            if (depth > depthBound) {
+                return;
+            }
+            bool added = false;
+            top = scratch.stacks.push(below, rule.push, rule.to, depth, added);
+            if (added) {
+                scratch.newEdges.emplace_back(top, below);
+            }
+        }
+        const Configuration reached{rule.to, top};
+        if (scratch.visited.insert(reached).second) {
+            to.push_back(reached);
+        }
+    }
+    
+    // Applies every rule of the (from.state, input) bucket to `from`; a pop continues on every
+    // predecessor of the top. Epsilon pops are remembered per node for finishRule()'s queue.
+    void expand(const Configuration& from, int32_t input, SearchScratch& scratch, size_t depthBound, std::vector<Configuration>& to) const {
+        const size_t bucket = bucketOf(from.state, input);
+        for (uint32_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i) {
+            const CompiledRule& rule = rules[bucketRules[i]];
+            if (rule.pop == kEpsilon) {
+                finishRule(rule, from.stack, scratch, depthBound, to);
+                continue;
+            }
+            if (from.stack == GraphStructuredStack::kEmpty || scratch.stacks.top(from.stack) != rule.pop) {
+                continue;
+            }
+            if (input == kEpsilon) {
+                scratch.pops[from.stack].push_back(bucketRules[i]);
+            }
+            for (GraphStructuredStack::Handle below : scratch.stacks.pop(from.stack)) {
+                finishRule(rule, below, scratch, depthBound, to);
+            }
+        }
+    }
+    
+    // Adds every configuration reachable from the frontier through epsilon transitions, until
+    // neither a configuration nor a new predecessor edge is left to process
+    void epsilonClosure(SearchScratch& scratch, size_t depthBound) const {
+        size_t k = 0;
+        while (k < scratch.frontier.size() || !scratch.newEdges.empty()) {
+            if (!scratch.newEdges.empty()) {
+                const std::pair<GraphStructuredStack::Handle, GraphStructuredStack::Handle> edge = scratch.newEdges.back();
+                scratch.newEdges.pop_back();
+                auto popped = scratch.pops.find(edge.first);
+                if (popped != scratch.pops.end()) {
+                    for (uint32_t rule : popped->second) {
+                        finishRule(rules[rule], edge.second, scratch, depthBound, scratch.frontier);
+                    }
+                }
+                continue;
+            }
+            const Configuration current = scratch.frontier[k++];
+            expand(current, kEpsilon, scratch, depthBound, scratch.frontier);
+        }
+    }
+    
+    /*
+      Nondeterministic execution: a breadth-first search over configurations (state, input position, stack).
+      All configurations of one input position form a frontier that is deduplicated with a hash set. Stacks
+      live in a graph-structured stack, one level per input position, where branches that push the same
+      symbol into the same state merge into one node whatever lies below, so a configuration is a pair of
+      integers and a pop continues on every predecessor. A level has at most symbols * states nodes, so
+      epsilon loops stay finite without bounding the stack and the search takes polynomial time and memory
+      in the input length. maxStackDepth, when set, also drops pushes past that depth.
+     */
+    RunResult executeNondeterministic(const std::vector<int32_t>& inputString, SearchScratch& scratch) const {
+        RunResult result;
+        scratch.stacks.clear();
+        scratch.frontier.clear();
+        scratch.visited.clear();
+        scratch.pops.clear();
+        scratch.newEdges.clear();
+        const size_t depthBound = maxStackDepth;
+        
+        scratch.frontier.push_back(Configuration{startState, GraphStructuredStack::kEmpty});
+        scratch.visited.insert(scratch.frontier.back());
+        epsilonClosure(scratch, depthBound);
+        result.steps += scratch.frontier.size();
+        
+        std::vector<GraphStructuredStack::Handle> roots;
+        for (size_t i = 0; i < inputString.size(); ++i) {
+            scratch.next.clear();
+            scratch.visited.clear();
+            scratch.pops.clear();
+            scratch.stacks.nextLevel();
+            for (const Configuration& current : scratch.frontier) {
+                expand(current, inputString[i], scratch, depthBound, scratch.next);
+            }
+            
+            if (scratch.next.empty()) {
+                result.stuck = true;
+                result.position = i;
+                result.state = stateNames[scratch.frontier.front().state];
+                return result;
+            }
+            scratch.frontier.swap(scratch.next);
+            epsilonClosure(scratch, depthBound);
+            result.steps += scratch.frontier.size();
+            
+            // Stacks of dropped branches are garbage once the frontier moved past them
+            if (scratch.stacks.wantsCollection()) {
+                roots.clear();
+                for (const Configuration& current : scratch.frontier) {
+                    roots.push_back(current.stack);
+                }
+                scratch.stacks.collect(roots);
+            }
+        }
+        
+        result.position = inputString.size();
+        result.state = stateNames[scratch.frontier.front().state];
+        for (const Configuration& current : scratch.frontier) {
+            if (finalStates[current.state]) {
+                result.accepted = true;
+                result.state = stateNames[current.state];
+                break;
+            }
+        }
+        return result;
+    }
+    
+    /*
+      Builds a grammar for the language accepted by final state, starting from the empty stack. A rule
+      that both pops and pushes is first split into a pop into a fresh intermediate state and an epsilon
+      push out of it, so every rule changes the stack by at most one symbol. The nonterminals are
+        B(p,q)  reads a word from p to q, leaving the stack as it found it and never popping below it:
+                B(p,p) -> e,  B(p,q) -> a B(r,q) for a rule p a e e r,  B(p,q) -> M(p,t) B(t,q)
+        M(p,t)  a push and the pop that removes the same symbol again:
+                M(p,t) -> a B(r,s) b for rules p a e X r and s b X e t
+        U(p)    reads a word from p to a final state; the symbols pushed on the way and never popped
+                are the stack left at the end: U(p) -> B(p,f),  U(p) -> B(p,r) a U(s) for a rule r a e X s
+      and the start symbol is U(start). Nonterminals are created only when a production reachable from
+      the start needs them, and trim() drops those that derive nothing.
+     */
+    void buildGrammar() {
+        grammar = ContextFreeGrammar(symbolNames.size());
+        
+        std::vector<CompiledRule> moves;
+        std::vector<std::string> movesStateNames;
+        for (size_t state = 0; state < stateNames.size(); ++state) {
+            movesStateNames.emplace_back(stateNames[state]);
+        }
+        for (const CompiledRule& rule : rules) {
+            if (rule.pop != kEpsilon && rule.push != kEpsilon) {
+                const int32_t middle = static_cast<int32_t>(movesStateNames.size());
+                movesStateNames.push_back(movesStateNames[rule.from] + "'" + std::to_string(middle));
+                moves.push_back(CompiledRule{rule.from, rule.input, rule.pop, kEpsilon, middle});
+                moves.push_back(CompiledRule{middle, kEpsilon, kEpsilon, rule.push, rule.to});
+            } else {
+                moves.push_back(rule);
+            }
+        }
+        
+        const size_t states = movesStateNames.size();
+        std::vector<std::vector<uint32_t>> keeps(states);   // rules p a e e r by p
+        std::vector<std::vector<uint32_t>> pushes(states);  // rules p a e X r by p
+        std::vector<std::vector<uint32_t>> pops(states);    // rules s b X e t by t
+        std::vector<uint32_t> allPushes;
+        for (size_t i = 0; i < moves.size(); ++i) {
+            const CompiledRule& move = moves[i];
+            if (move.push != kEpsilon) {
+                pushes[move.from].push_back(static_cast<uint32_t>(i));
+                allPushes.push_back(static_cast<uint32_t>(i));
+            } else if (move.pop != kEpsilon) {
+                pops[move.to].push_back(static_cast<uint32_t>(i));
+            } else {
+                keeps[move.from].push_back(static_cast<uint32_t>(i));
+            }
+        }
+        // States t such that a symbol pushed from p can be popped into t
+        std::vector<std::vector<int32_t>> matched(states);
+        std::vector<char> pushedFrom(symbolNames.size());
+        for (size_t p = 0; p < states; ++p) {
+            std::fill(pushedFrom.begin(), pushedFrom.end(), 0);
+            for (uint32_t i : pushes[p]) {
+                pushedFrom[moves[i].push] = 1;
+            }
+            for (size_t t = 0; t < states && !pushes[p].empty(); ++t) {
+                for (uint32_t i : pops[t]) {
+                    if (pushedFrom[moves[i].pop]) {
+                        matched[p].push_back(static_cast<int32_t>(t));
+                        break;
+                    }
+                }
+            }
+        }
+        
+        enum Kind : uint64_t { kBalanced, kMatched, kAccepting };
+        std::unordered_map<uint64_t, int32_t> ids;
+        std::vector<uint64_t> pending;
+        auto nonterminal = [&](Kind kind, size_t p, size_t q) {
+            const uint64_t key = (static_cast<uint64_t>(kind) << 62) | (static_cast<uint64_t>(p) << 31) | q;
+            auto found = ids.find(key);
+            if (found != ids.end()) {
+                return found->second;
+            }
+            std::string name = kind == kBalanced ? "B(" : kind == kMatched ? "M(" : "U(";
+            name += movesStateNames[p];
+            if (kind != kAccepting) {
+                name += "," + movesStateNames[q];
+            }
+            int32_t id = grammar.addNonterminal(name + ")");
+            ids.emplace(key, id);
+            pending.push_back(key);
+            return id;
+        };
+        auto input = [](std::vector<int32_t>& body, int32_t symbol) {
+            if (symbol != kEpsilon) {
+                body.push_back(ContextFreeGrammar::terminal(symbol));
+            }
+        };
+        
+        grammar.setStart(nonterminal(kAccepting, static_cast<size_t>(startState), 0));
+        while (!pending.empty()) {
+            const uint64_t key = pending.back();
+            pending.pop_back();
+            const Kind kind = static_cast<Kind>(key >> 62);
+            const size_t p = (key >> 31) & 0x7FFFFFFF;
+            const size_t q = key & 0x7FFFFFFF;
+            const int32_t head = ids[key];
+            std::vector<int32_t> body;
+            
+            if (kind == kBalanced) {
+                if (p == q) {
+                    grammar.addProduction(head, {});
+                }
+                for (uint32_t i : keeps[p]) {
+                    body.clear();
+                    input(body, moves[i].input);
+                    body.push_back(nonterminal(kBalanced, moves[i].to, q));
+                    grammar.addProduction(head, body);
+                }
+                for (int32_t t : matched[p]) {
+                    grammar.addProduction(head, {nonterminal(kMatched, p, t), nonterminal(kBalanced, t, q)});
+                }
+            } else if (kind == kMatched) {
+                for (uint32_t push : pushes[p]) {
+                    for (uint32_t pop : pops[q]) {
+                        if (moves[pop].pop == moves[push].push) {
+                            body.clear();
+                            input(body, moves[push].input);
+                            body.push_back(nonterminal(kBalanced, moves[push].to, moves[pop].from));
+                            input(body, moves[pop].input);
+                            grammar.addProduction(head, body);
+                        }
+                    }
+                }
+            } else {
+                for (size_t f = 0; f < stateNames.size(); ++f) {
+                    if (finalStates[f]) {
+                        grammar.addProduction(head, {nonterminal(kBalanced, p, f)});
+                    }
+                }
+                for (uint32_t i : allPushes) {
+                    body.assign(1, nonterminal(kBalanced, p, moves[i].from));
+                    input(body, moves[i].input);
+                    body.push_back(nonterminal(kAccepting, moves[i].to, 0));
+                    grammar.addProduction(head, body);
+                }
+            }
+        }
+        grammar.trim();
+    }
+    
+    // Builds the grammar and the recognizer chosen with setRecognizer(), if any; call only on a valid automaton
+    void prepareRecognizer() {
+        if (recognizer == Recognizer::Automaton) {
+            return;
+        }
+        auto started = std::chrono::steady_clock::now();
+        buildGrammar();
+        if (recognizer == Recognizer::Cyk) {
+            chomsky = std::make_unique<ChomskyGrammar>(grammar);
+            cyk = std::make_unique<CykRecognizer>(*chomsky);
+        } else if (recognizer == Recognizer::Earley) {
+            earley = std::make_unique<EarleyRecognizer>(grammar);
+        }
+        auto finished = std::chrono::steady_clock::now();
+        
+        if (outputLevel == OutputLevel::Summary) {
+            std::cerr << "Grammar: " << grammar.nonterminalCount() << " nonterminals, "
+                      << grammar.productions().size() << " productions";
+            if (chomsky) {
+                std::cerr << "; CNF: " << chomsky->nonterminalCount() << " nonterminals, "
+                          << chomsky->binaryRules().size() << " binary rules";
+            }
+            std::cerr << " (" << std::chrono::duration<double>(finished - started).count() << " s)" << std::endl;
+        }
+    }
+    
+    // Decides membership with the grammar; "e" symbols of the input stand for the empty word and are
+    // dropped. `steps` counts the (span, nonterminal) pairs derived by CYK or the items built by Earley.
+    RunResult recognize(const std::vector<int32_t>& inputString, std::vector<int32_t>& word, WorkStealingPool* pool = nullptr) const {
+        word.clear();
+        for (int32_t symbol : inputString) {
+            if (symbol != kEpsilon) {
+                word.push_back(symbol);
+            }
+        }
+        
+        RunResult result;
+        result.position = inputString.size();
+        result.state = grammar.nonterminalCount() > 0 ? grammar.name(grammar.start()) : "-";
+        if (cyk) {
+            CykRecognizer::Result parsed = cyk->recognize(word, pool);
+            result.accepted = parsed.accepted;
+            result.steps = parsed.derived;
+        } else {
+            EarleyRecognizer::Result parsed = earley->recognize(word);
+            result.accepted = parsed.accepted;
+            result.steps = parsed.items;
+        }
+        return result;
+    }
+    
+    // Prints the grammar of the automaton, one production per line; call only on a valid automaton
+    void printGrammar() {
+        buildGrammar();
+        grammar.print(std::cout, symbolNames);
+        std::cout.flush();
+    }
+    
+    void setNondeterministic(bool enabled) {
+        nondeterministic = enabled;
+    }
+    
+    // Bound on the stack depth explored by the nondeterministic mode, 0 for none
+    void setMaxStackDepth(size_t depth) {
+        maxStackDepth = depth;
+    }
+    
+    void setRecognizer(Recognizer chosen) {
+        recognizer = chosen;
+    }
+    
+    // Worker threads of a single CYK run, 0 for one per hardware thread
+    void setThreads(unsigned count) {
+        threads = count;
+    }
+    
+    void setOutputLevel(OutputLevel level) {
+        outputLevel = level;
+    }
+    
+    // Number of transitions kept for the trace dump
+    void setTraceCapacity(size_t capacity) {
+        traceCapacity = capacity;
+    }
+    
+    // Counts rule firings and the stack depth of deterministic runs and writes the reports to
+    // <prefix>.json, .csv and .folded; an empty prefix turns profiling off
+    void setProfile(const std::string& prefix) {
+        profilePath = prefix;
+    }
+    
+    // Makes startPDA() stream its input from a file, or from stdin for "-", instead of prompting for a line
+    void setStreamInput(const std::string& path) {
+        streamPath = path;
+    }
+    
+    // PDA execution function
+    void startPDA() {
+        // Check valid automaton and rules
+        if (!isValidAutomaton() || !allValidRules()) {
+            std::cout << "Nu e automat valid, verificati fisierul de input si incercati din nou!" << std::endl;
+            return;
+        }
+        if (!streamPath.empty()) {
+            streamPDA();
+            return;
+        }
+        
+        // Get input string
+        std::string inputLine;
+        std::cout << "Enter input string (space-separated symbols): ";
+        std::getline(std::cin, inputLine);
+        
+        std::vector<std::string> inputString = splitString(inputLine);
+        std::vector<int32_t> encoded;
+        std::vector<int32_t> stack;
+        
+        // Check valid input
+        if (isValidInput(inputString)) {
+            encodeInput(inputString, encoded);
+            
+            // Check valid first rule
+            if (isValidFirstRule()) {
+                if (recognizer != Recognizer::Automaton) {
+                    WorkStealingPool pool(recognizer == Recognizer::Cyk ? threads : 1);
+                    std::vector<int32_t> word;
+                    auto started = std::chrono::steady_clock::now();
+                    RunResult result = recognize(encoded, word, &pool);
+                    auto finished = std::chrono::steady_clock::now();
+                    if (result.accepted) {
+                        std::cout << "Input accepted - derived from " << result.state << "!" << std::endl;
+                    } else {
+                        std::cout << "Input rejected - not in the language of the grammar!" << std::endl;
+                    }
+                    if (outputLevel == OutputLevel::Summary) {
+                        std::cout << (recognizer == Recognizer::Cyk ? "Spans derived: " : "Earley items: ") << result.steps << std::endl;
+                        std::cout << "Time: " << std::chrono::duration<double>(finished - started).count() << " s" << std::endl;
+                    }
+                    return;
+                }
+                if (nondeterministic) {
+                    SearchScratch scratch;
+                    RunResult result = executeNondeterministic(encoded, scratch);
+                    if (result.stuck) {
+                        std::cout << "No configuration can read input symbol " << inputString[result.position]
+                                  << " at position " << result.position << std::endl;
+                        std::cout << "Input rejected!" << std::endl;
+                    } else if (result.accepted) {
+                        std::cout << "Input accepted - reached final state " << result.state << "!" << std::endl;
+                    } else {
+                        std::cout << "Input rejected - no branch ends in a final state!" << std::endl;
+                    }
+                    if (outputLevel != OutputLevel::Verdict) {
+                        std::cout << "Configurations explored: " << result.steps << std::endl;
+                        std::cout << "Live stack nodes: " << scratch.stacks.liveNodes()
+                                  << " (peak " << scratch.stacks.peakLiveNodes() << ")" << std::endl;
+                        std::cout << "Stack arena: " << scratch.stacks.arenaBytes() << " bytes" << std::endl;
+                    }
+                    return;
+                }
+                
+                const bool traced = outputLevel == OutputLevel::Trace;
+                TraceRing<TraceRecord> trace(traced ? traceCapacity : 1);
+                RunProfile profile = newProfile();
+                auto started = std::chrono::steady_clock::now();
+                RunResult result = profilePath.empty() ? execute(encoded, stack, traced ? &trace : nullptr)
+                                                       : execute(encoded, stack, profile, traced ? &trace : nullptr);
+                auto finished = std::chrono::steady_clock::now();
+                
+                if (traced) {
+                    dumpTrace(trace, stack);
+                }
+                
+                if (result.stuck) {
+                    std::cout << "No valid transition for input symbol " << inputString[result.position] << " from state " << result.state << std::endl;
+                    std::cout << "Input rejected!" << std::endl;
+                }
+                else {
+                    // Final stack state
+                    if (outputLevel != OutputLevel::Verdict) {
+                        printStack(stack);
+                    }
+                    
+                    // Check if current state is a final state
+                    if (result.accepted) {
+                        std::cout << "Input accepted - reached final state!" << std::endl;
+                    } else {
+                        std::cout << "Input rejected - not in a final state!" << std::endl;
+                    }
+                }
+                
+                if (outputLevel == OutputLevel::Summary) {
+                    printEngine();
+                    std::cout << "Transitions: " << result.steps << std::endl;
+                    std::cout << "Max stack depth: " << result.maxStackDepth << std::endl;
+                    std::cout << "Time: " << std::chrono::duration<double>(finished - started).count() << " s" << std::endl;
+                }
+                if (!profilePath.empty()) {
+                    profile.write(profilePath, profileLabels());
+                }
+            }
+            else {
+                std::cout << "Nu e automat valid, verificati fisierul de input si incercati din nou!" << std::endl;
+            }
+        }
+        else {
+            std::cout << "Input invalid!" << std::endl;
+        }
+    }
+    
+    // Which engine ran an untraced deterministic run, and why
+    void printEngine() const {
+        if (usesTable() && profilePath.empty()) {
+            std::cout << "Engine: action table (deterministic)" << std::endl;
+        } else {
+            std::cout << "Engine: interpreter" << (deterministic ? "" : " (not deterministic)") << std::endl;
+        }
+    }
+    
+    void printStack(const std::vector<int32_t>& stack) const {
+        std::cout << "Final stack: [";
+        for (size_t i = 0; i < stack.size(); ++i) {
+            std::cout << symbolNames[stack[i]];
+            if (i < stack.size() - 1) {
+                std::cout << ", ";
+            }
+        }
+        std::cout << "]" << std::endl;
+    }
+    
+    // Single deterministic run on the streamed input; a rejection is printed as soon as the
+    // offending symbol arrives, without waiting for the rest of the stream
+    void streamPDA() {
+        TokenStream tokens;
+        if (!tokens.open(streamPath)) {
+            std::cerr << "Failed to open file: " << streamPath << std::endl;
+            return;
+        }
+        if (!isValidFirstRule()) {
+            std::cout << "Nu e automat valid, verificati fisierul de input si incercati din nou!" << std::endl;
+            return;
+        }
+        
+        std::vector<int32_t> stack;
+        const bool traced = outputLevel == OutputLevel::Trace;
+        TraceRing<TraceRecord> trace(traced ? traceCapacity : 1);
+        RunProfile profile = newProfile();
+        auto started = std::chrono::steady_clock::now();
+        RunResult result = profilePath.empty() ? executeStream(tokens, stack, traced ? &trace : nullptr)
+                                               : executeStream(tokens, stack, profile, traced ? &trace : nullptr);
+        auto finished = std::chrono::steady_clock::now();
+        
+        if (traced) {
+            dumpTrace(trace, stack);
+        }
+        
+        if (result.invalid) {
+            std::cout << "Input invalid: symbol " << result.symbol << " at position " << result.position << " is not in sigma!" << std::endl;
+        }
+        else if (result.stuck) {
+            std::cout << "No valid transition for input symbol " << result.symbol << " at position " << result.position
+                      << " from state " << result.state << std::endl;
+            std::cout << "Input rejected!" << std::endl;
+        }
+        else if (tokens.failed()) {
+            std::cout << "Error reading input: " << streamPath << std::endl;
+        }
+        else {
+            if (outputLevel != OutputLevel::Verdict) {
+                printStack(stack);
+            }
+            if (result.accepted) {
+                std::cout << "Input accepted - reached final state!" << std::endl;
+            } else {
+                std::cout << "Input rejected - not in a final state!" << std::endl;
+            }
+        }
+        
+        if (outputLevel == OutputLevel::Summary) {
+            const double seconds = std::chrono::duration<double>(finished - started).count();
+            printEngine();
+            std::cout << "Symbols read: " << result.position << " (" << tokens.bytesRead() << " bytes)" << std::endl;
+            std::cout << "Transitions: " << result.steps << std::endl;
+            std::cout << "Max stack depth: " << result.maxStackDepth << std::endl;
+            std::cout << "Time: " << seconds << " s" << std::endl;
+            if (seconds > 0) {
+                std::cout << "Throughput: " << result.position / seconds << " symbols/s" << std::endl;
+            }
+        }
+        if (!profilePath.empty()) {
+            profile.write(profilePath, profileLabels());
+        }
+    }
+    
+    // Runs every line of the inputs file as a separate input and prints, in input order:
+    // <line number> <accept|reject|invalid> <state> <transitions applied>
+    // The automaton is shared read-only by the workers, each worker reuses its own stack.
+    bool runBatch(const std::string& inputsPath, unsigned threads) const {
+        std::ifstream inputs(inputsPath);
+        if (!inputs.is_open()) {
+            std::cerr << "Failed to open file: " << inputsPath << std::endl;
+            return false;
+        }
+        
+        WorkStealingPool pool(threads);
+        std::vector<std::vector<int32_t>> stacks(pool.size());
+        std::vector<std::vector<int32_t>> encoded(pool.size());
+        std::vector<SearchScratch> scratches(pool.size());
+        std::vector<std::vector<int32_t>> words(pool.size());
+        const bool profiled = !profilePath.empty();
+        std::vector<RunProfile> profiles(profiled ? pool.size() : 0, newProfile());
+        
+        const size_t blockLines = 1 << 14;
+        std::vector<std::string> lines;
+        std::vector<RunResult> results(blockLines);
+        std::vector<char> valid(blockLines);
+        size_t lineNumber = 0;
+        size_t totalSteps = 0;
+        
+        auto started = std::chrono::steady_clock::now();
+        std::string line;
+        bool more = true;
+        while (more) {
+            lines.clear();
+            while (lines.size() < blockLines && (more = static_cast<bool>(std::getline(inputs, line)))) {
+                lines.push_back(line);
+            }
+            
+            pool.parallelFor(lines.size(), [&](unsigned worker, size_t i) {
+                std::vector<std::string> inputString = splitString(lines[i]);
+                valid[i] = isValidInput(inputString);
+                if (valid[i]) {
+                    encodeInput(inputString, encoded[worker]);
+                    if (recognizer != Recognizer::Automaton) {
+                        results[i] = recognize(encoded[worker], words[worker]);
+                    } else if (nondeterministic) {
+                        results[i] = executeNondeterministic(encoded[worker], scratches[worker]);
+                    } else {
+                        results[i] = profiled ? execute(encoded[worker], stacks[worker], profiles[worker])
+                                              : execute(encoded[worker], stacks[worker]);
+                    }
+                }
+            });
+            
+            for (size_t i = 0; i < lines.size(); ++i) {
+                std::cout << ++lineNumber << '\t';
+                if (!valid[i]) {
+                    std::cout << "invalid\n";
+                    continue;
+                }
+                std::cout << (results[i].accepted ? "accept" : "reject") << '\t'
+                          << results[i].state << '\t' << results[i].steps << '\n';
+                totalSteps += results[i].steps;
+            }
+        }
+        std::cout.flush();
+        auto finished = std::chrono::steady_clock::now();
+        
+        if (outputLevel != OutputLevel::Verdict) {
+            double seconds = std::chrono::duration<double>(finished - started).count();
+            std::cerr << "Inputs: " << lineNumber << " on " << pool.size() << " threads" << std::endl;
+            std::cerr << "Transitions: " << totalSteps << std::endl;
+            std::cerr << "Time: " << seconds << " s" << std::endl;
+            if (seconds > 0) {
+                std::cerr << "Throughput: " << lineNumber / seconds << " inputs/s" << std::endl;
+            }
+        }
+        if (profiled) {
+            for (size_t worker = 1; worker < profiles.size(); ++worker) {
+                profiles[0].merge(profiles[worker]);
+            }
+            return profiles[0].write(profilePath, profileLabels());
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef RUN_PROFILE_H
+#define RUN_PROFILE_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+  Opt-in profile of simulator runs: how often each rule fired, histograms of the head's distance
+  from its starting cell and of the stack depth after every step, and the totals of the run.
+
+  The engines take the recorder as a template policy. NoProfile has empty inline members, so the
+  default instantiations compile to the same step loops as before; RunProfile counts. Histograms
+  use power-of-two buckets: bucket 0 holds 0 and bucket b holds the values in [2^(b-1), 2^b).
+ */
+struct NoProfile {
+    void fire(size_t) {}
+    void position(long long) {}
+    void depth(size_t) {}
+};
+
+// What the counters of a profile mean, supplied by the simulator when the report is written
+struct ProfileLabels {
+    std::string machine;             // root frame of the collapsed stacks
+    std::vector<std::string> states;
+    std::vector<std::string> rules;  // indexed like the rule counters, empty for indices that are no rule
+    std::vector<int32_t> ruleStates; // state each rule fires from
+};
+
+class RunProfile {
+public:
+    static constexpr size_t kBuckets = 65;
+
+    explicit RunProfile(size_t rules = 0) : counts(rules) {}
+
+    void fire(size_t rule) {
+        ++counts[rule];
+    }
+
+    void position(long long where) {
+        positions = true;
+        minPosition = std::min(minPosition, where);
+        maxPosition = std::max(maxPosition, where);
+        ++travel[bucketOf(static_cast<uint64_t>(where < 0 ? -where : where))];
+    }
+
+    void depth(size_t size) {
+        depths = true;
+        maxDepth = std::max(maxDepth, size);
+        ++stackDepth[bucketOf(size)];
+    }
+
+    // Adds the counts of another profile of the same machine; the cells touched become the widest span
+    void merge(const RunProfile& other) {
+        for (size_t i = 0; i < counts.size() && i < other.counts.size(); ++i) {
+            counts[i] += other.counts[i];
+        }
+        for (size_t b = 0; b < kBuckets; ++b) {
+            travel[b] += other.travel[b];
+            stackDepth[b] += other.stackDepth[b];
+        }
+        positions = positions || other.positions;
+        depths = depths || other.depths;
+        minPosition = std::min(minPosition, other.minPosition);
+        maxPosition = std::max(maxPosition, other.maxPosition);
+        maxDepth = std::max(maxDepth, other.maxDepth);
+    }
+
+    uint64_t steps() const {
+        uint64_t total = 0;
+        for (uint64_t count : counts) {
+            total += count;
+        }
+        return total;
+    }
+
+    // The head moves one cell at a time, so every cell between the extreme positions was visited
+    uint64_t cellsTouched() const {
+        return positions ? static_cast<uint64_t>(maxPosition - minPosition + 1) : 0;
+    }
+
+    size_t maxStackDepth() const {
+        return maxDepth;
+    }
+
+    // Writes <prefix>.json, <prefix>.csv and <prefix>.folded (collapsed stacks for flamegraph.pl:
+    // machine;state;rule count); false if a file cannot be written
+    bool write(const std::string& prefix, const ProfileLabels& labels) const {
+        std::vector<uint64_t> perState(labels.states.size());
+        for (size_t rule = 0; rule < counts.size() && rule < labels.ruleStates.size(); ++rule) {
+            if (!labels.rules[rule].empty()) {
+                perState[labels.ruleStates[rule]] += counts[rule];
+            }
+        }
+
+        std::ofstream json(prefix + ".json");
+        std::ofstream csv(prefix + ".csv");
+        std::ofstream folded(prefix + ".folded");
+        if (!json.is_open() || !csv.is_open() || !folded.is_open()) {
+            std::cerr << "Error opening profile files: " << prefix << ".{json,csv,folded}" << std::endl;
+            return false;
+        }
+
+        json << "{\n  \"machine\": \"" << escape(labels.machine) << "\",\n  \"steps\": " << steps()
+             << ",\n  \"cells_touched\": " << cellsTouched() << ",\n  \"max_stack_depth\": " << maxDepth
+             << ",\n  \"states\": [";
+        csv << "section,name,state,count\n";
+        const char* separator = "\n";
+        for (size_t state = 0; state < labels.states.size(); ++state) {
+            json << separator << "    {\"name\": \"" << escape(labels.states[state]) << "\", \"fired\": " << perState[state] << "}";
+            csv << "state," << csvField(labels.states[state]) << ",," << perState[state] << '\n';
+            separator = ",\n";
+        }
+        json << "\n  ],\n  \"rules\": [";
+        separator = "\n";
+        for (size_t rule = 0; rule < counts.size() && rule < labels.rules.size(); ++rule) {
+            if (labels.rules[rule].empty()) {
+                continue;
+            }
+            const std::string& state = labels.states[labels.ruleStates[rule]];
+            json << separator << "    {\"rule\": \"" << escape(labels.rules[rule]) << "\", \"state\": \"" << escape(state)
+                 << "\", \"fired\": " << counts[rule] << "}";
+            csv << "rule," << csvField(labels.rules[rule]) << ',' << csvField(state) << ',' << counts[rule] << '\n';
+            separator = ",\n";
+            if (counts[rule] > 0) {
+                folded << frame(labels.machine) << ';' << frame(state) << ';' << frame(labels.rules[rule]) << ' '
+                       << counts[rule] << '\n';
+            }
+        }
+        json << "\n  ],\n  \"head_travel\": ";
+        writeHistogram(json, csv, "head_travel", travel, positions);
+        json << ",\n  \"stack_depth\": ";
+        writeHistogram(json, csv, "stack_depth", stackDepth, depths);
+        json << "\n}\n";
+        csv << "total,steps,," << steps() << "\ntotal,cells_touched,," << cellsTouched() << "\ntotal,max_stack_depth,,"
+            << maxDepth << '\n';
+        return static_cast<bool>(json) && static_cast<bool>(csv) && static_cast<bool>(folded);
+    }
+
+private:
+    std::vector<uint64_t> counts;    // firings per rule index
+    std::array<uint64_t, kBuckets> travel{};
+    std::array<uint64_t, kBuckets> stackDepth{};
+    bool positions = false;
+    bool depths = false;
+    long long minPosition = 0;
+    long long maxPosition = 0;
+    size_t maxDepth = 0;
+
+    static size_t bucketOf(uint64_t value) {
+        return value == 0 ? 0 : 64 - static_cast<size_t>(__builtin_clzll(value));
+    }
+
+    static void writeHistogram(std::ofstream& json, std::ofstream& csv, const char* name,
+                               const std::array<uint64_t, kBuckets>& buckets, bool recorded) {
+        json << '[';
+        const char* separator = "";
+        for (size_t b = 0; recorded && b < kBuckets; ++b) {
+            if (buckets[b] == 0) {
+                continue;
+            }
+            const uint64_t low = b == 0 ? 0 : uint64_t(1) << (b - 1);
+            const uint64_t high = b == 0 ? 0 : (b == 64 ? UINT64_MAX : (uint64_t(1) << b) - 1);
+            json << separator << "{\"min\": " << low << ", \"max\": " << high << ", \"steps\": " << buckets[b] << "}";
+            csv << name << ',' << low << '-' << high << ",," << buckets[b] << '\n';
+            separator = ", ";
+        }
+        json << ']';
+    }
+
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    static std::string csvField(const std::string& text) {
+        if (text.find_first_of(",\"") == std::string::npos) {
+            return text;
+        }
+        std::string quoted = "\"";
+        for (char c : text) {
+            quoted += c;
+            if (c == '"') {
+                quoted += '"';
+            }
+        }
+        return quoted + '"';
+    }
+
+    // Frames cannot contain the ';' separator
+    static std::string frame(std::string text) {
+        std::replace(text.begin(), text.end(), ';', ':');
+        return text;
+    }
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef TRACE_SINK_H
+#define TRACE_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How much the simulators print about a run
+enum class OutputLevel {
+    Verdict,  // only the outcome of the run
+    Summary,  // the outcome plus step counts, timing and memory figures
+    Trace     // every transition as well, dumped after the run
+};
+
+/**
+  Fixed-size ring buffer of compact binary trace records.
+
+  Recording a transition is one store and one increment, with no formatting and no I/O, so
+  tracing does not slow a run down by orders of magnitude. Once the buffer is full the oldest
+  records are overwritten; the caller formats whatever is left after the run has finished.
+ */
+template <typename Record>
+class TraceRing {
+public:
+    // The capacity is rounded up to a power of two
+    explicit TraceRing(size_t capacity = 1 << 16) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        records_.resize(size);
+        mask_ = size - 1;
+    }
+
+    void push(const Record& record) {
+        records_[written_ & mask_] = record;
+        ++written_;
+    }
+
+    void clear() {
+        written_ = 0;
+    }
+
+    uint64_t written() const {
+        return written_;
+    }
+
+    // Number of records still held
+    size_t size() const {
+        return written_ < records_.size() ? static_cast<size_t>(written_) : records_.size();
+    }
+
+    // Records that were overwritten before the dump
+    uint64_t dropped() const {
+        return written_ - size();
+    }
+
+    // i-th record still held, 0 being the oldest
+    const Record& operator[](size_t i) const {
+        return records_[(dropped() + i) & mask_];
+    }
+
+private:
+    std::vector<Record> records_;
+    size_t mask_ = 0;
+    uint64_t written_ = 0;
+};
+
+#endif
@@ -1,298 +1,153 @@
-#include <iostream>
-#include <fstream>
-#include <string>
-#include <vector>
-#include <sstream>
-#include <unordered_map>
-#include <unordered_set>
-
-/*
-  TuringMachine class for simulating a Turing Machine
- 
-  The input file must follow this format:
-  [states]
-  state_1 value
-  state_2 value
-  (value refers to S for start_state, F for final_state, or anything else for intermediate states usually 0)
-  there can only be one start state, but if there are multiple states marked with S, the last one will be considered the start state;
-  there can only be one final state, but if there are multiple states marked with F, the last one will be considered the final state;
-  if a state is both a start and final state, it must be set separately, not on the same line)
-  ...
- 
-  [sigma]
-  letter_1
-  letter_2
-  ...
- 
-  [rules]
-  state_1 letter state_2 letter direction (the first rule must have the start state as the first state)
-  state_3 letter state_4 letter direction (direction MUST be R or L)
-  ...
- */
-class TuringMachine
-{
-private:
-    std::unordered_map<std::string, std::string> states_;
-    std::unordered_set<char> sigma_;
-    std::vector<std::vector<std::string>> rules_;
-    std::string start_state_;
-    std::string final_state_;
-
-    // Helper function to trim leading and trailing whitespace
-    std::string trim(const std::string &s)
+#include "turing.h"
+
+// Usage: ./turing [--quiet | --stats | --trace [--trace-capacity N]] [--macro] [--batch inputs.txt] [--threads N]
+//                 [--max-steps N] [--timeout SECONDS] [--detect-loops] [--single-tape] [--native]
+//                 [--profile PREFIX] [definition file]
+//        ./turing --emit machine.bin [definition file]
+//        ./turing --codegen machine.cpp [definition file]
+// Batch runs never trace; --stats and --trace both print the batch summary. --emit converts a
+// text definition into a binary image, which is accepted wherever a definition file is.
+// --max-steps and --timeout stop runs that take too long; --detect-loops proves that a run
+// never halts when it repeats a configuration, exactly or shifted along the blank tape.
+// Machines with several tapes run on the multi-tape engine, which ignores --macro, --trace and
+// --detect-loops; --single-tape simulates them on one tape instead, where every option applies.
+// --native compiles the machine to C++ with the system compiler and runs that instead of the
+// plain engine (with budgets, but no --macro, --trace or --detect-loops); --codegen only writes
+// the C++ source, which also builds as a standalone program. --profile counts how often every
+// rule fired, the head travel and the cells touched on the plain engine, summed over a batch, and
+// writes PREFIX.json, PREFIX.csv and PREFIX.folded (collapsed stacks for flame graphs).
+int main(int argc, char *argv[])
+{   
+    OutputLevel level = OutputLevel::Verdict;
+    size_t trace_capacity = 1 << 16;
+    bool accelerated = false;
+    std::string batch_path;
+    std::string emit_path;
+    unsigned threads = 0;
+    uint64_t max_steps = 0;
+    double timeout = 0;
+    bool detect_loops = false;
+    bool single_tape = false;
+    bool native = false;
+    std::string codegen_path;
+    std::string profile_path;
+    std::string filename;
+    for (int i = 1; i < argc; ++i)
     {
-        size_t first = s.find_first_not_of(" \t\n\r");
-        if (std::string::npos == first)
+        std::string arg = argv[i];
+        if (arg == "--quiet")
         {
-            return s;
+            level = OutputLevel::Verdict;
         }
-        size_t last = s.find_last_not_of(" \t\n\r");
-        return s.substr(first, (last - first + 1));
-    }
-
-    // Helper function to split a string into tokens
-    std::vector<std::string> split(const std::string &s)
-    {
-        std::vector<std::string> tokens;
-        std::stringstream ss(s);
-        std::string token;
-        while (ss >> token)
+        else if (arg == "--stats")
         {
-            tokens.push_back(token);
+            level = OutputLevel::Summary;
         }
-        return tokens;
-    }
-
-    bool isValidState(const std::string &state_name) const
-    {
-        return states_.find(state_name) != states_.end();
-    }
-
-    bool isValidSymbol(char symbol) const
-    {
-        return sigma_.find(symbol) != sigma_.end();
-    }
-
-    bool isValidDirection(const std::string &dir) const
-    {
-        return dir == "R" || dir == "L";
-    }
-
-public:
-    bool loadFromFile(const std::string &filename)
-    {
-        std::ifstream inputFile(filename);
-        if (!inputFile.is_open())
+        else if (arg == "--trace")
         {
-            std::cerr << "Error opening file: " << filename << std::endl;
-            return false;
+            level = OutputLevel::Trace;
         }
-
-        std::string line;
-        std::string current_section;
-
-        while (std::getline(inputFile, line))
+        else if (arg == "--trace-capacity" && i + 1 < argc)
         {
-            line = trim(line);
-            if (line.empty() || line[0] == '#')
-            {
-                continue;
-            }
-
-            if (line.rfind('[', 0) == 0 && line.rfind(']', line.length() - 1) == line.length() - 1)
-            {
-                current_section = trim(line.substr(1, line.length() - 2));
-            }
-            else if (current_section == "states")
-            {
-                std::vector<std::string> parts = split(line);
-                if (parts.size() == 2)
-                {
-                    states_[parts[0]] = parts[1];
-                    if (parts[1] == "S")
-                    {
-                        start_state_ = parts[0];
-                    }
-                    else if (parts[1] == "F")
-                    {
-                        final_state_ = parts[0];
-                    }
-                }
-                else
-                {
-                    std::cerr << "Invalid state definition: " << line << std::endl;
-                    return false;
-                }
-            }
-            else if (current_section == "sigma")
-            {
-                if (line.length() == 1)
-                {
-                    sigma_.insert(line[0]);
-                }
-                else
-                {
-                    std::cerr << "Invalid sigma symbol: " << line << std::endl;
-                    return false;
-                }
-            }
-            else if (current_section == "rules")
-            {
-                std::vector<std::string> parts = split(line);
-                if (parts.size() == 5)
-                {
-                    rules_.push_back(parts);
-                }
-                else
-                {
-                    std::cerr << "Invalid rule definition: " << line << std::endl;
-                    return false;
-                }
-            }
+            trace_capacity = std::stoul(argv[++i]);
         }
-
-        inputFile.close();
-        return true;
-    }
-
-    bool isValidAutomaton() const
-    {
-        if (states_.empty() || sigma_.empty() || rules_.empty())
+        else if (arg == "--macro")
         {
-            std::cerr << "The automaton must have states, sigma, and rules defined." << std::endl;
-            return false;
+            accelerated = true;
         }
-        if (start_state_.empty())
+        else if (arg == "--batch" && i + 1 < argc)
         {
-            std::cerr << "Start state is not defined or is invalid." << std::endl;
-            return false;
+            batch_path = argv[++i];
         }
-        if (final_state_.empty())
+        else if (arg == "--threads" && i + 1 < argc)
         {
-            std::cerr << "Final state is not defined or is invalid." << std::endl;
-            return false;
+            threads = static_cast<unsigned>(std::stoul(argv[++i]));
         }
-        for (const auto &rule : rules_)
+        else if (arg == "--max-steps" && i + 1 < argc)
         {
-            if (!isValidState(rule[0]) || !isValidState(rule[2]) ||
-                !isValidSymbol(rule[1][0]) || !isValidSymbol(rule[3][0]) ||
-                !isValidDirection(rule[4]))
-            {
-                std::cerr << "Invalid rule: " << rule[0] << " " << rule[1] << " "
-                          << rule[2] << " " << rule[3] << " " << rule[4] << std::endl;
-                return false;
-            }
+            max_steps = std::stoull(argv[++i]);
         }
-        if (rules_.empty() || rules_[0][0] != start_state_)
+        else if (arg == "--timeout" && i + 1 < argc)
         {
-            std::cerr << "The first rule must start from the start state." << std::endl;
-            return false;
+            timeout = std::stod(argv[++i]);
         }
-        return true;
-    }
-
-    bool isValidInput(const std::vector<std::string> &input_string) const
-    {
-        for (const std::string &symbol_str : input_string)
+        else if (arg == "--detect-loops")
         {
-            if (symbol_str.length() != 1 || sigma_.find(symbol_str[0]) == sigma_.end())
-            {
-                std::cerr << "Invalid input symbol: " << symbol_str << std::endl;
-                return false;
-            }
+            detect_loops = true;
         }
-        return true;
-    }
-
-    void run()
-    {
-        if (!isValidAutomaton())
+        else if (arg == "--single-tape")
         {
-            std::cerr << "Invalid automaton. Please check the input file." << std::endl;
-            return;
+            single_tape = true;
         }
-
-        std::string input_line;
-        std::cout << "Enter input string (symbols separated by spaces): ";
-        std::getline(std::cin, input_line);
-        std::vector<std::string> input_symbols = split(input_line);
-
-        if (!isValidInput(input_symbols))
+        else if (arg == "--native")
         {
-            return;
+            native = true;
         }
-
-        std::vector<char> bandwidth;
-        for (const std::string &symbol : input_symbols)
+        else if (arg == "--codegen" && i + 1 < argc)
         {
-            bandwidth.push_back(symbol[0]);
+            codegen_path = argv[++i];
         }
-        bandwidth.insert(bandwidth.end(), 100, '*'); // Fill with blank symbols
-
-        int head_position = 0;
-        std::string current_state = start_state_;
-
-        while (current_state != final_state_)
+        else if (arg == "--profile" && i + 1 < argc)
         {
-            if (head_position < 0 || head_position >= bandwidth.size())
-            {
-                std::cout << "The read/write head moved outside the tape." << std::endl;
-                break;
-            }
-
-            bool rule_found = false;
-            for (const auto &rule : rules_)
-            {
-                if (rule[0] == current_state && rule[1][0] == bandwidth[head_position])
-                {
-                    current_state = rule[2];
-                    bandwidth[head_position] = rule[3][0];
-                    if (rule[4] == "R")
-                    {
-                        head_position++;
-                    }
-                    else
-                    {
-                        head_position--;
-                    }
-                    rule_found = true;
-                    break;
-                }
-            }
-
-            if (!rule_found)
-            {
-                std::cout << "No rule found for state " << current_state
-                          << " and symbol " << bandwidth[head_position] << std::endl;
-                break;
-            }
+            profile_path = argv[++i];
         }
-
-        // Print resulting tape (excluding blank symbols at the end)
-        int end = bandwidth.size() - 1;
-        while (end >= 0 && bandwidth[end] == '*')
+        else if (arg == "--emit" && i + 1 < argc)
         {
-            end--;
+            emit_path = argv[++i];
         }
-        std::cout << "Result: ";
-        for (int i = 0; i <= end; ++i)
+        else if (arg[0] != '-' && filename.empty())
         {
-            std::cout << bandwidth[i];
+            filename = arg;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
         }
-        std::cout << std::endl;
     }
-};
 
-int main()
-{   
-    std::string filename;
-    std::cout << "Enter Turing Machine definition filename: ";
-    std::cin >> filename;
-    std::cin.ignore(); // Clear the newline character
+    if (native && (accelerated || detect_loops || level == OutputLevel::Trace))
+    {
+        std::cerr << "--native cannot be combined with --macro, --detect-loops or --trace" << std::endl;
+        return 1;
+    }
+    if (!profile_path.empty() && (native || accelerated))
+    {
+        std::cerr << "--profile cannot be combined with --native or --macro" << std::endl;
+        return 1;
+    }
+
+    if (filename.empty())
+    {
+        std::cout << "Enter Turing Machine definition filename: ";
+        std::cin >> filename;
+        std::cin.ignore(); // Clear the newline character
+    }
     
     TuringMachine tm;
+    tm.setOutputLevel(level);
+    tm.setTraceCapacity(trace_capacity);
+    tm.setAccelerated(accelerated);
+    tm.setStepBudget(max_steps);
+    tm.setTimeBudget(timeout);
+    tm.setDetectLoops(detect_loops);
+    tm.setSingleTape(single_tape);
+    tm.setNative(native);
+    tm.setProfile(profile_path);
     if (tm.loadFromFile(filename))
     {
+        if (!emit_path.empty())
+        {
+            return tm.emitImage(emit_path) ? 0 : 1;
+        }
+        if (!codegen_path.empty())
+        {
+            return tm.emitNativeSource(codegen_path) ? 0 : 1;
+        }
+        if (!batch_path.empty())
+        {
+            return tm.runBatch(batch_path, threads) ? 0 : 1;
+        }
         tm.run();
     }
     return 0;
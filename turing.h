@@ -0,0 +1,2675 @@
+#ifndef TURING_H
+#define TURING_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "definition_file.h"
+#include "machine_image.h"
+#include "run_profile.h"
+#include "trace_sink.h"
+#include "work_stealing_pool.h"
+
+/*
+  Two-way infinite tape of interned symbols.
+
+  The cells live in one buffer framed by an edge sentinel on each side. The transition table
+  maps the sentinel to a "grow" entry, so ordinary steps never test the head against the
+  bounds: only stepping onto a sentinel calls grow(), which doubles the buffer and centers
+  the old contents in it (amortised O(1) per cell in both directions).
+ */
+class Tape
+{
+private:
+    std::vector<uint8_t> cells_;
+    long long origin_ = 1; // buffer index of tape position 0
+    uint8_t blank_ = 0;
+    uint8_t edge_ = 0;
+    size_t peak_cells_ = 0;
+
+public:
+    static constexpr size_t kInitialPadding = 100;
+
+    // Lays the input out from position 0 with blank padding on both sides
+    void reset(const std::vector<uint8_t> &input, uint8_t blank, uint8_t edge)
+    {
+        blank_ = blank;
+        edge_ = edge;
+        cells_.assign(input.size() + 2 * kInitialPadding + 2, blank);
+        cells_.front() = edge;
+        cells_.back() = edge;
+        origin_ = 1 + kInitialPadding;
+        std::copy(input.begin(), input.end(), cells_.begin() + origin_);
+        peak_cells_ = std::max(peak_cells_, cells_.size() - 2);
+    }
+
+    uint8_t *data()
+    {
+        return cells_.data();
+    }
+
+    // Buffer index of the given tape position
+    long long indexOf(long long position) const
+    {
+        return origin_ + position;
+    }
+
+    long long positionOf(long long index) const
+    {
+        return index - origin_;
+    }
+
+    // Symbol at a tape position; blank anywhere outside the buffer
+    uint8_t at(long long position) const
+    {
+        long long index = origin_ + position;
+        return index >= 1 && index < static_cast<long long>(cells_.size()) - 1 ? cells_[index] : blank_;
+    }
+
+    // Leftmost and rightmost positions held in the buffer
+    long long firstPosition() const
+    {
+        return 1 - origin_;
+    }
+
+    long long lastPosition() const
+    {
+        return static_cast<long long>(cells_.size()) - 2 - origin_;
+    }
+
+    // Called when the head at buffer index `index` stands on a sentinel; returns the new index
+    long long grow(long long index)
+    {
+        const size_t used = cells_.size() - 2;
+        const size_t added = std::max<size_t>(used, kInitialPadding);
+        const size_t shift = index == 0 ? added : added / 2;
+
+        std::vector<uint8_t> grown(used + added + 2, blank_);
+        grown.front() = edge_;
+        grown.back() = edge_;
+        std::copy(cells_.begin() + 1, cells_.end() - 1, grown.begin() + 1 + shift);
+        cells_.swap(grown);
+        origin_ += shift;
+        peak_cells_ = std::max(peak_cells_, cells_.size() - 2);
+        return index + shift;
+    }
+
+    // Tape contents from the leftmost non-blank cell (or position 0) to the rightmost non-blank cell.
+    // With `decode`, every cell is read as decode[cell] instead.
+    std::vector<uint8_t> contents(const uint8_t *decode = nullptr) const
+    {
+        auto symbol = [&](long long index) { return decode ? decode[cells_[index]] : cells_[index]; };
+        long long first = 1;
+        while (first < origin_ && symbol(first) == blank_)
+        {
+            first++;
+        }
+        long long last = static_cast<long long>(cells_.size()) - 2;
+        while (last >= first && symbol(last) == blank_)
+        {
+            last--;
+        }
+        if (last < first)
+        {
+            return {};
+        }
+        std::vector<uint8_t> cells(cells_.begin() + first, cells_.begin() + last + 1);
+        if (decode)
+        {
+            for (uint8_t &cell : cells)
+            {
+                cell = decode[cell];
+            }
+        }
+        return cells;
+    }
+
+    // Largest number of cells held at once, and the bytes they occupied
+    size_t peakCells() const
+    {
+        return peak_cells_;
+    }
+
+    size_t peakBytes() const
+    {
+        return (peak_cells_ + 2) * sizeof(uint8_t);
+    }
+};
+
+/*
+  Run-length encoded two-way infinite tape used by the accelerated engine.
+
+  The tape is kept as a zipper: the symbol under the head plus two stacks of runs whose
+  backs are the runs adjacent to the head. Adjacent runs on a stack never share a symbol,
+  and the infinite blank region beyond the last run is implicit.
+ */
+class RunLengthTape
+{
+public:
+    struct Run
+    {
+        uint8_t symbol;
+        uint64_t count;
+
+        bool operator==(const Run &other) const
+        {
+            return symbol == other.symbol && count == other.count;
+        }
+    };
+
+private:
+    // Most blank cells one sweep crosses, so a sweep that never ends still comes back to the
+    // run loop, which checks the budget
+    static constexpr uint64_t kBlankChunk = 1 << 20;
+
+    std::vector<Run> left_;
+    std::vector<Run> right_;
+    uint8_t current_ = 0;
+    uint8_t blank_ = 0;
+    long long head_ = 0;
+    size_t peak_runs_ = 0;
+
+    void push(std::vector<Run> &side, uint8_t symbol, uint64_t count)
+    {
+        if (!side.empty() && side.back().symbol == symbol)
+        {
+            side.back().count += count;
+        }
+        else if (!side.empty() || symbol != blank_)
+        {
+            side.push_back(Run{symbol, count});
+        }
+    }
+
+    uint8_t pop(std::vector<Run> &side)
+    {
+        if (side.empty())
+        {
+            return blank_;
+        }
+        uint8_t symbol = side.back().symbol;
+        if (--side.back().count == 0)
+        {
+            side.pop_back();
+        }
+        return symbol;
+    }
+
+    void notePeak()
+    {
+        peak_runs_ = std::max(peak_runs_, left_.size() + right_.size());
+    }
+
+    template <typename Transition>
+    static bool loops(const Transition &rule, int32_t state, int move)
+    {
+        return rule.next_state == state && rule.move == move;
+    }
+
+public:
+    void reset(const std::vector<uint8_t> &input, uint8_t blank)
+    {
+        left_.clear();
+        right_.clear();
+        blank_ = blank;
+        head_ = 0;
+        for (auto it = input.rbegin(); it != input.rend(); ++it)
+        {
+            push(right_, *it, 1);
+        }
+        current_ = pop(right_);
+        notePeak();
+    }
+
+    uint8_t read() const
+    {
+        return current_;
+    }
+
+    long long head() const
+    {
+        return head_;
+    }
+
+    // Writes the head cell and moves one cell (move is +1, -1, or 0 to stay)
+    void step(uint8_t write, int move)
+    {
+        if (move == 0)
+        {
+            current_ = write;
+            return;
+        }
+        if (move > 0)
+        {
+            push(left_, write, 1);
+            current_ = pop(right_);
+        }
+        else
+        {
+            push(right_, write, 1);
+            current_ = pop(left_);
+        }
+        head_ += move;
+        notePeak();
+    }
+
+    /*
+      Runs a self-loop of `state` from the head cell onwards, for at most `limit` (>= 1) steps.
+      `row` is the transition table row of that state; the sweep continues over whole runs while
+      their transition loops back to `state` in the same direction, and over the blank tape
+      beyond them in chunks of kBlankChunk cells. Returns the number of steps taken.
+     */
+    template <typename Transition>
+    uint64_t sweep(const Transition *row, int32_t state, int move, uint64_t limit)
+    {
+        std::vector<Run> &ahead = move > 0 ? right_ : left_;
+        std::vector<Run> &behind = move > 0 ? left_ : right_;
+
+        uint64_t cells = 1;
+        push(behind, row[current_].write, 1);
+        while (cells < limit)
+        {
+            if (ahead.empty())
+            {
+                if (loops(row[blank_], state, move))
+                {
+                    const uint64_t blanks = std::min(limit - cells, kBlankChunk);
+                    push(behind, row[blank_].write, blanks);
+                    cells += blanks;
+                }
+                break;
+            }
+            const Run run = ahead.back();
+            if (!loops(row[run.symbol], state, move))
+            {
+                break;
+            }
+            const uint64_t taken = std::min(run.count, limit - cells);
+            push(behind, row[run.symbol].write, taken);
+            cells += taken;
+            if (taken == run.count)
+            {
+                ahead.pop_back();
+            }
+            else
+            {
+                ahead.back().count -= taken;
+            }
+        }
+        current_ = pop(ahead);
+        head_ += move * static_cast<long long>(cells);
+        notePeak();
+        return cells;
+    }
+
+    // Whether the sweep sweep() would start never ends: every run ahead and the blank loop back
+    template <typename Transition>
+    bool sweepsForever(const Transition *row, int32_t state, int move) const
+    {
+        const std::vector<Run> &ahead = move > 0 ? right_ : left_;
+        for (const Run &run : ahead)
+        {
+            if (!loops(row[run.symbol], state, move))
+            {
+                return false;
+            }
+        }
+        return loops(row[blank_], state, move);
+    }
+
+    // Same layout as Tape::contents(): from the leftmost non-blank cell (or position 0) to the rightmost non-blank cell
+    std::vector<uint8_t> contents(const uint8_t *decode = nullptr) const
+    {
+        std::vector<Run> runs(left_.begin(), left_.end());
+        runs.push_back(Run{current_, 1});
+        runs.insert(runs.end(), right_.rbegin(), right_.rend());
+        if (decode)
+        {
+            for (Run &run : runs)
+            {
+                run.symbol = decode[run.symbol];
+            }
+        }
+
+        long long position = head_;
+        for (const Run &run : left_)
+        {
+            position -= static_cast<long long>(run.count);
+        }
+        long long first_symbol = position;
+        long long first = 0, last = -1;
+        bool found = false;
+        for (const Run &run : runs)
+        {
+            if (run.symbol != blank_)
+            {
+                if (!found)
+                {
+                    first = position;
+                    found = true;
+                }
+                last = position + static_cast<long long>(run.count) - 1;
+            }
+            position += static_cast<long long>(run.count);
+        }
+        if (!found)
+        {
+            return {};
+        }
+        first = std::min(first, 0LL);
+
+        std::vector<uint8_t> cells;
+        cells.reserve(static_cast<size_t>(last - first + 1));
+        for (long long i = first; i < first_symbol && i <= last; ++i)
+        {
+            cells.push_back(blank_);
+        }
+        position = first_symbol;
+        for (const Run &run : runs)
+        {
+            for (uint64_t i = 0; i < run.count; ++i, ++position)
+            {
+                if (position >= first && position <= last)
+                {
+                    cells.push_back(run.symbol);
+                }
+            }
+        }
+        return cells;
+    }
+
+    size_t peakRuns() const
+    {
+        return peak_runs_;
+    }
+
+    // Same head position and same contents; the runs are kept merged, so equal tapes have equal runs
+    bool sameAs(const RunLengthTape &other) const
+    {
+        return head_ == other.head_ && current_ == other.current_ && left_ == other.left_ && right_ == other.right_;
+    }
+};
+
+// Why a run was found never to halt
+enum class LoopProof
+{
+    None,
+    BlankSweep, // a self-loop sweeps over the blank tape forever
+    Repeat,     // a configuration came back exactly
+    Translated  // a configuration came back shifted along the tape
+};
+
+/*
+  Proves that a run of the plain engine never halts, at a bounded cost per step.
+
+  Repeated configurations: the tape is hashed incrementally as the sum of a pseudo-random key
+  per non-blank (position, symbol) pair, so a write costs two key evaluations and the blank
+  tape hashes to 0. As in Brent's algorithm, the configuration at steps 1, 2, 4, 8, ... is
+  kept as a checkpoint and every later step compares (state, head, hash) with it in O(1); a
+  match is confirmed against a snapshot of the checkpoint tape before it counts as a proof.
+  Snapshots cost O(tape), but they are taken at exponentially spaced steps.
+
+  Translated cycles: a machine that drifts forever along the blank tape never repeats a
+  configuration. When the head reaches a new rightmost cell past the input, everything to its
+  right is blank. If two such moments t1 < t2 are in the same state and the tape from the
+  lowest cell visited in between up to the head at t1 reappears at t2, shifted by the distance
+  the head moved, then the steps from t1 to t2 repeat forever, shifted each time. Leftward
+  drift is handled the same way, and record checkpoints are spaced by the same doubling.
+ */
+class CycleDetector
+{
+public:
+    void reset(const Tape &tape, uint8_t blank, long long input_size)
+    {
+        blank_ = blank;
+        input_end_ = input_size - 1;
+        hash_ = 0;
+        for (long long position = 0; position < input_size; ++position)
+        {
+            hash_ += key(position, tape.at(position));
+        }
+        leftmost_ = 0;
+        rightmost_ = 0;
+        exact_ = Checkpoint();
+        right_ = Checkpoint();
+        left_ = Checkpoint();
+        next_exact_ = 1;
+        proof_ = LoopProof::None;
+        period_ = 0;
+    }
+
+    // Called before a write replaces `old_symbol` at `position`
+    void write(long long position, uint8_t old_symbol, uint8_t new_symbol)
+    {
+        if (old_symbol != new_symbol)
+        {
+            hash_ += key(position, new_symbol) - key(position, old_symbol);
+        }
+    }
+
+    // Called after every step with the configuration reached; true once the run is proven not to halt
+    bool step(const Tape &tape, int32_t state, long long position, uint64_t steps)
+    {
+        right_.extreme = std::min(right_.extreme, position);
+        left_.extreme = std::max(left_.extreme, position);
+        if (position > rightmost_)
+        {
+            rightmost_ = position;
+            if (position >= input_end_ && drifts(right_, tape, state, position, steps, 1))
+            {
+                return true;
+            }
+        }
+        else if (position < leftmost_)
+        {
+            leftmost_ = position;
+            if (drifts(left_, tape, state, position, steps, -1))
+            {
+                return true;
+            }
+        }
+
+        if (state == exact_.state && position == exact_.position && hash_ == exact_.hash && exact_.valid &&
+            sameTape(tape, 0))
+        {
+            proof_ = LoopProof::Repeat;
+            period_ = steps - exact_.steps;
+            return true;
+        }
+        if (steps >= next_exact_)
+        {
+            take(exact_, tape, state, position, steps);
+            next_exact_ = steps * 2;
+        }
+        return false;
+    }
+
+    LoopProof proof() const
+    {
+        return proof_;
+    }
+
+    // Steps between two occurrences of the repeating configuration
+    uint64_t period() const
+    {
+        return period_;
+    }
+
+private:
+    struct Checkpoint
+    {
+        bool valid = false;
+        int32_t state = -1;
+        long long position = 0;
+        uint64_t hash = 0;
+        uint64_t steps = 0;
+        uint64_t next = 1;            // step count after which the next record checkpoint is taken
+        long long extreme = 0;        // farthest cell from the drift direction visited since taken
+        long long first = 0;          // position of snapshot[0]
+        std::vector<uint8_t> snapshot;
+
+        uint8_t at(long long position, uint8_t blank) const
+        {
+            long long index = position - first;
+            return index >= 0 && index < static_cast<long long>(snapshot.size()) ? snapshot[index] : blank;
+        }
+    };
+
+    uint8_t blank_ = 0;
+    long long input_end_ = 0;
+    uint64_t hash_ = 0;
+    long long leftmost_ = 0;
+    long long rightmost_ = 0;
+    Checkpoint exact_;
+    Checkpoint right_;
+    Checkpoint left_;
+    uint64_t next_exact_ = 1;
+    LoopProof proof_ = LoopProof::None;
+    uint64_t period_ = 0;
+
+    uint64_t key(long long position, uint8_t symbol) const
+    {
+        if (symbol == blank_)
+        {
+            return 0;
+        }
+        uint64_t mixed = static_cast<uint64_t>(position) * 0x9E3779B97F4A7C15ULL + (symbol + 1) * 0xD6E8FEB86659FD93ULL;
+        mixed ^= mixed >> 32;
+        mixed *= 0xD6E8FEB86659FD93ULL;
+        mixed ^= mixed >> 32;
+        return mixed;
+    }
+
+    void take(Checkpoint &checkpoint, const Tape &tape, int32_t state, long long position, uint64_t steps)
+    {
+        checkpoint.valid = true;
+        checkpoint.state = state;
+        checkpoint.position = position;
+        checkpoint.hash = hash_;
+        checkpoint.steps = steps;
+        checkpoint.extreme = position;
+        checkpoint.first = tape.firstPosition();
+        checkpoint.snapshot.resize(static_cast<size_t>(tape.lastPosition() - tape.firstPosition() + 1));
+        for (long long i = tape.firstPosition(); i <= tape.lastPosition(); ++i)
+        {
+            checkpoint.snapshot[i - checkpoint.first] = tape.at(i);
+        }
+    }
+
+    // True if the whole tape equals the exact checkpoint's snapshot shifted by `shift`
+    bool sameTape(const Tape &tape, long long shift) const
+    {
+        long long first = std::min(exact_.first + shift, tape.firstPosition());
+        long long last = std::max(exact_.first + static_cast<long long>(exact_.snapshot.size()) - 1 + shift,
+                                  tape.lastPosition());
+        for (long long i = first; i <= last; ++i)
+        {
+            if (tape.at(i) != exact_.at(i - shift, blank_))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Handles a new record cell in direction `direction` (+1 right, -1 left)
+    bool drifts(Checkpoint &record, const Tape &tape, int32_t state, long long position, uint64_t steps,
+                int direction)
+    {
+        if (record.valid && record.state == state)
+        {
+            const long long shift = position - record.position;
+            // Compare from the head backwards: a mismatch usually shows up close to the head
+            bool same = true;
+            for (long long i = record.position; same && (i - record.extreme) * direction >= 0; i -= direction)
+            {
+                same = tape.at(i + shift) == record.at(i, blank_);
+            }
+            if (same)
+            {
+                proof_ = LoopProof::Translated;
+                period_ = steps - record.steps;
+                return true;
+            }
+        }
+        if (steps >= record.next)
+        {
+            take(record, tape, state, position, steps);
+            record.next = steps * 2;
+        }
+        return false;
+    }
+};
+
+/*
+  Step and wall-clock limits of one run. The engines only call exhausted() once the step count
+  reaches next(), so the clock is read once every kInterval steps and an unlimited run pays a
+  single comparison per step.
+ */
+class StepBudget
+{
+public:
+    // 0 means no limit
+    StepBudget(uint64_t max_steps, double seconds) : max_steps_(max_steps), timed_(seconds > 0)
+    {
+        if (timed_)
+        {
+            deadline_ = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+        }
+        next_ = max_steps_ > 0 ? std::min(kInterval, max_steps_) : kInterval;
+    }
+
+    uint64_t next() const
+    {
+        return next_;
+    }
+
+    // True once `steps` steps use up the budget; otherwise schedules the next check
+    bool exhausted(uint64_t steps)
+    {
+        if ((max_steps_ > 0 && steps >= max_steps_) || (timed_ && std::chrono::steady_clock::now() >= deadline_))
+        {
+            return true;
+        }
+        next_ = steps + kInterval;
+        if (max_steps_ > 0)
+        {
+            next_ = std::min(next_, max_steps_);
+        }
+        return false;
+    }
+
+private:
+    static constexpr uint64_t kInterval = 1 << 20;
+
+    uint64_t max_steps_;
+    bool timed_;
+    std::chrono::steady_clock::time_point deadline_;
+    uint64_t next_ = 0;
+};
+
+/*
+  Interface between the simulator and a machine compiled to native code (see
+  TuringMachine::writeNativeSource). The generated source declares the same struct; the
+  library exports turing_native_abi so that a stale library is refused instead of misread.
+ */
+struct NativeRun
+{
+    uint8_t *cells;    // tape buffer, edge sentinels included
+    long long head;    // buffer index of the head
+    int32_t state;
+    uint64_t steps;
+    uint64_t limit;    // step count at which check() is called
+    void *context;
+    long long (*grow)(void *context, long long head, uint8_t **cells); // head stands on a sentinel
+    uint64_t (*check)(void *context, uint64_t steps);                  // next limit, 0 to stop the run
+};
+
+// Returns 0 if the run halted, 1 if no rule applied, 2 if check() stopped it
+using NativeEntry = int (*)(NativeRun *run);
+
+static constexpr int kNativeAbi = 1;
+
+// A shared library loaded with dlopen, closed on destruction
+class NativeLibrary
+{
+private:
+    void *handle_ = nullptr;
+
+public:
+    NativeLibrary() = default;
+    NativeLibrary(const NativeLibrary &) = delete;
+    NativeLibrary &operator=(const NativeLibrary &) = delete;
+
+    ~NativeLibrary()
+    {
+        close();
+    }
+
+    bool open(const std::string &path, std::string &error)
+    {
+        close();
+        handle_ = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle_)
+        {
+            error = dlerror();
+            return false;
+        }
+        return true;
+    }
+
+    void *symbol(const char *name) const
+    {
+        return handle_ ? dlsym(handle_, name) : nullptr;
+    }
+
+    void close()
+    {
+        if (handle_)
+        {
+            dlclose(handle_);
+            handle_ = nullptr;
+        }
+    }
+};
+
+/*
+  TuringMachine class for simulating a Turing Machine
+ 
+  The input file must follow this format:
+  [states]
+  state_1 value
+  state_2 value
+  (value refers to S for start_state, F for final_state, or anything else for intermediate states usually 0)
+  there can only be one start state, but if there are multiple states marked with S, the last one will be considered the start state;
+  there can only be one final state, but if there are multiple states marked with F, the last one will be considered the final state;
+  if a state is both a start and final state, it must be set separately, not on the same line)
+  ...
+ 
+  [sigma]
+  letter_1
+  letter_2
+  ...
+ 
+  [rules]
+  state_1 letter state_2 letter direction (the first rule must have the start state as the first state)
+  state_3 letter state_4 letter direction (direction MUST be R, L or S to stay)
+  ...
+
+  A machine with several tapes declares their number, at most kMaxTapes:
+  [tapes]
+  2
+  and its rules read, write and move on every tape at once, each tuple separated by commas:
+  state_1 letter,letter state_2 letter,letter direction,direction
+  The input is written on the first tape, the others start blank, and the result is the first tape.
+
+  Before running, the rules are compiled into a dense [state][symbol] table: states and
+  tape symbols are interned into small integers, so every step is a single indexed load.
+  When several rules match the same state and symbol, the first one in the file wins.
+  The tape is unbounded in both directions (see Tape) and blank cells hold '*'.
+
+  Multi-tape rules are compiled into an open addressing index keyed by the state and the
+  symbols under all heads packed into one 64-bit word, so a step is still one lookup.
+  compileTracks() can instead turn a multi-tape machine into an equivalent single-tape one,
+  to compare the two on the same input: it pays the usual quadratic slowdown, but every
+  single-tape option (--macro, --detect-loops, --trace) then applies.
+ */
+class TuringMachine
+{
+public:
+    static constexpr char kBlank = '*';
+    static constexpr int32_t kNoRule = -1;
+    static constexpr int32_t kGrowTape = -2;
+    static constexpr size_t kMaxTapes = 8;
+
+    // One cell of the compiled transition table
+    struct Transition
+    {
+        int32_t next_state; // kNoRule if no rule is defined, kGrowTape on the tape edge
+        uint8_t write;      // interned symbol to write
+        int8_t move;        // +1 for R, -1 for L, 0 for S
+    };
+
+    // A compiled rule of a multi-tape machine
+    struct MultiTransition
+    {
+        int32_t next_state;
+        std::array<uint8_t, kMaxTapes> write; // interned symbol to write on each tape
+        std::array<int8_t, kMaxTapes> move;
+    };
+
+    // How a single execution ended
+    struct RunResult
+    {
+        enum class Outcome
+        {
+            Halted,         // reached the final state
+            NoRule,         // no rule for the current state and symbol
+            NeverHalts,     // proven not to halt, see proof
+            BudgetExceeded  // stopped by the step or time budget
+        };
+
+        Outcome outcome = Outcome::Halted;
+        LoopProof proof = LoopProof::None;
+        uint64_t period = 0;  // steps between repetitions of a proven loop
+        uint64_t symbols = 0; // multi-tape: the symbol under the head of tape t in byte t
+        int32_t state = 0;    // state the machine stopped in
+        uint8_t symbol = 0;   // symbol under the head when it stopped
+        uint64_t steps = 0;
+        std::vector<uint8_t> tape; // the first tape of a multi-tape machine
+        size_t peak_footprint = 0; // cells for the plain engine (on all tapes), runs for the accelerated one
+        size_t peak_bytes = 0;
+    };
+
+    // One traced step: the configuration the machine was in before applying a rule
+    struct TraceRecord
+    {
+        uint64_t step;     // steps executed before this one; a sweep of the accelerated engine is one record
+        long long position; // head position, 0 being the first input cell
+        int32_t state;
+        uint8_t symbol;    // symbol under the head
+    };
+
+    using Trace = TraceRing<TraceRecord>;
+
+private:
+    // A rule as loaded: names are interned while the file is parsed
+    struct RuleSpec
+    {
+        int32_t from;  // state ids
+        int32_t to;
+        int32_t read;  // ids of the symbol and direction tokens as written in the file
+        int32_t write;
+        int32_t move;
+    };
+
+    // Slot of the multi-tape rule index
+    struct MultiSlot
+    {
+        uint64_t reads;      // symbol read on tape t in byte t
+        int32_t state;       // kNoRule if the slot is unused
+        int32_t transition;  // index into multi_transitions_
+    };
+
+    NameTable state_table_;                          // every state named in [states] or [rules]
+    std::vector<char> declared_;                     // state id -> listed in [states]
+    size_t declared_count_ = 0;
+    std::unordered_set<char> sigma_;
+    NameTable token_table_;                          // symbol and direction tokens of the rules
+    std::vector<RuleSpec> rules_;
+    size_t tape_count_ = 1;
+    int32_t start_state_ = NameTable::kMissing;
+    int32_t final_state_ = NameTable::kMissing;
+
+    // Compiled representation, built by compile() or mapped from a binary image by loadImage()
+    std::vector<char> symbol_chars_;                 // symbol id -> tape character
+    std::array<int16_t, 256> symbol_ids_{};          // tape character -> symbol id, -1 if unknown
+    ArrayView<Transition> table_;                    // state id * symbol count + symbol id
+    StringTable state_names_;                        // state id -> name
+    std::vector<Transition> compiled_table_;         // what table_ and state_names_ view after compile()
+    PackedStrings compiled_state_names_;
+    std::vector<MultiTransition> multi_transitions_; // what multi_slots_ point to
+    std::vector<MultiSlot> multi_slots_;
+    bool tracks_ = false;                            // run a multi-tape machine on one tape
+    std::vector<uint8_t> track_decode_;              // single-tape symbol -> symbol on the first simulated tape
+    MachineImage image_;
+    bool from_image_ = false;
+    bool native_ = false;                            // run on code generated for this machine
+    NativeLibrary native_library_;
+    NativeEntry native_entry_ = nullptr;
+    uint8_t edge_id_ = 0;                            // tape edge sentinel, last column of the table
+    int32_t start_id_ = 0;
+    int32_t final_id_ = 0;
+    OutputLevel output_level_ = OutputLevel::Verdict;
+    size_t trace_capacity_ = 1 << 16;
+    bool accelerated_ = false;
+    uint64_t step_budget_ = 0;                       // 0 for no limit
+    double time_budget_ = 0;                         // seconds, 0 for no limit
+    bool detect_loops_ = false;
+    std::string profile_path_;                       // prefix of the profile reports, empty if not profiling
+
+    // Helper function to split a string into tokens
+    std::vector<std::string> split(const std::string &s) const
+    {
+        std::vector<std::string> tokens;
+        std::stringstream ss(s);
+        std::string token;
+        while (ss >> token)
+        {
+            tokens.push_back(token);
+        }
+        return tokens;
+    }
+
+    static size_t multiHash(int32_t state, uint64_t reads)
+    {
+        uint64_t key = reads ^ (static_cast<uint64_t>(static_cast<uint32_t>(state)) * 0x9E3779B97F4A7C15ULL);
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+
+    // Slot holding the rule for (state, reads), or the unused slot where it belongs
+    size_t findMultiSlot(int32_t state, uint64_t reads) const
+    {
+        const size_t mask = multi_slots_.size() - 1;
+        size_t slot = multiHash(state, reads) & mask;
+        while (multi_slots_[slot].state != kNoRule &&
+               (multi_slots_[slot].state != state || multi_slots_[slot].reads != reads))
+        {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    // Sections of a binary image of the machine
+    enum ImageSection : uint32_t
+    {
+        kImageInfo = 1,
+        kImageSymbols,      // symbol id -> tape character, without the edge sentinel
+        kImageSigma,
+        kImageTable,
+        kImageStateOffsets,
+        kImageStateBytes
+    };
+
+    struct ImageInfo
+    {
+        uint32_t state_count;
+        uint32_t symbol_count; // the edge sentinel is symbol `symbol_count`
+        int32_t start;
+        int32_t final;
+    };
+
+    bool isValidState(int32_t state) const
+    {
+        return static_cast<size_t>(state) < declared_.size() && declared_[state];
+    }
+
+    bool isValidSymbol(char symbol) const
+    {
+        return sigma_.find(symbol) != sigma_.end();
+    }
+
+    bool isValidDirection(std::string_view dir) const
+    {
+        return dir == "R" || dir == "L" || dir == "S";
+    }
+
+    static int8_t moveOf(std::string_view dir)
+    {
+        return dir == "R" ? 1 : (dir == "L" ? -1 : 0);
+    }
+
+    // Splits a multi-tape rule token "a,b,c" into at most `max` parts; returns the number of parts
+    static size_t splitTuple(std::string_view token, std::string_view *parts, size_t max)
+    {
+        size_t count = 0;
+        while (true)
+        {
+            size_t comma = token.find(',');
+            if (count < max)
+            {
+                parts[count] = token.substr(0, comma);
+            }
+            ++count;
+            if (comma == std::string_view::npos)
+            {
+                return count;
+            }
+            token.remove_prefix(comma + 1);
+        }
+    }
+
+    // True if `token` holds one valid symbol (or direction) per tape
+    bool isValidTuple(const std::string &token, bool directions) const
+    {
+        std::string_view parts[kMaxTapes];
+        if (splitTuple(token, parts, kMaxTapes) != tape_count_)
+        {
+            return false;
+        }
+        for (size_t tape = 0; tape < tape_count_; ++tape)
+        {
+            if (directions ? !isValidDirection(parts[tape]) : parts[tape].size() != 1 || !isValidSymbol(parts[tape][0]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int32_t declareState(std::string_view name)
+    {
+        int32_t state = state_table_.intern(name);
+        if (declared_.size() <= static_cast<size_t>(state))
+        {
+            declared_.resize(state + 1, 0);
+        }
+        if (!declared_[state])
+        {
+            declared_[state] = 1;
+            ++declared_count_;
+        }
+        return state;
+    }
+
+    int16_t internSymbol(char c)
+    {
+        unsigned char key = static_cast<unsigned char>(c);
+        if (symbol_ids_[key] < 0)
+        {
+            symbol_ids_[key] = static_cast<int16_t>(symbol_chars_.size());
+            symbol_chars_.push_back(c);
+        }
+        return symbol_ids_[key];
+    }
+
+public:
+    // Maps the file and tokenizes it in place; only names seen for the first time are copied
+    bool loadFromFile(const std::string &filename)
+    {
+        auto started = std::chrono::steady_clock::now();
+        MappedFile file;
+        if (!file.open(filename))
+        {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        if (MachineImage::isImage(file.contents()))
+        {
+            file.close();
+            return loadImage(filename);
+        }
+
+        DefinitionScanner scanner(file.contents());
+        std::string_view line;
+        std::string_view section;
+        std::string_view current_section;
+        std::string_view parts[5];
+
+        while (scanner.next(line))
+        {
+            if (DefinitionScanner::isSection(line, section))
+            {
+                current_section = trimView(section);
+            }
+            else if (current_section == "states")
+            {
+                if (splitTokens(line, parts, 2) == 2)
+                {
+                    int32_t state = declareState(parts[0]);
+                    if (parts[1] == "S")
+                    {
+                        start_state_ = state;
+                    }
+                    else if (parts[1] == "F")
+                    {
+                        final_state_ = state;
+                    }
+                }
+                else
+                {
+                    std::cerr << "Invalid state definition: " << line << std::endl;
+                    return false;
+                }
+            }
+            else if (current_section == "tapes")
+            {
+                size_t count = 0;
+                for (char c : line)
+                {
+                    count = c >= '0' && c <= '9' && count <= kMaxTapes ? count * 10 + (c - '0') : kMaxTapes + 1;
+                }
+                if (count < 1 || count > kMaxTapes)
+                {
+                    std::cerr << "Invalid number of tapes (1 to " << kMaxTapes << "): " << line << std::endl;
+                    return false;
+                }
+                tape_count_ = count;
+            }
+            else if (current_section == "sigma")
+            {
+                if (line.length() == 1)
+                {
+                    sigma_.insert(line[0]);
+                }
+                else
+                {
+                    std::cerr << "Invalid sigma symbol: " << line << std::endl;
+                    return false;
+                }
+            }
+            else if (current_section == "rules")
+            {
+                if (splitTokens(line, parts, 5) == 5)
+                {
+                    rules_.push_back(RuleSpec{state_table_.intern(parts[0]), state_table_.intern(parts[2]),
+                                              token_table_.intern(parts[1]), token_table_.intern(parts[3]),
+                                              token_table_.intern(parts[4])});
+                }
+                else
+                {
+                    std::cerr << "Invalid rule definition: " << line << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        if (output_level_ != OutputLevel::Verdict)
+        {
+            auto finished = std::chrono::steady_clock::now();
+            reportLoad(filename, file.size(), std::chrono::duration<double>(finished - started).count());
+        }
+        return true;
+    }
+
+    // Maps a binary image written by emitImage(); the machine then runs on the mapped tables
+    bool loadImage(const std::string &filename)
+    {
+        auto started = std::chrono::steady_clock::now();
+        std::string error;
+        if (!image_.open(filename, MachineImage::kTuringMachine, error))
+        {
+            std::cerr << "Invalid machine image " << filename << ": " << error << std::endl;
+            return false;
+        }
+
+        ArrayView<ImageInfo> info = image_.array<ImageInfo>(kImageInfo);
+        ArrayView<char> symbols = image_.array<char>(kImageSymbols);
+        ArrayView<char> sigma = image_.array<char>(kImageSigma);
+        table_ = image_.array<Transition>(kImageTable);
+        state_names_ = StringTable(image_.array<uint32_t>(kImageStateOffsets), image_.array<char>(kImageStateBytes));
+        if (info.size() != 1 || symbols.size() != info[0].symbol_count || symbols.size() >= 256 ||
+            table_.size() != static_cast<size_t>(info[0].state_count) * (symbols.size() + 1) ||
+            state_names_.size() != info[0].state_count || !state_names_.isConsistent() ||
+            info[0].start < 0 || static_cast<uint32_t>(info[0].start) >= info[0].state_count ||
+            info[0].final < 0 || static_cast<uint32_t>(info[0].final) >= info[0].state_count)
+        {
+            std::cerr << "Invalid machine image " << filename << ": inconsistent tables" << std::endl;
+            return false;
+        }
+        // Every rule must lead to a state and write a symbol that exist, and only the edge column grows the tape
+        const size_t symbol_count = symbols.size() + 1;
+        for (size_t cell = 0; cell < table_.size(); ++cell)
+        {
+            const Transition &rule = table_[cell];
+            const bool edge = cell % symbol_count == symbols.size();
+            const bool valid = edge ? rule.next_state == kGrowTape && rule.write == symbols.size() && rule.move == 0
+                                    : rule.next_state == kNoRule ||
+                                          (rule.next_state >= 0 && static_cast<uint32_t>(rule.next_state) < info[0].state_count &&
+                                           rule.write < symbols.size() && rule.move >= -1 && rule.move <= 1);
+            if (!valid)
+            {
+                std::cerr << "Invalid machine image " << filename << ": rule out of range" << std::endl;
+                return false;
+            }
+        }
+
+        symbol_chars_.assign(symbols.begin(), symbols.end());
+        symbol_ids_.fill(-1);
+        for (size_t symbol = 0; symbol < symbol_chars_.size(); ++symbol)
+        {
+            symbol_ids_[static_cast<unsigned char>(symbol_chars_[symbol])] = static_cast<int16_t>(symbol);
+        }
+        sigma_.insert(sigma.begin(), sigma.end());
+        edge_id_ = static_cast<uint8_t>(symbols.size());
+        start_id_ = info[0].start;
+        final_id_ = info[0].final;
+        from_image_ = true;
+
+        if (output_level_ != OutputLevel::Verdict)
+        {
+            auto finished = std::chrono::steady_clock::now();
+            reportLoad(filename, image_.size(), std::chrono::duration<double>(finished - started).count());
+        }
+        return true;
+    }
+
+    // Validates and compiles the machine, then writes it as a binary image that loads without parsing
+    bool emitImage(const std::string &path)
+    {
+        if (tape_count_ > 1)
+        {
+            std::cerr << "Binary images hold single-tape machines only." << std::endl;
+            return false;
+        }
+        if (!from_image_ && !isValidAutomaton())
+        {
+            std::cerr << "Invalid automaton. Please check the input file." << std::endl;
+            return false;
+        }
+        if (!from_image_ && !compile())
+        {
+            return false;
+        }
+
+        ImageInfo info{static_cast<uint32_t>(state_names_.size()), static_cast<uint32_t>(symbol_chars_.size()),
+                       start_id_, final_id_};
+        std::vector<char> sigma(sigma_.begin(), sigma_.end());
+        std::sort(sigma.begin(), sigma.end());
+
+        ImageWriter writer(MachineImage::kTuringMachine);
+        writer.add(kImageInfo, ArrayView<ImageInfo>(&info, 1));
+        writer.add(kImageSymbols, ArrayView<char>(symbol_chars_));
+        writer.add(kImageSigma, ArrayView<char>(sigma));
+        writer.add(kImageTable, table_);
+        writer.add(kImageStateOffsets, kImageStateBytes, state_names_);
+        if (!writer.write(path))
+        {
+            std::cerr << "Error writing file: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Validates and compiles the machine, then writes it as C++ source (see writeNativeSource)
+    bool emitNativeSource(const std::string &path)
+    {
+        if (!from_image_ && !isValidAutomaton())
+        {
+            std::cerr << "Invalid automaton. Please check the input file." << std::endl;
+            return false;
+        }
+        if (!from_image_ && !compile())
+        {
+            return false;
+        }
+        return writeNativeSource(path);
+    }
+
+    /*
+      Generates C++ for the compiled machine, builds it as a shared library with the system
+      compiler ($CXX, or c++) and loads it; runs then go through executeNative(). Call after
+      compile(). The source and the library are temporary files, removed once loaded.
+     */
+    bool loadNative()
+    {
+        auto started = std::chrono::steady_clock::now();
+        // A private directory (mode 0700, unpredictable name), so no other user can plant or swap
+        // the files between writing, compiling and loading them
+        std::string directory = (std::filesystem::temp_directory_path() / "turing-native-XXXXXX").string();
+        if (!mkdtemp(&directory[0]))
+        {
+            std::cerr << "Cannot create a directory for native code in " << std::filesystem::temp_directory_path() << std::endl;
+            return false;
+        }
+        const std::string source = directory + "/machine.cpp";
+        const std::string library = directory + "/machine.so";
+        std::error_code ignored;
+        if (!writeNativeSource(source))
+        {
+            std::filesystem::remove_all(directory, ignored);
+            return false;
+        }
+
+        const char *compiler = std::getenv("CXX");
+        const std::string command = std::string(compiler && *compiler ? compiler : "c++") + " -O1 -shared -fPIC -o '" +
+                                    library + "' '" + source + "'";
+        if (std::system(command.c_str()) != 0)
+        {
+            std::cerr << "Native compilation failed, source kept in " << source << ": " << command << std::endl;
+            return false;
+        }
+
+        std::string error;
+        const bool opened = native_library_.open(library, error);
+        std::filesystem::remove_all(directory, ignored);
+        if (!opened)
+        {
+            std::cerr << "Cannot load native code: " << error << std::endl;
+            return false;
+        }
+        const int *abi = static_cast<const int *>(native_library_.symbol("turing_native_abi"));
+        native_entry_ = reinterpret_cast<NativeEntry>(native_library_.symbol("turing_native_run"));
+        if (!abi || *abi != kNativeAbi || !native_entry_)
+        {
+            std::cerr << "Cannot load native code: interface mismatch" << std::endl;
+            native_entry_ = nullptr;
+            return false;
+        }
+
+        if (output_level_ != OutputLevel::Verdict)
+        {
+            auto finished = std::chrono::steady_clock::now();
+            std::cerr << "Compiled " << state_names_.size() << " states to native code in "
+                      << std::chrono::duration<double>(finished - started).count() << " s" << std::endl;
+        }
+        return true;
+    }
+
+    bool isValidAutomaton() const
+    {
+        if (declared_count_ == 0 || sigma_.empty() || rules_.empty())
+        {
+            std::cerr << "The automaton must have states, sigma, and rules defined." << std::endl;
+            return false;
+        }
+        if (start_state_ == NameTable::kMissing)
+        {
+            std::cerr << "Start state is not defined or is invalid." << std::endl;
+            return false;
+        }
+        if (final_state_ == NameTable::kMissing)
+        {
+            std::cerr << "Final state is not defined or is invalid." << std::endl;
+            return false;
+        }
+        for (const auto &rule : rules_)
+        {
+            const bool valid_tokens =
+                tape_count_ == 1
+                    ? isValidSymbol(token_table_.name(rule.read)[0]) && isValidSymbol(token_table_.name(rule.write)[0]) &&
+                          isValidDirection(token_table_.name(rule.move))
+                    : isValidTuple(token_table_.name(rule.read), false) &&
+                          isValidTuple(token_table_.name(rule.write), false) &&
+                          isValidTuple(token_table_.name(rule.move), true);
+            if (!isValidState(rule.from) || !isValidState(rule.to) || !valid_tokens)
+            {
+                std::cerr << "Invalid rule: " << state_table_.name(rule.from) << " " << token_table_.name(rule.read) << " "
+                          << state_table_.name(rule.to) << " " << token_table_.name(rule.write) << " "
+                          << token_table_.name(rule.move) << std::endl;
+                return false;
+            }
+        }
+        if (rules_.empty() || rules_[0].from != start_state_)
+        {
+            std::cerr << "The first rule must start from the start state." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Interns the tape symbols and builds the dense transition table (the rule index for several tapes);
+    // call after isValidAutomaton()
+    bool compile()
+    {
+        symbol_chars_.clear();
+        symbol_ids_.fill(-1);
+        internSymbol(kBlank);
+        for (char symbol : sigma_)
+        {
+            internSymbol(symbol);
+        }
+
+        if (symbol_chars_.size() >= 256)
+        {
+            std::cerr << "Too many tape symbols (at most 255 are supported)." << std::endl;
+            return false;
+        }
+
+        compiled_state_names_.clear();
+        for (size_t state = 0; state < state_table_.size(); ++state)
+        {
+            compiled_state_names_.add(state_table_.name(static_cast<int32_t>(state)));
+        }
+        state_names_ = compiled_state_names_.view();
+        start_id_ = start_state_;
+        final_id_ = final_state_;
+        if (tape_count_ > 1)
+        {
+            compileMultiTape();
+            return !tracks_ || compileTracks();
+        }
+
+        edge_id_ = static_cast<uint8_t>(symbol_chars_.size());
+        const size_t symbol_count = symbol_chars_.size() + 1;
+        // A rule names its symbols and direction with tokens, of which there are only a few
+        std::vector<uint8_t> token_symbols(token_table_.size());
+        std::vector<int8_t> token_moves(token_table_.size());
+        for (size_t token = 0; token < token_table_.size(); ++token)
+        {
+            const std::string &name = token_table_.name(static_cast<int32_t>(token));
+            token_symbols[token] = static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(name[0])]);
+            token_moves[token] = moveOf(name);
+        }
+
+        compiled_table_.assign(state_table_.size() * symbol_count, Transition{kNoRule, 0, 0});
+        for (size_t state = 0; state < state_table_.size(); ++state)
+        {
+            compiled_table_[state * symbol_count + edge_id_] = Transition{kGrowTape, edge_id_, 0};
+        }
+        for (const auto &rule : rules_)
+        {
+            Transition &cell = compiled_table_[rule.from * symbol_count + token_symbols[rule.read]];
+            if (cell.next_state != kNoRule)
+            {
+                continue; // an earlier rule already matches this state and symbol
+            }
+            cell.next_state = rule.to;
+            cell.write = token_symbols[rule.write];
+            cell.move = token_moves[rule.move];
+        }
+        table_ = compiled_table_;
+        return true;
+    }
+
+private:
+    // Builds the multi-tape rule index; the first rule for a state and tuple of symbols wins
+    void compileMultiTape()
+    {
+        edge_id_ = static_cast<uint8_t>(symbol_chars_.size());
+        size_t slots = 64;
+        while (slots < rules_.size() * 2)
+        {
+            slots *= 2;
+        }
+        multi_slots_.assign(slots, MultiSlot{0, kNoRule, 0});
+        multi_transitions_.clear();
+
+        std::string_view parts[kMaxTapes];
+        for (const auto &rule : rules_)
+        {
+            uint64_t reads = 0;
+            splitTuple(token_table_.name(rule.read), parts, kMaxTapes);
+            for (size_t tape = 0; tape < tape_count_; ++tape)
+            {
+                reads |= static_cast<uint64_t>(symbol_ids_[static_cast<unsigned char>(parts[tape][0])]) << (8 * tape);
+            }
+            MultiSlot &slot = multi_slots_[findMultiSlot(rule.from, reads)];
+            if (slot.state != kNoRule)
+            {
+                continue; // an earlier rule already matches this state and these symbols
+            }
+
+            MultiTransition transition{rule.to, {}, {}};
+            splitTuple(token_table_.name(rule.write), parts, kMaxTapes);
+            for (size_t tape = 0; tape < tape_count_; ++tape)
+            {
+                transition.write[tape] = static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(parts[tape][0])]);
+            }
+            splitTuple(token_table_.name(rule.move), parts, kMaxTapes);
+            for (size_t tape = 0; tape < tape_count_; ++tape)
+            {
+                transition.move[tape] = moveOf(parts[tape]);
+            }
+            slot = MultiSlot{reads, rule.from, static_cast<int32_t>(multi_transitions_.size())};
+            multi_transitions_.push_back(transition);
+        }
+    }
+
+    /*
+      Compiles the multi-tape machine into a dense table for the single-tape engines.
+
+      Each cell of the single tape holds one track per simulated tape: the symbol of that tape
+      and whether its head is there. Cells never visited keep their plain symbol, read as that
+      symbol on the first track and blank on the others. A simulated step is two sweeps:
+      Gather starts at the leftmost head mark and walks right, collecting the symbol under each
+      head in its state, until it has seen all of them and knows the rule; Apply walks back
+      left, writing every track and moving its mark. A mark moving left is carried in the state
+      to the next cell, one moving right is placed by stepping right and back. The sweep ends on
+      the leftmost mark again, ready for the next Gather.
+     */
+    bool compileTracks()
+    {
+        const size_t tapes = tape_count_;
+        const unsigned all_marks = (1u << tapes) - 1;
+        const size_t base = symbol_chars_.size();
+        const uint8_t blank = static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(kBlank)]);
+
+        // The first track can hold any symbol of the input; the others only blanks and the
+        // symbols their rules write, which keeps the product alphabet small
+        std::vector<std::vector<uint8_t>> alphabets(tapes);
+        std::vector<std::vector<int16_t>> positions(tapes, std::vector<int16_t>(base, -1));
+        auto allow = [&](size_t tape, uint8_t symbol) {
+            if (positions[tape][symbol] < 0)
+            {
+                positions[tape][symbol] = static_cast<int16_t>(alphabets[tape].size());
+                alphabets[tape].push_back(symbol);
+            }
+        };
+        for (size_t symbol = 0; symbol < base; ++symbol)
+        {
+            allow(0, static_cast<uint8_t>(symbol));
+        }
+        for (size_t tape = 1; tape < tapes; ++tape)
+        {
+            allow(tape, blank);
+        }
+        for (const MultiTransition &transition : multi_transitions_)
+        {
+            for (size_t tape = 1; tape < tapes; ++tape)
+            {
+                allow(tape, transition.write[tape]);
+            }
+        }
+        size_t track_symbols = size_t(1) << tapes;
+        for (size_t tape = 0; tape < tapes && base + track_symbols < 256; ++tape)
+        {
+            track_symbols *= alphabets[tape].size();
+        }
+        if (base + track_symbols >= 256)
+        {
+            std::cerr << "Too many tape symbols to simulate " << tapes << " tapes on one (at most 255 are supported)."
+                      << std::endl;
+            return false;
+        }
+        const size_t symbol_count = base + track_symbols;
+
+        // Cell contents: symbol on each track and a bit per head mark
+        using Tracks = std::array<uint8_t, kMaxTapes>;
+        auto decode = [&](size_t symbol, Tracks &tracks) -> unsigned {
+            tracks.fill(blank);
+            if (symbol < base)
+            {
+                tracks[0] = static_cast<uint8_t>(symbol);
+                return 0;
+            }
+            size_t packed = (symbol - base) >> tapes;
+            for (size_t tape = 0; tape < tapes; ++tape)
+            {
+                tracks[tape] = alphabets[tape][packed % alphabets[tape].size()];
+                packed /= alphabets[tape].size();
+            }
+            return static_cast<unsigned>((symbol - base) & all_marks);
+        };
+        auto encode = [&](const Tracks &tracks, unsigned marks) {
+            size_t packed = 0;
+            for (size_t tape = tapes; tape-- > 0;)
+            {
+                packed = packed * alphabets[tape].size() + static_cast<size_t>(positions[tape][tracks[tape]]);
+            }
+            return static_cast<uint8_t>(base + (packed << tapes) + marks);
+        };
+
+        // Simulation states, created as they are reached. Gather keeps, per tape, the symbol read
+        // under its head or `base` if the head has not been passed yet.
+        enum Phase : int64_t { Init, Final, Gather, Apply, Detour, Resume, Place };
+        using Key = std::array<int64_t, 4>;
+        std::map<Key, int32_t> ids;
+        std::vector<Key> keys;
+        std::vector<int32_t> rule_from(multi_transitions_.size());
+        for (const MultiSlot &slot : multi_slots_)
+        {
+            if (slot.state != kNoRule)
+            {
+                rule_from[slot.transition] = slot.state;
+            }
+        }
+        const int64_t nothing_read = [&] {
+            int64_t packed = 0;
+            for (size_t tape = 0; tape < tapes; ++tape)
+            {
+                packed = packed * static_cast<int64_t>(base + 1) + static_cast<int64_t>(base);
+            }
+            return packed;
+        }();
+        auto id = [&](const Key &key) {
+            auto found = ids.find(key);
+            if (found != ids.end())
+            {
+                return found->second;
+            }
+            int32_t created = static_cast<int32_t>(keys.size());
+            ids.emplace(key, created);
+            keys.push_back(key);
+            return created;
+        };
+        auto gather = [&](int32_t state) {
+            return state == final_state_ ? id(Key{Final, 0, 0, 0}) : id(Key{Gather, state, nothing_read, 0});
+        };
+        // Leaves a finished cell: on to the next cell left, or back to Gather on the leftmost mark
+        auto resume = [&](int64_t rule, unsigned done, unsigned left, unsigned marks_here) {
+            if (done != all_marks)
+            {
+                return Transition{id(Key{Apply, rule, done, left}), 0, -1};
+            }
+            if (left != 0)
+            {
+                return Transition{id(Key{Place, rule, left, 0}), 0, -1};
+            }
+            int32_t next = gather(multi_transitions_[rule].next_state);
+            return Transition{next, 0, static_cast<int8_t>(marks_here != 0 ? 0 : 1)};
+        };
+
+        id(Key{Init, 0, 0, 0});
+        id(Key{Final, 0, 0, 0});
+        compiled_table_.clear();
+        Tracks tracks;
+        for (size_t state = 0; state < keys.size(); ++state)
+        {
+            for (size_t symbol = 0; symbol < symbol_count; ++symbol)
+            {
+                const Key key = keys[state];
+                const uint8_t cell = static_cast<uint8_t>(symbol);
+                const unsigned marks = decode(symbol, tracks);
+                Transition transition{kNoRule, 0, 0};
+                if (key[0] == Init)
+                {
+                    transition = Transition{gather(start_state_), encode(tracks, all_marks), 0};
+                }
+                else if (key[0] == Gather)
+                {
+                    int64_t read[kMaxTapes];
+                    int64_t packed = key[2];
+                    for (size_t tape = tapes; tape-- > 0;)
+                    {
+                        read[tape] = packed % static_cast<int64_t>(base + 1);
+                        packed /= static_cast<int64_t>(base + 1);
+                    }
+                    bool complete = true;
+                    uint64_t reads = 0;
+                    for (size_t tape = 0; tape < tapes; ++tape)
+                    {
+                        if (marks & (1u << tape))
+                        {
+                            read[tape] = tracks[tape];
+                        }
+                        complete = complete && read[tape] != static_cast<int64_t>(base);
+                        reads |= static_cast<uint64_t>(read[tape]) << (8 * tape);
+                        packed = packed * static_cast<int64_t>(base + 1) + read[tape];
+                    }
+                    if (marks == 0)
+                    {
+                        transition = Transition{static_cast<int32_t>(state), cell, 1};
+                    }
+                    else if (!complete)
+                    {
+                        transition = Transition{id(Key{Gather, key[1], packed, 0}), cell, 1};
+                    }
+                    else
+                    {
+                        const MultiSlot &slot = multi_slots_[findMultiSlot(static_cast<int32_t>(key[1]), reads)];
+                        if (slot.state != kNoRule)
+                        {
+                            transition = Transition{id(Key{Apply, slot.transition, 0, 0}), cell, 0};
+                        }
+                    }
+                }
+                else if (key[0] == Apply)
+                {
+                    // key: rule, tapes already written, marks moving left onto this cell
+                    const MultiTransition &rule = multi_transitions_[key[1]];
+                    unsigned done = static_cast<unsigned>(key[2]) | marks;
+                    unsigned stay = static_cast<unsigned>(key[3]), left = 0, right = 0;
+                    for (size_t tape = 0; tape < tapes; ++tape)
+                    {
+                        if (marks & (1u << tape))
+                        {
+                            tracks[tape] = rule.write[tape];
+                            unsigned &moved = rule.move[tape] == 0 ? stay : (rule.move[tape] < 0 ? left : right);
+                            moved |= 1u << tape;
+                        }
+                    }
+                    const uint8_t written = marks == 0 && stay == 0 ? cell : encode(tracks, stay);
+                    transition = right != 0 ? Transition{id(Key{Detour, key[1], done, left | (right << tapes)}), 0, 1}
+                                            : resume(key[1], done, left, stay);
+                    transition.write = written;
+                }
+                else if (key[0] == Detour)
+                {
+                    // key: rule, tapes written, marks moving left | marks moving right onto this cell
+                    const unsigned right = static_cast<unsigned>(key[3]) >> tapes;
+                    const unsigned left = static_cast<unsigned>(key[3]) & all_marks;
+                    transition = Transition{id(Key{Resume, key[1], key[2], left}), encode(tracks, marks | right), -1};
+                }
+                else if (key[0] == Resume)
+                {
+                    transition = resume(key[1], static_cast<unsigned>(key[2]), static_cast<unsigned>(key[3]), marks);
+                    transition.write = cell;
+                }
+                else if (key[0] == Place)
+                {
+                    const int32_t next = gather(multi_transitions_[key[1]].next_state);
+                    transition = Transition{next, encode(tracks, marks | static_cast<unsigned>(key[2])), 0};
+                }
+                compiled_table_.push_back(transition);
+            }
+            compiled_table_.push_back(Transition{kGrowTape, static_cast<uint8_t>(symbol_count), 0});
+        }
+        table_ = compiled_table_;
+
+        // Gather states at the start of a simulated step carry the name of the simulated state
+        compiled_state_names_.clear();
+        for (const Key &key : keys)
+        {
+            if (key[0] == Init || key[0] == Final)
+            {
+                compiled_state_names_.add(state_table_.name(key[0] == Init ? start_state_ : final_state_));
+            }
+            else if (key[0] == Gather)
+            {
+                const std::string &name = state_table_.name(static_cast<int32_t>(key[1]));
+                compiled_state_names_.add(key[2] == nothing_read ? name : name + "/read");
+            }
+            else
+            {
+                compiled_state_names_.add(state_table_.name(rule_from[key[1]]) + "/write");
+            }
+        }
+        state_names_ = compiled_state_names_.view();
+        start_id_ = ids[Key{Init, 0, 0, 0}];
+        final_id_ = ids[Key{Final, 0, 0, 0}];
+
+        // Track symbols print as their first track
+        track_decode_.resize(symbol_count);
+        for (size_t symbol = 0; symbol < symbol_count; ++symbol)
+        {
+            decode(symbol, tracks);
+            track_decode_[symbol] = tracks[0];
+        }
+        for (size_t symbol = base; symbol < symbol_count; ++symbol)
+        {
+            symbol_chars_.push_back(symbol_chars_[track_decode_[symbol]]);
+        }
+        edge_id_ = static_cast<uint8_t>(symbol_count);
+        return true;
+    }
+
+public:
+
+    // Summary adds steps, throughput and the tape footprint; Trace also dumps the last steps
+    void setOutputLevel(OutputLevel level)
+    {
+        output_level_ = level;
+    }
+
+    // Number of steps the trace keeps, the oldest ones are overwritten
+    void setTraceCapacity(size_t capacity)
+    {
+        trace_capacity_ = capacity;
+    }
+
+    // Runs long self-loop sweeps in one operation on a run-length encoded tape
+    void setAccelerated(bool accelerated)
+    {
+        accelerated_ = accelerated;
+    }
+
+    // Stops a run after `steps` steps, 0 for no limit
+    void setStepBudget(uint64_t steps)
+    {
+        step_budget_ = steps;
+    }
+
+    // Stops a run after `seconds` of wall-clock time, 0 for no limit
+    void setTimeBudget(double seconds)
+    {
+        time_budget_ = seconds;
+    }
+
+    // Runs on native code generated for the machine, see loadNative()
+    void setNative(bool native)
+    {
+        native_ = native;
+    }
+
+    // Runs a multi-tape machine on the single-tape engines through compileTracks()
+    void setSingleTape(bool single_tape)
+    {
+        tracks_ = single_tape;
+    }
+
+    // Looks for repeated and translated configurations while running
+    void setDetectLoops(bool detect)
+    {
+        detect_loops_ = detect;
+    }
+
+    // Counts rule firings, head travel and cells touched on the plain engine and writes the
+    // reports to <prefix>.json, .csv and .folded; an empty prefix turns profiling off
+    void setProfile(const std::string &prefix)
+    {
+        profile_path_ = prefix;
+    }
+
+    // Converts a line of space separated symbols into interned ids; false if a symbol is not in sigma
+    bool encodeInput(const std::string &line, std::vector<uint8_t> &input) const
+    {
+        input.clear();
+        std::istringstream ss(line);
+        std::string symbol;
+        while (ss >> symbol)
+        {
+            if (symbol.length() != 1 || sigma_.find(symbol[0]) == sigma_.end())
+            {
+                return false;
+            }
+            input.push_back(static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(symbol[0])]));
+        }
+        return true;
+    }
+
+    // Plain stepper: one table lookup per step on a flat tape. Steps are recorded in `trace` if given.
+    RunResult execute(const std::vector<uint8_t> &input, Tape &tape, bool keep_tape = true, Trace *trace = nullptr) const
+    {
+        NoProfile profile;
+        if (trace)
+        {
+            return isGuarded() ? execute<true, true>(input, tape, keep_tape, trace, profile)
+                               : execute<true, false>(input, tape, keep_tape, trace, profile);
+        }
+        return isGuarded() ? execute<false, true>(input, tape, keep_tape, nullptr, profile)
+                           : execute<false, false>(input, tape, keep_tape, nullptr, profile);
+    }
+
+    // Plain stepper that also counts into `profile`, which must come from newProfile()
+    RunResult execute(const std::vector<uint8_t> &input, Tape &tape, RunProfile &profile, bool keep_tape = true,
+                      Trace *trace = nullptr) const
+    {
+        if (trace)
+        {
+            return isGuarded() ? execute<true, true>(input, tape, keep_tape, trace, profile)
+                               : execute<true, false>(input, tape, keep_tape, trace, profile);
+        }
+        return isGuarded() ? execute<false, true>(input, tape, keep_tape, nullptr, profile)
+                           : execute<false, false>(input, tape, keep_tape, nullptr, profile);
+    }
+
+    // An empty profile with one counter per cell of the transition table
+    RunProfile newProfile() const
+    {
+        return RunProfile(table_.size());
+    }
+
+    // Names the table cells of the profile: "state symbol -> next written move"
+    ProfileLabels profileLabels() const
+    {
+        ProfileLabels labels;
+        labels.machine = "turing";
+        const size_t symbol_count = symbol_chars_.size() + 1;
+        for (size_t state = 0; state < state_names_.size(); ++state)
+        {
+            labels.states.emplace_back(state_names_[state]);
+        }
+        labels.rules.resize(table_.size());
+        labels.ruleStates.resize(table_.size());
+        for (size_t cell = 0; cell < table_.size(); ++cell)
+        {
+            const Transition &rule = table_[cell];
+            labels.ruleStates[cell] = static_cast<int32_t>(cell / symbol_count);
+            if (rule.next_state >= 0)
+            {
+                labels.rules[cell] = std::string(state_names_[cell / symbol_count]) + " " +
+                                     symbol_chars_[cell % symbol_count] + " -> " +
+                                     std::string(state_names_[rule.next_state]) + " " + symbol_chars_[rule.write] + " " +
+                                     (rule.move > 0 ? 'R' : (rule.move < 0 ? 'L' : 'S'));
+            }
+        }
+        return labels;
+    }
+
+    // Accelerated engine: same results as execute(), but self-loop sweeps cross whole runs at once
+    RunResult executeAccelerated(const std::vector<uint8_t> &input, RunLengthTape &tape, bool keep_tape = true,
+                                 Trace *trace = nullptr) const
+    {
+        if (trace)
+        {
+            return isGuarded() ? executeAccelerated<true, true>(input, tape, keep_tape, trace)
+                               : executeAccelerated<true, false>(input, tape, keep_tape, trace);
+        }
+        return isGuarded() ? executeAccelerated<false, true>(input, tape, keep_tape, nullptr)
+                           : executeAccelerated<false, false>(input, tape, keep_tape, nullptr);
+    }
+
+    // Native engine: the machine compiled by loadNative(); same results as execute(), no tracing or loop detection
+    RunResult executeNative(const std::vector<uint8_t> &input, Tape &tape, bool keep_tape = true) const
+    {
+        const uint8_t blank = static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(kBlank)]);
+        tape.reset(input, blank, edge_id_);
+        StepBudget budget(step_budget_, time_budget_);
+        NativeContext context{&tape, &budget};
+        const bool budgeted = step_budget_ > 0 || time_budget_ > 0;
+        NativeRun run{tape.data(), tape.indexOf(0), start_id_, 0, budgeted ? budget.next() : UINT64_MAX,
+                      &context, growNative, checkNative};
+        const int outcome = native_entry_(&run);
+
+        // The generated code checks the limit before reading the tape; like execute(), report a
+        // missing rule rather than the budget when both happen on the same step
+        if (outcome == 2)
+        {
+            while (run.cells[run.head] == edge_id_)
+            {
+                run.head = growNative(&context, run.head, &run.cells);
+            }
+        }
+        const bool no_rule = outcome == 1 ||
+                             (outcome == 2 && table_[run.state * (symbol_chars_.size() + 1) + run.cells[run.head]].next_state < 0);
+
+        RunResult result;
+        result.outcome = no_rule ? RunResult::Outcome::NoRule
+                                 : (outcome == 2 ? RunResult::Outcome::BudgetExceeded : RunResult::Outcome::Halted);
+        result.state = run.state;
+        result.symbol = run.cells[run.head];
+        result.steps = run.steps;
+        if (keep_tape)
+        {
+            result.tape = tape.contents(tracks_ ? track_decode_.data() : nullptr);
+        }
+        result.peak_footprint = tape.peakCells();
+        result.peak_bytes = tape.peakBytes();
+        return result;
+    }
+
+    // Multi-tape engine: one lookup of the packed symbols under all heads per step
+    RunResult executeMultiTape(const std::vector<uint8_t> &input, std::vector<Tape> &tapes, bool keep_tape = true) const
+    {
+        return isGuarded() ? executeMultiTape<true>(input, tapes, keep_tape)
+                           : executeMultiTape<false>(input, tapes, keep_tape);
+    }
+
+private:
+    bool isGuarded() const
+    {
+        return step_budget_ > 0 || time_budget_ > 0 || detect_loops_;
+    }
+
+    // The untraced instantiations keep the step loops free of any recording code, and the
+    // unguarded ones free of budget checks and loop detection; with NoProfile the profiling calls
+    // are empty and vanish as well
+    template <bool Traced, bool Guarded, typename Profile>
+    RunResult execute(const std::vector<uint8_t> &input, Tape &tape, bool keep_tape, Trace *trace, Profile &profile) const
+    {
+        const uint8_t blank = static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(kBlank)]);
+        tape.reset(input, blank, edge_id_);
+
+        const Transition *table = table_.data();
+        const size_t symbol_count = symbol_chars_.size() + 1;
+        uint8_t *cells = tape.data();
+        long long head = tape.indexOf(0);
+        int32_t current_state = start_id_;
+        uint64_t steps = 0;
+        StepBudget budget(step_budget_, time_budget_);
+        CycleDetector detector;
+        if (Guarded && detect_loops_)
+        {
+            detector.reset(tape, blank, static_cast<long long>(input.size()));
+        }
+
+        RunResult result;
+        while (current_state != final_id_)
+        {
+            const Transition &rule = table[current_state * symbol_count + cells[head]];
+            if (rule.next_state < 0)
+            {
+                if (rule.next_state == kGrowTape)
+                {
+                    head = tape.grow(head);
+                    cells = tape.data();
+                    continue;
+                }
+                result.outcome = RunResult::Outcome::NoRule;
+                break;
+            }
+            if (Guarded && steps >= budget.next() && budget.exhausted(steps))
+            {
+                result.outcome = RunResult::Outcome::BudgetExceeded;
+                break;
+            }
+            if (Traced)
+            {
+                trace->push(TraceRecord{steps, tape.positionOf(head), current_state, cells[head]});
+            }
+            if (Guarded && detect_loops_)
+            {
+                detector.write(tape.positionOf(head), cells[head], rule.write);
+            }
+            profile.fire(static_cast<size_t>(&rule - table));
+            current_state = rule.next_state;
+            cells[head] = rule.write;
+            head += rule.move;
+            ++steps;
+            profile.position(tape.positionOf(head));
+            if (Guarded && detect_loops_ && detector.step(tape, current_state, tape.positionOf(head), steps))
+            {
+                result.outcome = RunResult::Outcome::NeverHalts;
+                result.proof = detector.proof();
+                result.period = detector.period();
+                break;
+            }
+        }
+
+        result.state = current_state;
+        result.symbol = cells[head];
+        result.steps = steps;
+        if (keep_tape)
+        {
+            result.tape = tape.contents(tracks_ ? track_decode_.data() : nullptr);
+        }
+        result.peak_footprint = tape.peakCells();
+        result.peak_bytes = tape.peakBytes();
+        return result;
+    }
+
+    // With loop detection the configuration after macro steps 1, 2, 4, ... is kept, Brent style,
+    // and compared with every later one; a sweep counts as one macro step
+    template <bool Traced, bool Guarded>
+    RunResult executeAccelerated(const std::vector<uint8_t> &input, RunLengthTape &tape, bool keep_tape,
+                                 Trace *trace) const
+    {
+        const uint8_t blank = static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(kBlank)]);
+        tape.reset(input, blank);
+
+        const Transition *table = table_.data();
+        const size_t symbol_count = symbol_chars_.size() + 1;
+        int32_t current_state = start_id_;
+        uint64_t steps = 0;
+        StepBudget budget(step_budget_, time_budget_);
+        RunLengthTape checkpoint;
+        int32_t checkpoint_state = kNoRule;
+        uint64_t checkpoint_steps = 0;
+        uint64_t macro_steps = 0;
+        uint64_t next_checkpoint = 1;
+
+        RunResult result;
+        while (current_state != final_id_)
+        {
+            const Transition *row = table + current_state * symbol_count;
+            const Transition &rule = row[tape.read()];
+            if (rule.next_state == kNoRule)
+            {
+                result.outcome = RunResult::Outcome::NoRule;
+                break;
+            }
+            if (Guarded && steps >= budget.next() && budget.exhausted(steps))
+            {
+                result.outcome = RunResult::Outcome::BudgetExceeded;
+                break;
+            }
+            if (Traced)
+            {
+                trace->push(TraceRecord{steps, tape.head(), current_state, tape.read()});
+            }
+            if (rule.next_state == current_state && rule.move != 0)
+            {
+                if (Guarded && detect_loops_ && tape.sweepsForever(row, current_state, rule.move))
+                {
+                    result.outcome = RunResult::Outcome::NeverHalts;
+                    result.proof = LoopProof::BlankSweep;
+                    break;
+                }
+                // A sweep stops where the budget is next checked, so it cannot overrun --max-steps
+                steps += tape.sweep(row, current_state, rule.move, Guarded ? budget.next() - steps : UINT64_MAX);
+            }
+            else
+            {
+                current_state = rule.next_state;
+                tape.step(rule.write, rule.move);
+                ++steps;
+            }
+            if (Guarded && detect_loops_)
+            {
+                if (current_state == checkpoint_state && tape.sameAs(checkpoint))
+                {
+                    result.outcome = RunResult::Outcome::NeverHalts;
+                    result.proof = LoopProof::Repeat;
+                    result.period = steps - checkpoint_steps;
+                    break;
+                }
+                if (++macro_steps >= next_checkpoint)
+                {
+                    checkpoint = tape;
+                    checkpoint_state = current_state;
+                    checkpoint_steps = steps;
+                    next_checkpoint = macro_steps * 2;
+                }
+            }
+        }
+
+        result.state = current_state;
+        result.symbol = tape.read();
+        result.steps = steps;
+        if (keep_tape)
+        {
+            result.tape = tape.contents(tracks_ ? track_decode_.data() : nullptr);
+        }
+        result.peak_footprint = tape.peakRuns();
+        result.peak_bytes = tape.peakRuns() * sizeof(RunLengthTape::Run);
+        return result;
+    }
+
+    // Budgets apply as in execute(); loop detection and tracing need a single tape
+    template <bool Guarded>
+    RunResult executeMultiTape(const std::vector<uint8_t> &input, std::vector<Tape> &tapes, bool keep_tape) const
+    {
+        const uint8_t blank = static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(kBlank)]);
+        const size_t tape_count = tape_count_;
+        std::array<uint8_t *, kMaxTapes> cells{};
+        std::array<long long, kMaxTapes> heads{};
+        tapes.resize(tape_count);
+        for (size_t tape = 0; tape < tape_count; ++tape)
+        {
+            tapes[tape].reset(tape == 0 ? input : std::vector<uint8_t>(), blank, edge_id_);
+            cells[tape] = tapes[tape].data();
+            heads[tape] = tapes[tape].indexOf(0);
+        }
+
+        const MultiSlot *slots = multi_slots_.data();
+        const size_t mask = multi_slots_.size() - 1;
+        int32_t current_state = start_id_;
+        uint64_t steps = 0;
+        uint64_t reads = 0;
+        StepBudget budget(step_budget_, time_budget_);
+
+        RunResult result;
+        while (current_state != final_id_)
+        {
+            reads = 0;
+            for (size_t tape = 0; tape < tape_count; ++tape)
+            {
+                reads |= static_cast<uint64_t>(cells[tape][heads[tape]]) << (8 * tape);
+            }
+            size_t slot = multiHash(current_state, reads) & mask;
+            while (slots[slot].state != kNoRule && (slots[slot].state != current_state || slots[slot].reads != reads))
+            {
+                slot = (slot + 1) & mask;
+            }
+            if (slots[slot].state == kNoRule)
+            {
+                // Heads on an edge sentinel never match a rule: grow those tapes and look again
+                bool grown = false;
+                for (size_t tape = 0; tape < tape_count; ++tape)
+                {
+                    if (cells[tape][heads[tape]] == edge_id_)
+                    {
+                        heads[tape] = tapes[tape].grow(heads[tape]);
+                        cells[tape] = tapes[tape].data();
+                        grown = true;
+                    }
+                }
+                if (grown)
+                {
+                    continue;
+                }
+                result.outcome = RunResult::Outcome::NoRule;
+                break;
+            }
+            if (Guarded && steps >= budget.next() && budget.exhausted(steps))
+            {
+                result.outcome = RunResult::Outcome::BudgetExceeded;
+                break;
+            }
+            const MultiTransition &rule = multi_transitions_[slots[slot].transition];
+            for (size_t tape = 0; tape < tape_count; ++tape)
+            {
+                cells[tape][heads[tape]] = rule.write[tape];
+                heads[tape] += rule.move[tape];
+            }
+            current_state = rule.next_state;
+            ++steps;
+        }
+
+        result.state = current_state;
+        result.symbol = cells[0][heads[0]];
+        result.symbols = reads;
+        result.steps = steps;
+        if (keep_tape)
+        {
+            result.tape = tapes[0].contents();
+        }
+        for (size_t tape = 0; tape < tape_count; ++tape)
+        {
+            result.peak_footprint += tapes[tape].peakCells();
+            result.peak_bytes += tapes[tape].peakBytes();
+        }
+        return result;
+    }
+
+    // Tape and budget of a native run, reached from the callbacks in NativeRun
+    struct NativeContext
+    {
+        Tape *tape;
+        StepBudget *budget;
+    };
+
+    static long long growNative(void *context, long long head, uint8_t **cells)
+    {
+        Tape &tape = *static_cast<NativeContext *>(context)->tape;
+        head = tape.grow(head);
+        *cells = tape.data();
+        return head;
+    }
+
+    static uint64_t checkNative(void *context, uint64_t steps)
+    {
+        StepBudget &budget = *static_cast<NativeContext *>(context)->budget;
+        return budget.exhausted(steps) ? 0 : budget.next();
+    }
+
+    // C++ string literal for `text`, with anything but plain characters escaped
+    static std::string cppLiteral(std::string_view text)
+    {
+        std::string literal = "\"";
+        for (char c : text)
+        {
+            if (std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ' ')
+            {
+                literal += c;
+            }
+            else
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\%03o", static_cast<unsigned char>(c));
+                literal += escaped;
+            }
+        }
+        return literal + "\"";
+    }
+
+    /*
+      Writes the machine as C++: every state is a label followed by a switch on the symbol under
+      the head, and every rule writes, moves and jumps straight to the label of its next state,
+      so a step costs one load and one branch with no table lookup. Stepping onto a tape edge,
+      and reaching the step limit (tested once per state, before the switch), leave the
+      threaded code through the callbacks in NativeRun and come back through the dispatch switch. With -DTURING_STANDALONE the source also builds
+      as a program that reads one input line and prints the result and the step count.
+     */
+    bool writeNativeSource(const std::string &path) const
+    {
+        if (tape_count_ > 1 && !tracks_)
+        {
+            std::cerr << "Native code is generated for single-tape machines only; use --single-tape." << std::endl;
+            return false;
+        }
+        std::ofstream out(path, std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::cerr << "Error writing file: " << path << std::endl;
+            return false;
+        }
+
+        const size_t state_count = state_names_.size();
+        const size_t symbol_count = symbol_chars_.size() + 1;
+        out << "// Generated by turing --codegen: " << state_count << " states, " << symbol_chars_.size()
+            << " symbols. Do not edit.\n"
+            << "// Library: c++ -O2 -shared -fPIC -o machine.so machine.cpp\n"
+            << "// Program: c++ -O2 -DTURING_STANDALONE -o machine machine.cpp\n"
+            << "#include <cstdint>\n\n"
+            << "struct NativeRun\n{\n"
+            << "    uint8_t *cells;\n    long long head;\n    int32_t state;\n    uint64_t steps;\n"
+            << "    uint64_t limit;\n    void *context;\n"
+            << "    long long (*grow)(void *context, long long head, uint8_t **cells);\n"
+            << "    uint64_t (*check)(void *context, uint64_t steps);\n};\n\n"
+            << "extern \"C\" const int turing_native_abi = " << kNativeAbi << ";\n\n"
+            << "extern \"C\" int turing_native_run(NativeRun *run)\n{\n"
+            << "    uint8_t *c = run->cells;\n    long long h = run->head;\n    uint64_t n = run->steps;\n"
+            << "    uint64_t limit = run->limit;\n    int32_t at = run->state;\n    int outcome = 0;\n\n"
+            << "dispatch:\n    switch (at)\n    {\n";
+        for (size_t state = 0; state < state_count; ++state)
+        {
+            out << "    case " << state << ": goto s" << state << ";\n";
+        }
+        out << "    }\n";
+
+        for (size_t state = 0; state < state_count; ++state)
+        {
+            out << "s" << state << ":\n";
+            if (static_cast<int32_t>(state) == final_id_)
+            {
+                out << "    at = " << state << ";\n    goto done;\n";
+                continue;
+            }
+            out << "    if (n == limit)\n    {\n        at = " << state << ";\n        goto budget;\n    }\n"
+                << "    switch (c[h])\n    {\n";
+            const Transition *row = table_.data() + state * symbol_count;
+            // Rules that leave the cell unchanged only differ by move and target: they share one body
+            std::map<std::pair<int, int32_t>, std::vector<size_t>> keeping;
+            for (size_t symbol = 0; symbol + 1 < symbol_count; ++symbol)
+            {
+                const Transition &rule = row[symbol];
+                if (rule.next_state < 0)
+                {
+                    continue;
+                }
+                if (rule.write == symbol)
+                {
+                    keeping[std::make_pair(static_cast<int>(rule.move), rule.next_state)].push_back(symbol);
+                    continue;
+                }
+                out << "    case " << symbol << ": c[h] = " << static_cast<int>(rule.write) << ";";
+                if (rule.move != 0)
+                {
+                    out << " h += " << static_cast<int>(rule.move) << ";";
+                }
+                out << " ++n; goto s" << rule.next_state << ";\n";
+            }
+            for (const auto &group : keeping)
+            {
+                for (size_t symbol : group.second)
+                {
+                    out << "    case " << symbol << ":";
+                }
+                if (group.first.first != 0)
+                {
+                    out << " h += " << group.first.first << ";";
+                }
+                out << " ++n; goto s" << group.first.second << ";\n";
+            }
+            out << "    case " << static_cast<int>(edge_id_) << ": at = " << state << "; goto grow;\n"
+                << "    default: at = " << state << "; outcome = 1; goto done;\n    }\n";
+        }
+
+        out << "grow:\n    h = run->grow(run->context, h, &c);\n    goto dispatch;\n"
+            << "budget:\n    limit = run->check(run->context, n);\n    if (limit != 0)\n        goto dispatch;\n"
+            << "    outcome = 2;\n"
+            << "done:\n    run->cells = c;\n    run->head = h;\n    run->steps = n;\n    run->limit = limit;\n"
+            << "    run->state = at;\n    return outcome;\n}\n";
+
+        // Standalone program: the same tape layout and output as the simulator
+        std::string sigma;
+        for (char symbol : sigma_)
+        {
+            sigma += symbol;
+        }
+        out << "\n#ifdef TURING_STANDALONE\n"
+            << "#include <iostream>\n#include <sstream>\n#include <string>\n#include <vector>\n\n"
+            << "static const char kSymbols[] = " << cppLiteral(std::string_view(symbol_chars_.data(), symbol_chars_.size()))
+            << ";\nstatic const std::string kSigma = " << cppLiteral(sigma) << ";\n"
+            << "static const uint8_t kBlank = " << symbol_ids_[static_cast<unsigned char>(kBlank)] << ";\n"
+            << "static const uint8_t kEdge = " << static_cast<int>(edge_id_) << ";\n"
+            << "static const char *const kStates[] = {\n";
+        for (size_t state = 0; state < state_count; ++state)
+        {
+            out << "    " << cppLiteral(state_names_[state]) << ",\n";
+        }
+        out << "};\n\n"
+            << "struct StandaloneTape\n{\n    std::vector<uint8_t> cells;\n    long long origin;\n};\n\n"
+            << "static long long standaloneGrow(void *context, long long head, uint8_t **cells)\n{\n"
+            << "    StandaloneTape &tape = *static_cast<StandaloneTape *>(context);\n"
+            << "    const size_t used = tape.cells.size() - 2;\n"
+            << "    const size_t added = used > " << Tape::kInitialPadding << " ? used : " << Tape::kInitialPadding
+            << ";\n    const size_t shift = head == 0 ? added : added / 2;\n"
+            << "    std::vector<uint8_t> grown(used + added + 2, kBlank);\n"
+            << "    grown.front() = kEdge;\n    grown.back() = kEdge;\n"
+            << "    std::copy(tape.cells.begin() + 1, tape.cells.end() - 1, grown.begin() + 1 + shift);\n"
+            << "    tape.cells.swap(grown);\n    tape.origin += shift;\n    *cells = tape.cells.data();\n"
+            << "    return head + shift;\n}\n\n"
+            << "static uint64_t standaloneCheck(void *, uint64_t)\n{\n    return 0;\n}\n\n"
+            << "int main()\n{\n"
+            << "    std::string line, symbol;\n    std::getline(std::cin, line);\n    std::istringstream in(line);\n"
+            << "    std::vector<uint8_t> input;\n    while (in >> symbol)\n    {\n"
+            << "        if (symbol.size() != 1 || kSigma.find(symbol[0]) == std::string::npos)\n        {\n"
+            << "            std::cerr << \"Invalid input symbol: \" << symbol << std::endl;\n            return 1;\n"
+            << "        }\n        input.push_back(static_cast<uint8_t>(std::string(kSymbols, sizeof(kSymbols) - 1)"
+            << ".find(symbol[0])));\n    }\n\n"
+            << "    StandaloneTape tape{std::vector<uint8_t>(input.size() + " << 2 * Tape::kInitialPadding + 2
+            << ", kBlank), " << 1 + Tape::kInitialPadding << "};\n"
+            << "    tape.cells.front() = kEdge;\n    tape.cells.back() = kEdge;\n"
+            << "    std::copy(input.begin(), input.end(), tape.cells.begin() + tape.origin);\n"
+            << "    NativeRun run{tape.cells.data(), tape.origin, " << start_id_
+            << ", 0, UINT64_MAX, &tape, standaloneGrow, standaloneCheck};\n"
+            << "    if (turing_native_run(&run) == 1)\n    {\n"
+            << "        std::cout << \"No rule found for state \" << kStates[run.state] << \" and symbol \"\n"
+            << "                  << kSymbols[run.cells[run.head]] << std::endl;\n    }\n\n"
+            << "    long long first = 1, last = static_cast<long long>(tape.cells.size()) - 2;\n"
+            << "    while (first < tape.origin && tape.cells[first] == kBlank)\n        first++;\n"
+            << "    while (last >= first && tape.cells[last] == kBlank)\n        last--;\n"
+            << "    std::cout << \"Result: \";\n"
+            << "    for (long long i = first; i <= last; ++i)\n        std::cout << kSymbols[tape.cells[i]];\n"
+            << "    std::cout << std::endl << \"Steps: \" << run.steps << std::endl;\n    return 0;\n}\n#endif\n";
+        out.close();
+        if (!out)
+        {
+            std::cerr << "Error writing file: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Prints the recorded steps, oldest first
+    void dumpTrace(const Trace &trace) const
+    {
+        if (trace.dropped() > 0)
+        {
+            std::cout << "... " << trace.dropped() << " earlier steps not kept\n";
+        }
+        for (size_t i = 0; i < trace.size(); ++i)
+        {
+            const TraceRecord &record = trace[i];
+            std::cout << record.step << ": " << state_names_[record.state] << " @" << record.position
+                      << " reads " << symbol_chars_[record.symbol] << '\n';
+        }
+    }
+
+public:
+    bool isValidInput(const std::vector<std::string> &input_string) const
+    {
+        for (const std::string &symbol_str : input_string)
+        {
+            if (symbol_str.length() != 1 || sigma_.find(symbol_str[0]) == sigma_.end())
+            {
+                std::cerr << "Invalid input symbol: " << symbol_str << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void run()
+    {
+        if (!from_image_ && !isValidAutomaton())
+        {
+            std::cerr << "Invalid automaton. Please check the input file." << std::endl;
+            return;
+        }
+
+        std::string input_line;
+        std::cout << "Enter input string (symbols separated by spaces): ";
+        std::getline(std::cin, input_line);
+        std::vector<std::string> input_symbols = split(input_line);
+
+        if (!isValidInput(input_symbols))
+        {
+            return;
+        }
+
+        if (!from_image_ && !compile())
+        {
+            return;
+        }
+        if (native_ && !loadNative())
+        {
+            return;
+        }
+
+        std::vector<uint8_t> input;
+        for (const std::string &symbol : input_symbols)
+        {
+            input.push_back(static_cast<uint8_t>(symbol_ids_[static_cast<unsigned char>(symbol[0])]));
+        }
+
+        const bool traced = output_level_ == OutputLevel::Trace;
+        Trace trace(traced ? trace_capacity_ : 1);
+        auto started = std::chrono::steady_clock::now();
+        RunResult result;
+        Tape tape;
+        RunLengthTape run_length_tape;
+        std::vector<Tape> tapes;
+        RunProfile profile;
+        const bool multi_tape = tape_count_ > 1 && !tracks_;
+        if (multi_tape && !profile_path_.empty())
+        {
+            std::cerr << "Profiling runs on one tape; add --single-tape to profile a multi-tape machine." << std::endl;
+            return;
+        }
+        if (multi_tape)
+        {
+            result = executeMultiTape(input, tapes);
+        }
+        else if (native_)
+        {
+            result = executeNative(input, tape);
+        }
+        else if (accelerated_)
+        {
+            result = executeAccelerated(input, run_length_tape, true, traced ? &trace : nullptr);
+        }
+        else if (!profile_path_.empty())
+        {
+            profile = newProfile();
+            result = execute(input, tape, profile, true, traced ? &trace : nullptr);
+        }
+        else
+        {
+            result = execute(input, tape, true, traced ? &trace : nullptr);
+        }
+        auto finished = std::chrono::steady_clock::now();
+
+        if (traced)
+        {
+            dumpTrace(trace);
+        }
+
+        if (result.outcome == RunResult::Outcome::NoRule && multi_tape)
+        {
+            std::cout << "No rule found for state " << state_names_[result.state] << " and symbols ";
+            for (size_t tape = 0; tape < tape_count_; ++tape)
+            {
+                std::cout << (tape > 0 ? "," : "") << symbol_chars_[(result.symbols >> (8 * tape)) & 0xFF];
+            }
+            std::cout << std::endl;
+        }
+        else if (result.outcome == RunResult::Outcome::NoRule)
+        {
+            std::cout << "No rule found for state " << state_names_[result.state]
+                      << " and symbol " << symbol_chars_[result.symbol] << std::endl;
+        }
+        else if (result.outcome == RunResult::Outcome::BudgetExceeded)
+        {
+            std::cout << "Budget exceeded after " << result.steps << " steps in state "
+                      << state_names_[result.state] << "; the run was stopped." << std::endl;
+        }
+        else if (result.proof == LoopProof::BlankSweep)
+        {
+            std::cout << "The machine never halts: state " << state_names_[result.state]
+                      << " sweeps over the blank tape forever." << std::endl;
+        }
+        else if (result.proof == LoopProof::Repeat)
+        {
+            std::cout << "The machine never halts: after " << result.steps << " steps the configuration repeats every "
+                      << result.period << " steps." << std::endl;
+        }
+        else if (result.proof == LoopProof::Translated)
+        {
+            std::cout << "The machine never halts: after " << result.steps << " steps the configuration repeats every "
+                      << result.period << " steps, shifted along the blank tape." << std::endl;
+        }
+
+        // Print resulting tape (excluding blank symbols at the ends)
+        std::cout << "Result: ";
+        for (uint8_t symbol : result.tape)
+        {
+            std::cout << symbol_chars_[symbol];
+        }
+        std::cout << std::endl;
+
+        if (output_level_ != OutputLevel::Verdict)
+        {
+            double seconds = std::chrono::duration<double>(finished - started).count();
+            std::cout << "Steps: " << result.steps << std::endl;
+            std::cout << "Time: " << seconds << " s" << std::endl;
+            if (seconds > 0)
+            {
+                std::cout << "Throughput: " << static_cast<double>(result.steps) / seconds << " steps/s" << std::endl;
+            }
+            std::cout << "Peak tape footprint: " << result.peak_footprint
+                      << (accelerated_ && !multi_tape ? " runs (" : " cells (")
+                      << result.peak_bytes << " bytes)" << std::endl;
+        }
+        if (!profile_path_.empty())
+        {
+            profile.write(profile_path_, profileLabels());
+        }
+    }
+
+    /*
+      Runs every line of `inputs_path` as a separate input. The machine is validated and compiled
+      once and shared read-only by the workers; each worker reuses its own tape. Results are
+      printed in input order, one line per input:
+      <line number> <accept|reject|loop|timeout|invalid> <state> <steps>
+      The step and time budgets apply to each input separately.
+     */
+    bool runBatch(const std::string &inputs_path, unsigned threads)
+    {
+        if (!from_image_ && !isValidAutomaton())
+        {
+            std::cerr << "Invalid automaton. Please check the input file." << std::endl;
+            return false;
+        }
+        if (!from_image_ && !compile())
+        {
+            return false;
+        }
+        if (native_ && !loadNative())
+        {
+            return false;
+        }
+        std::ifstream inputs(inputs_path);
+        if (!inputs.is_open())
+        {
+            std::cerr << "Error opening file: " << inputs_path << std::endl;
+            return false;
+        }
+
+        WorkStealingPool pool(threads);
+        std::vector<Tape> tapes(pool.size());
+        std::vector<RunLengthTape> run_length_tapes(pool.size());
+        std::vector<std::vector<Tape>> multi_tapes(pool.size());
+        const bool multi_tape = tape_count_ > 1 && !tracks_;
+        std::vector<std::vector<uint8_t>> encoded(pool.size());
+        if (multi_tape && !profile_path_.empty())
+        {
+            std::cerr << "Profiling runs on one tape; add --single-tape to profile a multi-tape machine." << std::endl;
+            return false;
+        }
+        const bool profiled = !profile_path_.empty();
+        std::vector<RunProfile> profiles(profiled ? pool.size() : 0, newProfile());
+
+        const size_t kBlockLines = 1 << 14;
+        std::vector<std::string> lines;
+        std::vector<RunResult> results(kBlockLines);
+        std::vector<char> valid(kBlockLines);
+        size_t line_number = 0;
+        uint64_t total_steps = 0;
+
+        auto started = std::chrono::steady_clock::now();
+        std::string line;
+        bool more = true;
+        while (more)
+        {
+            lines.clear();
+            while (lines.size() < kBlockLines && (more = static_cast<bool>(std::getline(inputs, line))))
+            {
+                lines.push_back(line);
+            }
+
+            pool.parallelFor(lines.size(), [&](unsigned worker, size_t i) {
+                valid[i] = encodeInput(lines[i], encoded[worker]);
+                if (!valid[i])
+                {
+                    return;
+                }
+                if (multi_tape)
+                {
+                    results[i] = executeMultiTape(encoded[worker], multi_tapes[worker], false);
+                }
+                else if (native_)
+                {
+                    results[i] = executeNative(encoded[worker], tapes[worker], false);
+                }
+                else if (profiled)
+                {
+                    results[i] = execute(encoded[worker], tapes[worker], profiles[worker], false);
+                }
+                else
+                {
+                    results[i] = accelerated_ ? executeAccelerated(encoded[worker], run_length_tapes[worker], false)
+                                              : execute(encoded[worker], tapes[worker], false);
+                }
+            });
+
+            for (size_t i = 0; i < lines.size(); ++i)
+            {
+                std::cout << ++line_number << '\t';
+                if (!valid[i])
+                {
+                    std::cout << "invalid\n";
+                    continue;
+                }
+                const RunResult &result = results[i];
+                switch (result.outcome)
+                {
+                case RunResult::Outcome::Halted:
+                    std::cout << "accept";
+                    break;
+                case RunResult::Outcome::NoRule:
+                    std::cout << "reject";
+                    break;
+                case RunResult::Outcome::NeverHalts:
+                    std::cout << "loop";
+                    break;
+                case RunResult::Outcome::BudgetExceeded:
+                    std::cout << "timeout";
+                    break;
+                }
+                std::cout << '\t' << state_names_[result.state] << '\t' << result.steps << '\n';
+                total_steps += result.steps;
+            }
+        }
+        std::cout.flush();
+        auto finished = std::chrono::steady_clock::now();
+
+        if (output_level_ != OutputLevel::Verdict)
+        {
+            double seconds = std::chrono::duration<double>(finished - started).count();
+            std::cerr << "Inputs: " << line_number << " on " << pool.size() << " threads" << std::endl;
+            std::cerr << "Steps: " << total_steps << std::endl;
+            std::cerr << "Time: " << seconds << " s" << std::endl;
+            if (seconds > 0)
+            {
+                std::cerr << "Throughput: " << static_cast<double>(line_number) / seconds << " inputs/s, "
+                          << static_cast<double>(total_steps) / seconds << " steps/s" << std::endl;
+            }
+        }
+        if (profiled)
+        {
+            for (size_t worker = 1; worker < profiles.size(); ++worker)
+            {
+                profiles[0].merge(profiles[worker]);
+            }
+            return profiles[0].write(profile_path_, profileLabels());
+        }
+        return true;
+    }
+};
+
+#endif
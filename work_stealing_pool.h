@@ -0,0 +1,158 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+  Fixed-size thread pool that runs index ranges with work stealing.
+
+  parallelFor() cuts [0, count) into chunks and deals them round-robin to per-worker deques.
+  A worker takes chunks from the back of its own deque and, once that is empty, steals from the
+  front of the others, so uneven inputs (one long-running machine among many short ones) still
+  keep every core busy. The body receives the worker index, which callers use to give each
+  worker its own scratch memory (tapes, stacks, ...).
+ */
+class WorkStealingPool {
+public:
+    using Body = std::function<void(unsigned worker, size_t index)>;
+
+    // threads == 0 uses one worker per hardware thread
+    explicit WorkStealingPool(unsigned threads = 0) {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads == 0) {
+            threads = 1;
+        }
+        for (unsigned i = 0; i < threads; ++i) {
+            queues_.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned i = 0; i < threads; ++i) {
+            workers_.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const {
+        return static_cast<unsigned>(workers_.size());
+    }
+
+    // Runs body(worker, index) for every index in [0, count) and blocks until all calls returned.
+    // Not reentrant: call it from one thread at a time and never from inside a body.
+    void parallelFor(size_t count, const Body& body, size_t grain = 0) {
+        if (count == 0) {
+            return;
+        }
+        if (grain == 0) {
+            grain = count / (size() * 8) + 1;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Set before dealing: a worker still searching from the previous call may start at once
+        pending_.store((count + grain - 1) / grain);
+        size_t chunk = 0;
+        for (size_t begin = 0; begin < count; begin += grain, ++chunk) {
+            Queue& queue = *queues_[chunk % queues_.size()];
+            std::lock_guard<std::mutex> queueLock(queue.mutex);
+            queue.ranges.push_back(Range{begin, begin + grain < count ? begin + grain : count, &body});
+        }
+        ++generation_;
+        wake_.notify_all();
+        done_.wait(lock, [this] { return pending_.load() == 0; });
+    }
+
+private:
+    // Each chunk carries its own body, so a worker that is still looking for work when one
+    // parallelFor() ends can never run a chunk of the next call with the previous body
+    struct Range {
+        size_t begin;
+        size_t end;
+        const Body* body;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::atomic<size_t> pending_{0};
+    unsigned long long generation_ = 0;
+    bool stop_ = false;
+
+    bool takeOwn(unsigned worker, Range& range) {
+        Queue& queue = *queues_[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.ranges.empty()) {
+            return false;
+        }
+        range = queue.ranges.back();
+        queue.ranges.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned worker, Range& range) {
+        for (size_t offset = 1; offset < queues_.size(); ++offset) {
+            Queue& queue = *queues_[(worker + offset) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.ranges.empty()) {
+                range = queue.ranges.front();
+                queue.ranges.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned worker) {
+        unsigned long long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) {
+                    return;
+                }
+                seen = generation_;
+            }
+
+            Range range;
+            while (takeOwn(worker, range) || steal(worker, range)) {
+                for (size_t i = range.begin; i < range.end; ++i) {
+                    (*range.body)(worker, i);
+                }
+                if (pending_.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    done_.notify_all();
+                }
+            }
+        }
+    }
+};
+
+#endif